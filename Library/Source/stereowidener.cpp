@@ -0,0 +1,103 @@
+/*
+  ==============================================================================
+
+    stereowidener.cpp
+    The C interface, a BatchWidener behind an opaque handle. No exception
+    leaves it: allocation failures in prepare are returned as a status.
+
+  ==============================================================================
+*/
+
+#include "stereowidener.h"
+#include "BatchWidener.h"
+#include <new>
+
+struct stereowidener{
+    BatchWidener engine;
+    double sample_rate = 0.0;
+    int max_block_size = 0;
+    bool prepared = false;
+};
+
+stereowidener* stereowidener_create(void){
+    return new (std::nothrow) stereowidener();
+}
+
+void stereowidener_destroy(stereowidener* widener){
+    delete widener;
+}
+
+stereowidener_status stereowidener_prepare(stereowidener* widener, int num_streams, double sample_rate, int max_block_size){
+    if (widener == nullptr || num_streams < 1 || ! (sample_rate > 0.0) || max_block_size < 1)
+        return STEREOWIDENER_INVALID_ARGUMENT;
+    widener->prepared = false;
+    try{
+        widener->engine.prepare(num_streams, sample_rate, max_block_size);
+    }
+    catch (const std::bad_alloc&){
+        return STEREOWIDENER_OUT_OF_MEMORY;
+    }
+    widener->sample_rate = sample_rate;
+    widener->max_block_size = max_block_size;
+    widener->prepared = true;
+    return STEREOWIDENER_OK;
+}
+
+stereowidener_status stereowidener_reset(stereowidener* widener){
+    if (widener == nullptr)
+        return STEREOWIDENER_INVALID_ARGUMENT;
+    if (! widener->prepared)
+        return STEREOWIDENER_NOT_PREPARED;
+    widener->engine.reset();
+    return STEREOWIDENER_OK;
+}
+
+stereowidener_status stereowidener_set_parameters(stereowidener* widener, float width_lower, float width_higher,
+                                                  float cutoff_frequency, int amp_preserve,
+                                                  int allpass_decorrelation, int handle_transients){
+    if (widener == nullptr)
+        return STEREOWIDENER_INVALID_ARGUMENT;
+    if (! widener->prepared)
+        return STEREOWIDENER_NOT_PREPARED;
+    //the filterbank is only stable below Nyquist
+    if (! (width_lower >= 0.0f && width_lower <= 100.0f) || ! (width_higher >= 0.0f && width_higher <= 100.0f)
+        || ! (cutoff_frequency > 0.0f && cutoff_frequency < 0.5 * widener->sample_rate))
+        return STEREOWIDENER_INVALID_ARGUMENT;
+    widener->engine.set_parameters(width_lower, width_higher, cutoff_frequency,
+                                   amp_preserve != 0, allpass_decorrelation != 0, handle_transients != 0);
+    return STEREOWIDENER_OK;
+}
+
+stereowidener_status stereowidener_reset_parameter_smoothing(stereowidener* widener){
+    if (widener == nullptr)
+        return STEREOWIDENER_INVALID_ARGUMENT;
+    if (! widener->prepared)
+        return STEREOWIDENER_NOT_PREPARED;
+    widener->engine.reset_parameter_smoothing();
+    return STEREOWIDENER_OK;
+}
+
+stereowidener_status stereowidener_process(stereowidener* widener, const float* const* inputs,
+                                           float* const* outputs, int num_samples){
+    if (widener == nullptr || inputs == nullptr || outputs == nullptr || num_samples < 0)
+        return STEREOWIDENER_INVALID_ARGUMENT;
+    if (! widener->prepared)
+        return STEREOWIDENER_NOT_PREPARED;
+    if (num_samples > widener->max_block_size)
+        return STEREOWIDENER_BLOCK_TOO_LONG;
+    if (num_samples > 0)
+        widener->engine.process(inputs, outputs, num_samples);
+    return STEREOWIDENER_OK;
+}
+
+const char* stereowidener_get_simd_tier(const stereowidener* widener){
+    if (widener == nullptr || ! widener->prepared)
+        return SimdKernels::get_tier_name(SimdKernels::get_requested_tier());
+    return SimdKernels::get_tier_name(widener->engine.get_tier());
+}
+
+int stereowidener_get_lane_width(const stereowidener* widener){
+    if (widener == nullptr || ! widener->prepared)
+        return SimdKernels::get_lane_width(SimdKernels::get_requested_tier());
+    return widener->engine.get_lane_width();
+}
@@ -0,0 +1,307 @@
+/*
+  ==============================================================================
+
+    stereowidener_python.cpp
+    The Python module stereowidener, over the C interface. Audio is passed
+    as float32 arrays of shape (channels, samples), with channel c of stream
+    s in row 2 * s + c, through the buffer protocol: NumPy arrays are read
+    and written in place, without copies and without NumPy headers at build
+    time. The GIL is released while a signal is processed, so that threads
+    can run sweeps on separate Widener objects in parallel.
+
+  ==============================================================================
+*/
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+#include "stereowidener.h"
+#include <algorithm>
+#include <cstring>
+#include <new>
+#include <vector>
+
+typedef struct{
+    PyObject_HEAD
+    stereowidener* widener;
+    int num_streams;
+    int max_block_size;
+    bool busy;                  //processing with the GIL released
+    std::vector<const float*>* inputs;
+    std::vector<float*>* outputs;
+} WidenerObject;
+
+static PyObject* status_error(stereowidener_status status){
+    switch (status){
+        case STEREOWIDENER_OUT_OF_MEMORY: return PyErr_NoMemory();
+        case STEREOWIDENER_NOT_PREPARED: PyErr_SetString(PyExc_RuntimeError, "the widener is not prepared"); break;
+        case STEREOWIDENER_BLOCK_TOO_LONG: PyErr_SetString(PyExc_ValueError, "block longer than max_block_size"); break;
+        default: PyErr_SetString(PyExc_ValueError, "invalid argument"); break;
+    }
+    return nullptr;
+}
+
+//a writable or read-only 2D float32 buffer of shape (2 * num_streams, samples),
+//with each channel contiguous
+static bool get_channels(PyObject* object, Py_buffer* view, int flags, int numChannels, const char* name){
+    if (PyObject_GetBuffer(object, view, flags | PyBUF_STRIDES | PyBUF_FORMAT) != 0)
+        return false;
+    const char* error = nullptr;
+    //native float, with or without a byte order prefix
+    const char* format = view->format;
+    if (format != nullptr && format[0] != 0 && std::strchr("@=<", format[0]) != nullptr)
+        format++;
+    if (format == nullptr || std::strcmp(format, "f") != 0)
+        error = "%s must be float32";
+    else if (view->ndim != 2 || view->shape[0] != numChannels)
+        error = "%s must have shape (2 * num_streams, samples)";
+    else if (view->shape[1] > 1 && view->strides[1] != (Py_ssize_t) sizeof(float))
+        error = "the samples of each channel of %s must be contiguous";
+    if (error != nullptr){
+        PyErr_Format(PyExc_ValueError, error, name);
+        PyBuffer_Release(view);
+        return false;
+    }
+    return true;
+}
+
+//==============================================================================
+static void Widener_dealloc(WidenerObject* self){
+    stereowidener_destroy(self->widener);
+    delete self->inputs;
+    delete self->outputs;
+    Py_TYPE(self)->tp_free((PyObject*) self);
+}
+
+static PyObject* Widener_new(PyTypeObject* type, PyObject*, PyObject*){
+    WidenerObject* self = (WidenerObject*) type->tp_alloc(type, 0);
+    if (self == nullptr)
+        return nullptr;
+    self->widener = stereowidener_create();
+    self->inputs = new (std::nothrow) std::vector<const float*>();
+    self->outputs = new (std::nothrow) std::vector<float*>();
+    if (self->widener == nullptr || self->inputs == nullptr || self->outputs == nullptr){
+        Py_DECREF(self);
+        return PyErr_NoMemory();
+    }
+    return (PyObject*) self;
+}
+
+static int Widener_init(WidenerObject* self, PyObject* args, PyObject* kwargs){
+    static const char* keywords[] = {"sample_rate", "num_streams", "max_block_size", nullptr};
+    double sampleRate = 0.0;
+    int numStreams = 1, maxBlockSize = 512;
+    if (! PyArg_ParseTupleAndKeywords(args, kwargs, "d|ii", (char**) keywords, &sampleRate, &numStreams, &maxBlockSize))
+        return -1;
+    if (self->busy){
+        PyErr_SetString(PyExc_RuntimeError, "the widener is processing on another thread");
+        return -1;
+    }
+    const stereowidener_status status = stereowidener_prepare(self->widener, numStreams, sampleRate, maxBlockSize);
+    if (status != STEREOWIDENER_OK){
+        status_error(status);
+        return -1;
+    }
+    try{
+        self->inputs->resize(2 * (size_t) numStreams);
+        self->outputs->resize(2 * (size_t) numStreams);
+    }
+    catch (const std::bad_alloc&){
+        PyErr_NoMemory();
+        return -1;
+    }
+    self->num_streams = numStreams;
+    self->max_block_size = maxBlockSize;
+    return 0;
+}
+
+static PyObject* Widener_set_parameters(WidenerObject* self, PyObject* args, PyObject* kwargs){
+    static const char* keywords[] = {"width_lower", "width_higher", "cutoff_frequency", "amp_preserve",
+                                     "allpass_decorrelation", "handle_transients", nullptr};
+    float widthLower = 0.0f, widthHigher = 0.0f, cutoff = 500.0f;
+    int ampPreserve = 0, allpassDecorrelation = 0, handleTransients = 0;
+    if (! PyArg_ParseTupleAndKeywords(args, kwargs, "|fffppp", (char**) keywords, &widthLower, &widthHigher,
+                                      &cutoff, &ampPreserve, &allpassDecorrelation, &handleTransients))
+        return nullptr;
+    if (self->busy){
+        PyErr_SetString(PyExc_RuntimeError, "the widener is processing on another thread");
+        return nullptr;
+    }
+    const stereowidener_status status = stereowidener_set_parameters(self->widener, widthLower, widthHigher, cutoff,
+                                                                       ampPreserve, allpassDecorrelation, handleTransients);
+    if (status != STEREOWIDENER_OK)
+        return status_error(status);
+    Py_RETURN_NONE;
+}
+
+static PyObject* Widener_reset_parameter_smoothing(WidenerObject* self, PyObject*){
+    if (self->busy){
+        PyErr_SetString(PyExc_RuntimeError, "the widener is processing on another thread");
+        return nullptr;
+    }
+    const stereowidener_status status = stereowidener_reset_parameter_smoothing(self->widener);
+    if (status != STEREOWIDENER_OK)
+        return status_error(status);
+    Py_RETURN_NONE;
+}
+
+static PyObject* Widener_reset(WidenerObject* self, PyObject*){
+    if (self->busy){
+        PyErr_SetString(PyExc_RuntimeError, "the widener is processing on another thread");
+        return nullptr;
+    }
+    const stereowidener_status status = stereowidener_reset(self->widener);
+    if (status != STEREOWIDENER_OK)
+        return status_error(status);
+    Py_RETURN_NONE;
+}
+
+static PyObject* Widener_process(WidenerObject* self, PyObject* args, PyObject* kwargs){
+    static const char* keywords[] = {"input", "output", nullptr};
+    PyObject* inputObject = nullptr;
+    PyObject* outputObject = Py_None;
+    if (! PyArg_ParseTupleAndKeywords(args, kwargs, "O|O", (char**) keywords, &inputObject, &outputObject))
+        return nullptr;
+    if (self->busy){
+        PyErr_SetString(PyExc_RuntimeError, "the widener is processing on another thread");
+        return nullptr;
+    }
+    const int numChannels = 2 * self->num_streams;
+
+    Py_buffer input, output;
+    if (! get_channels(inputObject, &input, PyBUF_SIMPLE, numChannels, "input"))
+        return nullptr;
+    //a new array like the input, from NumPy at run time
+    if (outputObject == Py_None){
+        PyObject* numpy = PyImport_ImportModule("numpy");
+        outputObject = (numpy == nullptr) ? nullptr : PyObject_CallMethod(numpy, "empty", "(nn)s",
+                                                                           (Py_ssize_t) numChannels, input.shape[1], "float32");
+        Py_XDECREF(numpy);
+    }
+    else
+        Py_INCREF(outputObject);
+    if (outputObject == nullptr){
+        PyBuffer_Release(&input);
+        return nullptr;
+    }
+    if (! get_channels(outputObject, &output, PyBUF_WRITABLE, numChannels, "output")){
+        PyBuffer_Release(&input);
+        Py_DECREF(outputObject);
+        return nullptr;
+    }
+    if (output.shape[1] != input.shape[1]){
+        PyErr_SetString(PyExc_ValueError, "input and output must have the same number of samples");
+        PyBuffer_Release(&input);
+        PyBuffer_Release(&output);
+        Py_DECREF(outputObject);
+        return nullptr;
+    }
+
+    //blocks of max_block_size, as a host calls processBlock
+    const Py_ssize_t numSamples = input.shape[1];
+    std::vector<const float*>& inputs = *self->inputs;
+    std::vector<float*>& outputs = *self->outputs;
+    stereowidener_status status = STEREOWIDENER_OK;
+    self->busy = true;
+    Py_BEGIN_ALLOW_THREADS
+    for (Py_ssize_t start = 0; start < numSamples && status == STEREOWIDENER_OK; start += self->max_block_size){
+        const int blockSize = (int) std::min((Py_ssize_t) self->max_block_size, numSamples - start);
+        for (int c = 0; c < numChannels; c++){
+            inputs[c] = (const float*) ((const char*) input.buf + c * input.strides[0]) + start;
+            outputs[c] = (float*) ((char*) output.buf + c * output.strides[0]) + start;
+        }
+        status = stereowidener_process(self->widener, inputs.data(), outputs.data(), blockSize);
+    }
+    Py_END_ALLOW_THREADS
+    self->busy = false;
+    PyBuffer_Release(&input);
+    PyBuffer_Release(&output);
+    if (status != STEREOWIDENER_OK){
+        Py_DECREF(outputObject);
+        return status_error(status);
+    }
+    return outputObject;
+}
+
+static PyObject* Widener_get_num_streams(WidenerObject* self, void*){
+    return PyLong_FromLong(self->num_streams);
+}
+
+static PyObject* Widener_get_max_block_size(WidenerObject* self, void*){
+    return PyLong_FromLong(self->max_block_size);
+}
+
+static PyObject* Widener_get_simd_tier(WidenerObject* self, void*){
+    return PyUnicode_FromString(stereowidener_get_simd_tier(self->widener));
+}
+
+static PyObject* Widener_get_lane_width(WidenerObject* self, void*){
+    return PyLong_FromLong(stereowidener_get_lane_width(self->widener));
+}
+
+//==============================================================================
+static PyMethodDef Widener_methods[] = {
+    {"set_parameters", (PyCFunction) (void(*)(void)) Widener_set_parameters, METH_VARARGS | METH_KEYWORDS,
+     "set_parameters(width_lower=0, width_higher=0, cutoff_frequency=500, amp_preserve=False,\n"
+     "               allpass_decorrelation=False, handle_transients=False)\n\n"
+     "The plugin's parameters. The widths are in percent, 100 * beta / (pi / 2) for the\n"
+     "beta of widener.py, and the cutoff is in Hz. The widths and the cutoff move towards\n"
+     "the new values once per block, as in the plugin."},
+    {"reset_parameter_smoothing", (PyCFunction) Widener_reset_parameter_smoothing, METH_NOARGS,
+     "Jump to the parameters instead of smoothing towards them."},
+    {"reset", (PyCFunction) Widener_reset, METH_NOARGS,
+     "Clear the filter states and transient detectors, for new signals."},
+    {"process", (PyCFunction) (void(*)(void)) Widener_process, METH_VARARGS | METH_KEYWORDS,
+     "process(input, output=None)\n\n"
+     "Widen input, a float32 array of shape (2 * num_streams, samples), in blocks of\n"
+     "max_block_size. The result is written to output, which can be input, or to a new\n"
+     "array, and returned. The state carries over to the next call."},
+    {nullptr, nullptr, 0, nullptr},
+};
+
+static PyGetSetDef Widener_getset[] = {
+    {"num_streams", (getter) Widener_get_num_streams, nullptr, "Number of stereo streams.", nullptr},
+    {"max_block_size", (getter) Widener_get_max_block_size, nullptr, "Samples per block.", nullptr},
+    {"simd_tier", (getter) Widener_get_simd_tier, nullptr, "SIMD instruction set in use.", nullptr},
+    {"lane_width", (getter) Widener_get_lane_width, nullptr, "Channels processed at once.", nullptr},
+    {nullptr, nullptr, nullptr, nullptr, nullptr},
+};
+
+static PyTypeObject WidenerType = {
+    PyVarObject_HEAD_INIT(nullptr, 0)
+};
+
+static PyModuleDef stereowidener_module = {
+    PyModuleDef_HEAD_INIT,
+    "stereowidener",
+    "The C++ widening engine of the plugin, with the same output as its time domain\n"
+    "engine in the default modes: velvet noise or allpass decorrelation, Butterworth or\n"
+    "Linkwitz-Riley filterbank, and transient handling.",
+    -1,
+    nullptr,
+};
+
+PyMODINIT_FUNC PyInit_stereowidener(void){
+    WidenerType.tp_name = "stereowidener.Widener";
+    WidenerType.tp_doc = "Widener(sample_rate, num_streams=1, max_block_size=512)\n\n"
+                         "Widens num_streams stereo streams with the same settings.";
+    WidenerType.tp_basicsize = sizeof(WidenerObject);
+    WidenerType.tp_flags = Py_TPFLAGS_DEFAULT;
+    WidenerType.tp_new = Widener_new;
+    WidenerType.tp_init = (initproc) Widener_init;
+    WidenerType.tp_dealloc = (destructor) Widener_dealloc;
+    WidenerType.tp_methods = Widener_methods;
+    WidenerType.tp_getset = Widener_getset;
+    if (PyType_Ready(&WidenerType) < 0)
+        return nullptr;
+
+    PyObject* module = PyModule_Create(&stereowidener_module);
+    if (module == nullptr)
+        return nullptr;
+    Py_INCREF(&WidenerType);
+    if (PyModule_AddObject(module, "Widener", (PyObject*) &WidenerType) < 0){
+        Py_DECREF(&WidenerType);
+        Py_DECREF(module);
+        return nullptr;
+    }
+    return module;
+}
@@ -0,0 +1,89 @@
+/*
+  ==============================================================================
+
+    stereowidener.h
+    C interface to the widening engine, for hosts, games and other languages
+    that do not use JUCE. An instance widens one or more independent stereo
+    streams with the same settings (see Source/BatchWidener.h), with the same
+    output per stream as the plugin in its default modes: velvet noise or
+    allpass decorrelation, the Butterworth or Linkwitz-Riley filterbank and
+    the transient handler. It does not reproduce the plugin's other modes:
+    the STFT and HRTF engines, the multirate low band, mid decorrelation,
+    transient lookahead, linked and band-limited transient detection, and
+    the optimised velvet noise filters (it uses the generated sequence).
+
+    Everything is allocated in stereowidener_prepare. stereowidener_process
+    and the parameter setters do not allocate or lock, and can be called from
+    an audio thread. The buffers are the caller's, one per channel, and
+    channel c of stream s is buffer 2 * s + c.
+
+  ==============================================================================
+*/
+
+#ifndef STEREOWIDENER_H
+#define STEREOWIDENER_H
+
+#if defined(_WIN32) && defined(STEREOWIDENER_SHARED)
+ #if defined(STEREOWIDENER_BUILDING)
+  #define STEREOWIDENER_API __declspec(dllexport)
+ #else
+  #define STEREOWIDENER_API __declspec(dllimport)
+ #endif
+#elif defined(__GNUC__) && defined(STEREOWIDENER_BUILDING)
+ #define STEREOWIDENER_API __attribute__((visibility("default")))
+#else
+ #define STEREOWIDENER_API
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct stereowidener stereowidener;
+
+typedef enum stereowidener_status{
+    STEREOWIDENER_OK = 0,
+    STEREOWIDENER_INVALID_ARGUMENT,     /* null pointer or out of range value */
+    STEREOWIDENER_NOT_PREPARED,         /* stereowidener_prepare has not succeeded */
+    STEREOWIDENER_BLOCK_TOO_LONG,       /* more samples than the maximum block size */
+    STEREOWIDENER_OUT_OF_MEMORY,
+} stereowidener_status;
+
+/* a new instance, or NULL if it cannot be allocated */
+STEREOWIDENER_API stereowidener* stereowidener_create(void);
+STEREOWIDENER_API void stereowidener_destroy(stereowidener* widener);
+
+/* allocates the filters and buffers for num_streams stereo streams and blocks
+   of up to max_block_size samples, and clears the state. Can be called again
+   to change any of them */
+STEREOWIDENER_API stereowidener_status stereowidener_prepare(stereowidener* widener, int num_streams,
+                                                             double sample_rate, int max_block_size);
+/* clears the filter states and transient detectors, for new streams */
+STEREOWIDENER_API stereowidener_status stereowidener_reset(stereowidener* widener);
+
+/* the plugin's parameters: widths in percent (0 - 100), the cutoff of the
+   filterbank in Hz, and the three switches (0 or 1). The widths and the cutoff
+   move towards the new values over about 10 ms, once per processed block */
+STEREOWIDENER_API stereowidener_status stereowidener_set_parameters(stereowidener* widener, float width_lower,
+                                                                    float width_higher, float cutoff_frequency,
+                                                                    int amp_preserve, int allpass_decorrelation,
+                                                                    int handle_transients);
+/* jump to the last parameters instead of smoothing towards them */
+STEREOWIDENER_API stereowidener_status stereowidener_reset_parameter_smoothing(stereowidener* widener);
+
+/* widens num_samples samples of every stream. inputs and outputs have
+   2 * num_streams channels each, and the outputs can be the inputs */
+STEREOWIDENER_API stereowidener_status stereowidener_process(stereowidener* widener, const float* const* inputs,
+                                                             float* const* outputs, int num_samples);
+
+/* the SIMD instruction set in use ("scalar", "sse4.2", "avx2" or "avx512") and
+   how many channels it processes at once. Set STEREOWIDENER_SIMD_TIER to
+   choose a lower one */
+STEREOWIDENER_API const char* stereowidener_get_simd_tier(const stereowidener* widener);
+STEREOWIDENER_API int stereowidener_get_lane_width(const stereowidener* widener);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,55 @@
+"""Renders the test corpus of Tools/AccuracyTest with the Python widener.
+
+The corpus is written by `StereoWidenerAccuracyTest --write-corpus <dir>`,
+and the renders written here are compared with
+`StereoWidenerAccuracyTest --python <dir>`. The settings match the default
+configuration of the accuracy tests: amplitude preserving filterbank,
+optimised velvet noise, width 50/100 and a cutoff of 500 Hz.
+
+Usage: python render_reference.py <corpus dir> [<output dir>]
+"""
+
+import sys
+import numpy as np
+from pathlib import Path
+from scipy.io import wavfile
+import widener
+from widener import (StereoWidenerFrequencyBased, FilterbankType,
+                     DecorrelationType)
+
+CUTOFF_FREQ = 500.0
+BETA = (np.pi / 4, np.pi / 2)
+
+
+def render_file(input_path: Path, output_dir: Path):
+    fs, input_signal = wavfile.read(input_path)
+    input_signal = input_signal.astype(np.float64)
+    stereo_widener = StereoWidenerFrequencyBased(input_signal, fs,
+                                                 FilterbankType.AMP_PRESERVE,
+                                                 DecorrelationType.OPT_VELVET,
+                                                 BETA, CUTOFF_FREQ)
+    output_signal = stereo_widener.process()
+    output_path = output_dir / (input_path.stem + '_python.wav')
+    wavfile.write(output_path, fs, output_signal.astype(np.float32))
+    print(f'{input_path.name} -> {output_path.name}')
+
+
+def main():
+    if len(sys.argv) < 2:
+        print(__doc__)
+        sys.exit(1)
+    corpus_dir = Path(sys.argv[1])
+    output_dir = Path(sys.argv[2]) if len(sys.argv) > 2 else corpus_dir
+    output_dir.mkdir(parents=True, exist_ok=True)
+
+    # the default path is relative to the notebooks directory
+    widener.OPT_VN_PATH = (Path(__file__).resolve().parents[2] /
+                           'Resources' / 'opt_vn_filters.txt')
+
+    for input_path in sorted(corpus_dir.glob('*.wav')):
+        if not input_path.stem.endswith('_python'):
+            render_file(input_path, output_dir)
+
+
+if __name__ == '__main__':
+    main()
@@ -43,7 +43,7 @@ float AllpassBiquadCascade::warpPoleAngle(float pole_angle){
 }
 
 
-void AllpassBiquadCascade::initialize(int numBq, float sR, float maxGroupDelayMs){
+void AllpassBiquadCascade::initialize(int numBq, float sR, float maxGroupDelayMs, unsigned int seed){
     I.real(0); I.imag(1);                   // complex number 0 + 1i
     sampleRate = sR;
     numBiquads = numBq;
@@ -53,7 +53,7 @@ void AllpassBiquadCascade::initialize(int numBq, float sR, float maxGroupDelayMs
     warpFactor =  0.7464 * std::sqrt(2.0 / PI * std::atan(0.1418 * sampleRate)) + 0.03237;
     
     //generate random pole radii and pole angle
-    std::default_random_engine generator;
+    std::default_random_engine generator (seed);
     //randomly diistributed between 0.5 and beta
     std::uniform_real_distribution<float> distribution_radii(0.5, maxGrpDel);
     //randomly distriibuted between 0 and 2PI in ERB scale
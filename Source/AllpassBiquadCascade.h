@@ -9,7 +9,7 @@
 */
 
 #pragma once
-#include "JuceHeader.h"
+#include "DspCore.h"
 #include "BiquadFilter.h"
 #include <random>
 #include <complex>
@@ -39,9 +39,14 @@ public:
     AllpassBiquadCascade();
     ~AllpassBiquadCascade();
     
-    void initialize(int numBq, float sR, float maxGroupDelayMs);
+    //cascades with different seeds have different random poles
+    void initialize(int numBq, float sR, float maxGroupDelayMs,
+                    unsigned int seed = std::default_random_engine::default_seed);
     float warpPoleAngle(float pole_angle);
     float process(const float input);
+    int get_num_biquads() const { return numBiquads; }
+    //b0, b1, b2, a0, a1 of one biquad
+    void get_coefficients(int biquad, float* coefficients) const { biquads[biquad].get_coefficients(coefficients); }
     
     
 private:
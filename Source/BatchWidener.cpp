@@ -0,0 +1,565 @@
+/*
+  ==============================================================================
+
+    BatchWidener.cpp
+
+  ==============================================================================
+*/
+
+#include "BatchWidener.h"
+#include "TransientHandler.h"
+
+//GCC fuses a multiply and an add into an FMA where the target has it, and
+//warns that the register types of the lanes are passed by value in functions
+//without the target. They are inlined into the functions of each tier
+#if defined(__GNUC__) && ! defined(__clang__)
+ #pragma GCC optimize ("fp-contract=off")
+ #pragma GCC diagnostic ignored "-Wpsabi"
+#elif defined(__clang__) && defined(__has_warning)
+ #if __has_warning("-Wpsabi")
+  #pragma clang diagnostic ignored "-Wpsabi"
+ #endif
+#endif
+
+namespace{
+//==============================================================================
+//the operations the lane kernels use on one register of lanes, for each tier.
+//The comparisons are false for NaN, as in the scalar code
+struct ScalarLanes{
+    enum{ width = 4 };
+    struct Float{ float v[width]; };
+    struct Double{ double v[width]; };
+    struct Mask{ bool v[width]; };
+
+    static inline Float load(const float* p){ Float r; for (int l = 0; l < width; l++) r.v[l] = p[l]; return r; }
+    static inline void store(float* p, Float a){ for (int l = 0; l < width; l++) p[l] = a.v[l]; }
+    static inline Float set(float x){ Float r; for (int l = 0; l < width; l++) r.v[l] = x; return r; }
+    static inline Float add(Float a, Float b){ for (int l = 0; l < width; l++) a.v[l] = a.v[l] + b.v[l]; return a; }
+    static inline Float sub(Float a, Float b){ for (int l = 0; l < width; l++) a.v[l] = a.v[l] - b.v[l]; return a; }
+    static inline Float mul(Float a, Float b){ for (int l = 0; l < width; l++) a.v[l] = a.v[l] * b.v[l]; return a; }
+    static inline Float abs(Float a){ for (int l = 0; l < width; l++) a.v[l] = std::abs(a.v[l]); return a; }
+    static inline Mask greater(Float a, Float b){ Mask r; for (int l = 0; l < width; l++) r.v[l] = a.v[l] > b.v[l]; return r; }
+    static inline Mask both(Mask a, Mask b){ for (int l = 0; l < width; l++) a.v[l] = a.v[l] && b.v[l]; return a; }
+    static inline Float select(Mask m, Float a, Float b){ for (int l = 0; l < width; l++) a.v[l] = m.v[l] ? a.v[l] : b.v[l]; return a; }
+    static inline int bits(Mask m){ int r = 0; for (int l = 0; l < width; l++) r |= (int) m.v[l] << l; return r; }
+
+    static inline Double load(const double* p){ Double r; for (int l = 0; l < width; l++) r.v[l] = p[l]; return r; }
+    static inline void store(double* p, Double a){ for (int l = 0; l < width; l++) p[l] = a.v[l]; }
+    static inline Double set(double x){ Double r; for (int l = 0; l < width; l++) r.v[l] = x; return r; }
+    static inline Double add(Double a, Double b){ for (int l = 0; l < width; l++) a.v[l] = a.v[l] + b.v[l]; return a; }
+    static inline Double sub(Double a, Double b){ for (int l = 0; l < width; l++) a.v[l] = a.v[l] - b.v[l]; return a; }
+    static inline Double mul(Double a, Double b){ for (int l = 0; l < width; l++) a.v[l] = a.v[l] * b.v[l]; return a; }
+    static inline Double to_double(Float a){ Double r; for (int l = 0; l < width; l++) r.v[l] = a.v[l]; return r; }
+    static inline Float to_float(Double a){ Float r; for (int l = 0; l < width; l++) r.v[l] = (float) a.v[l]; return r; }
+};
+
+#if STEREOWIDENER_X86
+//==============================================================================
+struct Sse42Lanes{
+    enum{ width = 4 };
+    using Float = __m128;
+    struct Double{ __m128d low, high; };
+    using Mask = __m128;
+
+    STEREOWIDENER_TARGET("sse4.2") static inline Float load(const float* p){ return _mm_loadu_ps(p); }
+    STEREOWIDENER_TARGET("sse4.2") static inline void store(float* p, Float a){ _mm_storeu_ps(p, a); }
+    STEREOWIDENER_TARGET("sse4.2") static inline Float set(float x){ return _mm_set1_ps(x); }
+    STEREOWIDENER_TARGET("sse4.2") static inline Float add(Float a, Float b){ return _mm_add_ps(a, b); }
+    STEREOWIDENER_TARGET("sse4.2") static inline Float sub(Float a, Float b){ return _mm_sub_ps(a, b); }
+    STEREOWIDENER_TARGET("sse4.2") static inline Float mul(Float a, Float b){ return _mm_mul_ps(a, b); }
+    STEREOWIDENER_TARGET("sse4.2") static inline Float abs(Float a){ return _mm_andnot_ps(_mm_set1_ps(-0.0f), a); }
+    STEREOWIDENER_TARGET("sse4.2") static inline Mask greater(Float a, Float b){ return _mm_cmpgt_ps(a, b); }
+    STEREOWIDENER_TARGET("sse4.2") static inline Mask both(Mask a, Mask b){ return _mm_and_ps(a, b); }
+    STEREOWIDENER_TARGET("sse4.2") static inline Float select(Mask m, Float a, Float b){ return _mm_blendv_ps(b, a, m); }
+    STEREOWIDENER_TARGET("sse4.2") static inline int bits(Mask m){ return _mm_movemask_ps(m); }
+
+    STEREOWIDENER_TARGET("sse4.2") static inline Double load(const double* p){ return { _mm_loadu_pd(p), _mm_loadu_pd(p + 2) }; }
+    STEREOWIDENER_TARGET("sse4.2") static inline void store(double* p, Double a){ _mm_storeu_pd(p, a.low); _mm_storeu_pd(p + 2, a.high); }
+    STEREOWIDENER_TARGET("sse4.2") static inline Double set(double x){ return { _mm_set1_pd(x), _mm_set1_pd(x) }; }
+    STEREOWIDENER_TARGET("sse4.2") static inline Double add(Double a, Double b){ return { _mm_add_pd(a.low, b.low), _mm_add_pd(a.high, b.high) }; }
+    STEREOWIDENER_TARGET("sse4.2") static inline Double sub(Double a, Double b){ return { _mm_sub_pd(a.low, b.low), _mm_sub_pd(a.high, b.high) }; }
+    STEREOWIDENER_TARGET("sse4.2") static inline Double mul(Double a, Double b){ return { _mm_mul_pd(a.low, b.low), _mm_mul_pd(a.high, b.high) }; }
+    STEREOWIDENER_TARGET("sse4.2") static inline Double to_double(Float a){ return { _mm_cvtps_pd(a), _mm_cvtps_pd(_mm_movehl_ps(a, a)) }; }
+    STEREOWIDENER_TARGET("sse4.2") static inline Float to_float(Double a){ return _mm_movelh_ps(_mm_cvtpd_ps(a.low), _mm_cvtpd_ps(a.high)); }
+};
+
+//==============================================================================
+struct Avx2Lanes{
+    enum{ width = 8 };
+    using Float = __m256;
+    struct Double{ __m256d low, high; };
+    using Mask = __m256;
+
+    STEREOWIDENER_TARGET("avx2") static inline Float load(const float* p){ return _mm256_loadu_ps(p); }
+    STEREOWIDENER_TARGET("avx2") static inline void store(float* p, Float a){ _mm256_storeu_ps(p, a); }
+    STEREOWIDENER_TARGET("avx2") static inline Float set(float x){ return _mm256_set1_ps(x); }
+    STEREOWIDENER_TARGET("avx2") static inline Float add(Float a, Float b){ return _mm256_add_ps(a, b); }
+    STEREOWIDENER_TARGET("avx2") static inline Float sub(Float a, Float b){ return _mm256_sub_ps(a, b); }
+    STEREOWIDENER_TARGET("avx2") static inline Float mul(Float a, Float b){ return _mm256_mul_ps(a, b); }
+    STEREOWIDENER_TARGET("avx2") static inline Float abs(Float a){ return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), a); }
+    STEREOWIDENER_TARGET("avx2") static inline Mask greater(Float a, Float b){ return _mm256_cmp_ps(a, b, _CMP_GT_OQ); }
+    STEREOWIDENER_TARGET("avx2") static inline Mask both(Mask a, Mask b){ return _mm256_and_ps(a, b); }
+    STEREOWIDENER_TARGET("avx2") static inline Float select(Mask m, Float a, Float b){ return _mm256_blendv_ps(b, a, m); }
+    STEREOWIDENER_TARGET("avx2") static inline int bits(Mask m){ return _mm256_movemask_ps(m); }
+
+    STEREOWIDENER_TARGET("avx2") static inline Double load(const double* p){ return { _mm256_loadu_pd(p), _mm256_loadu_pd(p + 4) }; }
+    STEREOWIDENER_TARGET("avx2") static inline void store(double* p, Double a){ _mm256_storeu_pd(p, a.low); _mm256_storeu_pd(p + 4, a.high); }
+    STEREOWIDENER_TARGET("avx2") static inline Double set(double x){ return { _mm256_set1_pd(x), _mm256_set1_pd(x) }; }
+    STEREOWIDENER_TARGET("avx2") static inline Double add(Double a, Double b){ return { _mm256_add_pd(a.low, b.low), _mm256_add_pd(a.high, b.high) }; }
+    STEREOWIDENER_TARGET("avx2") static inline Double sub(Double a, Double b){ return { _mm256_sub_pd(a.low, b.low), _mm256_sub_pd(a.high, b.high) }; }
+    STEREOWIDENER_TARGET("avx2") static inline Double mul(Double a, Double b){ return { _mm256_mul_pd(a.low, b.low), _mm256_mul_pd(a.high, b.high) }; }
+    STEREOWIDENER_TARGET("avx2") static inline Double to_double(Float a){
+        return { _mm256_cvtps_pd(_mm256_castps256_ps128(a)), _mm256_cvtps_pd(_mm256_extractf128_ps(a, 1)) };
+    }
+    STEREOWIDENER_TARGET("avx2") static inline Float to_float(Double a){
+        return _mm256_insertf128_ps(_mm256_castps128_ps256(_mm256_cvtpd_ps(a.low)), _mm256_cvtpd_ps(a.high), 1);
+    }
+};
+
+//==============================================================================
+struct Avx512Lanes{
+    enum{ width = 16 };
+    using Float = __m512;
+    struct Double{ __m512d low, high; };
+    using Mask = __mmask16;
+
+    STEREOWIDENER_TARGET("avx512f") static inline Float load(const float* p){ return _mm512_loadu_ps(p); }
+    STEREOWIDENER_TARGET("avx512f") static inline void store(float* p, Float a){ _mm512_storeu_ps(p, a); }
+    STEREOWIDENER_TARGET("avx512f") static inline Float set(float x){ return _mm512_set1_ps(x); }
+    STEREOWIDENER_TARGET("avx512f") static inline Float add(Float a, Float b){ return _mm512_add_ps(a, b); }
+    STEREOWIDENER_TARGET("avx512f") static inline Float sub(Float a, Float b){ return _mm512_sub_ps(a, b); }
+    STEREOWIDENER_TARGET("avx512f") static inline Float mul(Float a, Float b){ return _mm512_mul_ps(a, b); }
+    STEREOWIDENER_TARGET("avx512f") static inline Float abs(Float a){ return _mm512_abs_ps(a); }
+    STEREOWIDENER_TARGET("avx512f") static inline Mask greater(Float a, Float b){ return _mm512_cmp_ps_mask(a, b, _CMP_GT_OQ); }
+    STEREOWIDENER_TARGET("avx512f") static inline Mask both(Mask a, Mask b){ return (Mask) (a & b); }
+    STEREOWIDENER_TARGET("avx512f") static inline Float select(Mask m, Float a, Float b){ return _mm512_mask_blend_ps(m, b, a); }
+    STEREOWIDENER_TARGET("avx512f") static inline int bits(Mask m){ return (int) m; }
+
+    STEREOWIDENER_TARGET("avx512f") static inline Double load(const double* p){ return { _mm512_loadu_pd(p), _mm512_loadu_pd(p + 8) }; }
+    STEREOWIDENER_TARGET("avx512f") static inline void store(double* p, Double a){ _mm512_storeu_pd(p, a.low); _mm512_storeu_pd(p + 8, a.high); }
+    STEREOWIDENER_TARGET("avx512f") static inline Double set(double x){ return { _mm512_set1_pd(x), _mm512_set1_pd(x) }; }
+    STEREOWIDENER_TARGET("avx512f") static inline Double add(Double a, Double b){ return { _mm512_add_pd(a.low, b.low), _mm512_add_pd(a.high, b.high) }; }
+    STEREOWIDENER_TARGET("avx512f") static inline Double sub(Double a, Double b){ return { _mm512_sub_pd(a.low, b.low), _mm512_sub_pd(a.high, b.high) }; }
+    STEREOWIDENER_TARGET("avx512f") static inline Double mul(Double a, Double b){ return { _mm512_mul_pd(a.low, b.low), _mm512_mul_pd(a.high, b.high) }; }
+    STEREOWIDENER_TARGET("avx512f") static inline Double to_double(Float a){
+        return { _mm512_cvtps_pd(_mm512_castps512_ps256(a)),
+                 _mm512_cvtps_pd(_mm256_castpd_ps(_mm512_extractf64x4_pd(_mm512_castps_pd(a), 1))) };
+    }
+    STEREOWIDENER_TARGET("avx512f") static inline Float to_float(Double a){
+        const __m512d low = _mm512_castps_pd(_mm512_castps256_ps512(_mm512_cvtpd_ps(a.low)));
+        return _mm512_castpd_ps(_mm512_insertf64x4(low, _mm256_castps_pd(_mm512_cvtpd_ps(a.high)), 1));
+    }
+};
+#endif
+
+//==============================================================================
+//the kernels, written once for all tiers. They are inlined into the functions
+//of each tier below, which are compiled for its instruction set
+template <typename Lanes>
+STEREOWIDENER_INLINE void process_biquads_lanes(float* data, int numSamples, const float* coefficients, float* states, int numBiquads){
+    const int W = Lanes::width;
+    //one biquad at a time over the block keeps its state in registers
+    for (int q = 0; q < numBiquads; q++){
+        const float* c = coefficients + 5 * q;
+        float* state = states + 4 * W * q;
+        const auto b0 = Lanes::set(c[0]), b1 = Lanes::set(c[1]), b2 = Lanes::set(c[2]);
+        const auto a0 = Lanes::set(c[3]), a1 = Lanes::set(c[4]);
+        auto x1 = Lanes::load(state), x2 = Lanes::load(state + W);
+        auto y1 = Lanes::load(state + 2 * W), y2 = Lanes::load(state + 3 * W);
+        for (int i = 0; i < numSamples; i++){
+            const auto x = Lanes::load(data + i * W);
+            //the operations of BiquadFilter::process, in the same order
+            auto y = Lanes::mul(b0, x);
+            y = Lanes::add(y, Lanes::sub(Lanes::mul(b1, x1), Lanes::mul(a0, y1)));
+            y = Lanes::add(y, Lanes::sub(Lanes::mul(b2, x2), Lanes::mul(a1, y2)));
+            x2 = x1; x1 = x;
+            y2 = y1; y1 = y;
+            Lanes::store(data + i * W, y);
+        }
+        Lanes::store(state, x1);
+        Lanes::store(state + W, x2);
+        Lanes::store(state + 2 * W, y1);
+        Lanes::store(state + 3 * W, y2);
+    }
+}
+
+template <typename Lanes>
+STEREOWIDENER_INLINE void detect_transients_lanes(const float* input, float* dryGains, int numSamples, BatchWidener::TransientLanes& t){
+    const int W = Lanes::width;
+    const float peak_forget_factor = OnsetDetector::peak_forget_factor;
+    const float forget_factor = OnsetDetector::forget_factor;
+    const float threshold_scale = OnsetDetector::threshold_scale;
+    const auto peak_weight = Lanes::set((1.0f - peak_forget_factor) * threshold_scale);
+    const auto weight = Lanes::set((1.0f - forget_factor) * threshold_scale);
+    const auto peak_forget = Lanes::set(peak_forget_factor), forget = Lanes::set(forget_factor);
+    const auto attack = Lanes::set(t.attack_coeff), release = Lanes::set(t.release_coeff);
+
+    auto env_0 = Lanes::load(t.envelope);
+    auto env_1 = Lanes::load(t.last_envelope);
+    auto env_2 = Lanes::load(t.second_last_envelope);
+    auto thresh = Lanes::load(t.threshold);
+    auto mean = Lanes::load(t.running_mean);
+    if (t.num_samps > ULONG_MAX - (unsigned long) numSamples)
+        t.num_samps = 0;
+    double count = (double) t.num_samps;
+    double scaling = t.inv_num_samps;
+
+    for (int i = 0; i < numSamples; i++){
+        //leaky integrator, running mean and threshold as in OnsetDetector::process
+        const auto x = Lanes::load(input + i * W);
+        env_2 = env_1;
+        env_1 = env_0;
+        const auto coeff = Lanes::select(Lanes::greater(x, env_0), attack, release);
+        env_0 = Lanes::add(env_0, Lanes::mul(coeff, Lanes::sub(Lanes::abs(x), env_0)));
+
+        count += 1.0;
+        scaling = OnsetDetector::get_next_reciprocal(count, scaling);
+        mean = Lanes::add(mean, Lanes::mul(Lanes::set(scaling), Lanes::sub(Lanes::to_double(env_0), mean)));
+        const auto cur_mean = Lanes::to_float(mean);
+
+        const auto is_local_peak = Lanes::both(Lanes::greater(env_1, env_2), Lanes::greater(env_1, env_0));
+        thresh = Lanes::select(is_local_peak,
+                               Lanes::add(Lanes::mul(peak_weight, cur_mean), Lanes::mul(peak_forget, thresh)),
+                               Lanes::add(Lanes::mul(weight, cur_mean), Lanes::mul(forget, thresh)));
+        const auto is_rising = Lanes::both(Lanes::greater(env_1, env_2), Lanes::greater(env_0, env_1));
+        const int onsets = Lanes::bits(Lanes::both(is_rising, Lanes::greater(env_1, thresh)));
+
+        //the state machine of TransientHandler::detect, one lane at a time
+        float* gains = dryGains + i * W;
+        for (int l = 0; l < W; l++){
+            int position = t.position[l];
+            if (position == t.widened && ((onsets >> l) & 1) != 0)
+                position = 0;
+            gains[l] = t.gain_table[position];
+            t.position[l] = std::min(position + 1, t.widened);
+        }
+    }
+
+    Lanes::store(t.envelope, env_0);
+    Lanes::store(t.last_envelope, env_1);
+    Lanes::store(t.second_last_envelope, env_2);
+    Lanes::store(t.threshold, thresh);
+    Lanes::store(t.running_mean, mean);
+    t.num_samps += (unsigned long) numSamples;
+    t.inv_num_samps = scaling;
+}
+
+template <typename Lanes>
+STEREOWIDENER_INLINE void crossfade_lanes(float* output, const float* dry, const float* wet, const float* gains, int numSamples){
+    const auto one = Lanes::set(1.0f);
+    for (int i = 0; i < numSamples; i += Lanes::width){
+        const auto g = Lanes::load(gains + i);
+        Lanes::store(output + i, Lanes::add(Lanes::mul(g, Lanes::load(dry + i)), Lanes::mul(Lanes::sub(one, g), Lanes::load(wet + i))));
+    }
+}
+
+//==============================================================================
+void process_biquads_scalar(float* data, int numSamples, const float* coefficients, float* states, int numBiquads){
+    process_biquads_lanes<ScalarLanes>(data, numSamples, coefficients, states, numBiquads);
+}
+void detect_transients_scalar(const float* input, float* dryGains, int numSamples, BatchWidener::TransientLanes& lanes){
+    detect_transients_lanes<ScalarLanes>(input, dryGains, numSamples, lanes);
+}
+void crossfade_scalar(float* output, const float* dry, const float* wet, const float* gains, int numSamples){
+    crossfade_lanes<ScalarLanes>(output, dry, wet, gains, numSamples);
+}
+
+#if STEREOWIDENER_X86
+STEREOWIDENER_TARGET("sse4.2")
+void process_biquads_sse42(float* data, int numSamples, const float* coefficients, float* states, int numBiquads){
+    process_biquads_lanes<Sse42Lanes>(data, numSamples, coefficients, states, numBiquads);
+}
+STEREOWIDENER_TARGET("sse4.2")
+void detect_transients_sse42(const float* input, float* dryGains, int numSamples, BatchWidener::TransientLanes& lanes){
+    detect_transients_lanes<Sse42Lanes>(input, dryGains, numSamples, lanes);
+}
+STEREOWIDENER_TARGET("sse4.2")
+void crossfade_sse42(float* output, const float* dry, const float* wet, const float* gains, int numSamples){
+    crossfade_lanes<Sse42Lanes>(output, dry, wet, gains, numSamples);
+}
+
+STEREOWIDENER_TARGET("avx2")
+void process_biquads_avx2(float* data, int numSamples, const float* coefficients, float* states, int numBiquads){
+    process_biquads_lanes<Avx2Lanes>(data, numSamples, coefficients, states, numBiquads);
+}
+STEREOWIDENER_TARGET("avx2")
+void detect_transients_avx2(const float* input, float* dryGains, int numSamples, BatchWidener::TransientLanes& lanes){
+    detect_transients_lanes<Avx2Lanes>(input, dryGains, numSamples, lanes);
+}
+STEREOWIDENER_TARGET("avx2")
+void crossfade_avx2(float* output, const float* dry, const float* wet, const float* gains, int numSamples){
+    crossfade_lanes<Avx2Lanes>(output, dry, wet, gains, numSamples);
+}
+
+STEREOWIDENER_TARGET("avx512f")
+void process_biquads_avx512(float* data, int numSamples, const float* coefficients, float* states, int numBiquads){
+    process_biquads_lanes<Avx512Lanes>(data, numSamples, coefficients, states, numBiquads);
+}
+STEREOWIDENER_TARGET("avx512f")
+void detect_transients_avx512(const float* input, float* dryGains, int numSamples, BatchWidener::TransientLanes& lanes){
+    detect_transients_lanes<Avx512Lanes>(input, dryGains, numSamples, lanes);
+}
+STEREOWIDENER_TARGET("avx512f")
+void crossfade_avx512(float* output, const float* dry, const float* wet, const float* gains, int numSamples){
+    crossfade_lanes<Avx512Lanes>(output, dry, wet, gains, numSamples);
+}
+#endif
+
+const BatchWidener::LaneKernels& get_lane_kernels(SimdKernels::Tier tier){
+   #if STEREOWIDENER_X86
+    static const BatchWidener::LaneKernels tables[SimdKernels::numTiers] = {
+        { process_biquads_scalar, detect_transients_scalar, crossfade_scalar },
+        { process_biquads_sse42, detect_transients_sse42, crossfade_sse42 },
+        { process_biquads_avx2, detect_transients_avx2, crossfade_avx2 },
+        { process_biquads_avx512, detect_transients_avx512, crossfade_avx512 },
+    };
+    return tables[std::clamp((int) tier, 0, (int) SimdKernels::numTiers - 1)];
+   #else
+    (void) tier;
+    static const BatchWidener::LaneKernels scalar { process_biquads_scalar, detect_transients_scalar, crossfade_scalar };
+    return scalar;
+   #endif
+}
+}
+
+//==============================================================================
+BatchWidener::BatchWidener(){}
+BatchWidener::~BatchWidener(){}
+
+void BatchWidener::prepare(int numStreams, double sampleRate, int maxBlockSize){
+    kernels = &SimdKernels::get(SimdKernels::get_requested_tier());
+    lane_kernels = &get_lane_kernels(kernels->tier);
+    lane_width = SimdKernels::get_lane_width(kernels->tier);
+    num_streams = numStreams;
+    num_groups = (2 * numStreams + lane_width - 1) / lane_width;
+    max_block_size = maxBlockSize;
+    const int W = lane_width;
+
+    //the DSP classes are initialised as in prepareToPlay
+    velvet = std::make_unique<VelvetNoise>();
+    velvet->initialize(sampleRate, vnLenMs, density, targetDecaydB, true);
+    allpass = std::make_unique<AllpassBiquadCascade>();
+    allpass->initialize(numAllpassBiquads, sampleRate, maxGroupDelayMs);
+    amp_filters = std::make_unique<LinkwitzCrossover[]>(2);
+    energy_filters = std::make_unique<ButterworthFilter[]>(2);
+    amp_filters[0].initialize(sampleRate, "lowpass");
+    amp_filters[1].initialize(sampleRate, "highpass");
+    energy_filters[0].initialize(sampleRate, prewarpFreqHz, "lowpass");
+    energy_filters[1].initialize(sampleRate, prewarpFreqHz, "highpass");
+    pan = std::make_unique<Panner[]>(numFreqBands);
+    for (int k = 0; k < numFreqBands; k++)
+        pan[k].initialize();
+
+    vn_delays.resize((size_t) velvet->get_num_impulses());
+    vn_values.resize((size_t) velvet->get_num_impulses());
+    vn_max_delay = 0;
+    for (int k = 0; k < velvet->get_num_impulses(); k++){
+        vn_delays[k] = velvet->get_impulse_delay(k);
+        vn_values[k] = velvet->get_impulse_value(k);
+        vn_max_delay = std::max(vn_max_delay, vn_delays[k]);
+    }
+    allpass_coefficients.resize(5 * (size_t) numAllpassBiquads);
+    for (int q = 0; q < numAllpassBiquads; q++)
+        allpass->get_coefficients(q, &allpass_coefficients[5 * (size_t) q]);
+    amp_coefficients.resize(5 * (size_t) numFilters);
+    energy_coefficients.resize(5 * (size_t) (numFilters * numEnergyBiquads));
+
+    //the parameters start where the plugin's do
+    prev_width_lower = prev_width_higher = 0.0f;
+    prev_cutoff = 500.0f;
+    smooth_factor = std::exp(-1.0f / (smoothingTimeMs * 0.001f * sampleRate));
+    update_filter_coefficients();
+
+    //the cross-fade and the envelope follower come from a transient handler
+    //prepared at this sample rate
+    TransientHandler handler;
+    handler.prepare(1, (float) sampleRate);
+    gain_table = handler.get_gain_table();
+    const int widened = (int) gain_table.size() - 1;
+    const LeakyIntegrator& leaky = handler.get_onset_detector().get_envelope_follower();
+
+    groups.resize((size_t) num_groups);
+    for (auto& group : groups){
+        group.vn_history.assign((size_t) ((vn_max_delay + maxBlockSize) * W), 0.0f);
+        group.allpass_states.assign((size_t) (numAllpassBiquads * biquadStateSize * W), 0.0f);
+        group.amp_states.assign((size_t) (numFilters * biquadStateSize * W), 0.0f);
+        group.energy_states.assign((size_t) (numFilters * numEnergyBiquads * biquadStateSize * W), 0.0f);
+        group.transient_floats.assign((size_t) (4 * W), 0.0f);
+        group.running_mean.assign((size_t) W, 0.0);
+        group.position.assign((size_t) W, widened);
+        TransientLanes& t = group.transients;
+        t.envelope = &group.transient_floats[0];
+        t.last_envelope = &group.transient_floats[(size_t) W];
+        t.second_last_envelope = &group.transient_floats[2 * (size_t) W];
+        t.threshold = &group.transient_floats[3 * (size_t) W];
+        t.running_mean = group.running_mean.data();
+        t.position = group.position.data();
+        t.num_samps = 0;
+        t.inv_num_samps = 0.0;
+        t.attack_coeff = leaky.get_attack_coeff();
+        t.release_coeff = leaky.get_release_coeff();
+        t.gain_table = gain_table.data();
+        t.widened = widened;
+    }
+
+    const size_t blockSize = (size_t) (maxBlockSize * W);
+    for (auto* block : {&input_block, &decorr_block, &output_block, &panner_block, &gain_block})
+        block->assign(blockSize, 0.0f);
+    for (int k = 0; k < numFreqBands; k++){
+        band_input_block[k].assign(blockSize, 0.0f);
+        band_decorr_block[k].assign(blockSize, 0.0f);
+    }
+}
+
+void BatchWidener::reset(){
+    for (auto& group : groups){
+        for (auto* states : {&group.vn_history, &group.allpass_states, &group.amp_states, &group.energy_states, &group.transient_floats})
+            std::fill(states->begin(), states->end(), 0.0f);
+        std::fill(group.running_mean.begin(), group.running_mean.end(), 0.0);
+        std::fill(group.position.begin(), group.position.end(), group.transients.widened);
+        group.transients.num_samps = 0;
+        group.transients.inv_num_samps = 0.0;
+    }
+}
+
+void BatchWidener::set_parameters(float widthLower, float widthHigher, float cutoffFrequency,
+                                  bool isAmpPreserve, bool hasAllpassDecorrelation, bool handleTransients){
+    target_width_lower = widthLower;
+    target_width_higher = widthHigher;
+    target_cutoff = cutoffFrequency;
+    amp_preserve = isAmpPreserve;
+    allpass_decorrelation = hasAllpassDecorrelation;
+    handle_transients = handleTransients;
+}
+
+void BatchWidener::reset_parameter_smoothing(){
+    prev_width_lower = target_width_lower;
+    prev_width_higher = target_width_higher;
+    prev_cutoff = target_cutoff;
+    pan[0].updateWidth(prev_width_lower/100.0);
+    pan[1].updateWidth(prev_width_higher/100.0);
+    for (int k = 0; k < 2; k++){
+        amp_filters[k].update(prev_cutoff);
+        energy_filters[k].update(prev_cutoff);
+    }
+    update_filter_coefficients();
+}
+
+inline float BatchWidener::one_pole_filter(float input, float previous_output){
+    return (input * (1.0f-smooth_factor)) + (previous_output * smooth_factor);
+}
+
+void BatchWidener::update_filter_coefficients(){
+    //even filters are lowpass, odd ones highpass
+    for (int f = 0; f < numFilters; f++){
+        amp_filters[f % 2].get_coefficients(&amp_coefficients[5 * (size_t) f]);
+        for (int q = 0; q < numEnergyBiquads; q++)
+            energy_filters[f % 2].get_coefficients(q, &energy_coefficients[5 * (size_t) (f * numEnergyBiquads + q)]);
+    }
+}
+
+void BatchWidener::process(const float* const* inputs, float* const* outputs, int numSamples){
+    ScopedFlushToZero noDenormals;
+    jassert(numSamples <= max_block_size);
+
+    //the parameters move once per block, as in processBlock
+    if (prev_width_lower != target_width_lower){
+        prev_width_lower = one_pole_filter(target_width_lower, prev_width_lower);
+        pan[0].updateWidth(prev_width_lower/100.0);
+    }
+    if (prev_width_higher != target_width_higher){
+        prev_width_higher = one_pole_filter(target_width_higher, prev_width_higher);
+        pan[1].updateWidth(prev_width_higher/100.0);
+    }
+    if (prev_cutoff != target_cutoff){
+        prev_cutoff = one_pole_filter(target_cutoff, prev_cutoff);
+        for (int k = 0; k < 2; k++){
+            amp_filters[k].update(prev_cutoff);
+            energy_filters[k].update(prev_cutoff);
+        }
+        update_filter_coefficients();
+    }
+
+    const int W = lane_width;
+    const int count = numSamples * W;
+    const int numChannels = 2 * num_streams;
+    float* input = input_block.data();
+    float* decorr = decorr_block.data();
+    float* output = output_block.data();
+
+    for (int g = 0; g < num_groups; g++){
+        Group& group = groups[g];
+        const int firstChannel = g * W;
+        const int numLanes = std::min(W, numChannels - firstChannel);
+
+        //interleave the channels of the group, the unused lanes are silent
+        for (int l = 0; l < W; l++){
+            if (l < numLanes){
+                const float* channelIn = inputs[firstChannel + l];
+                for (int i = 0; i < numSamples; i++)
+                    input[i * W + l] = channelIn[i];
+            }
+            else{
+                for (int i = 0; i < numSamples; i++)
+                    input[i * W + l] = 0.0f;
+            }
+        }
+
+        //decorrelation, the velvet noise impulses are added over the whole group
+        if (allpass_decorrelation){
+            std::copy(input, input + count, decorr);
+            lane_kernels->process_biquads(decorr, numSamples, allpass_coefficients.data(), group.allpass_states.data(), numAllpassBiquads);
+        }
+        else{
+            float* history = group.vn_history.data();
+            std::copy(input, input + count, history + vn_max_delay * W);
+            std::fill(decorr, decorr + count, 0.0f);
+            for (size_t k = 0; k < vn_delays.size(); k++)
+                kernels->multiply_add(decorr, history + (vn_max_delay - vn_delays[k]) * W, vn_values[k], count);
+            std::memmove(history, history + count, sizeof(float) * (size_t) (vn_max_delay * W));
+        }
+
+        //filterbank, input band k is filter k and decorrelated band k is filter numFreqBands + k
+        for (int k = 0; k < numFreqBands; k++){
+            float* filtered_input = band_input_block[k].data();
+            float* filtered_decorr_output = band_decorr_block[k].data();
+            std::copy(input, input + count, filtered_input);
+            std::copy(decorr, decorr + count, filtered_decorr_output);
+            const int decorrFilter = numFreqBands + k;
+            if (amp_preserve){
+                lane_kernels->process_biquads(filtered_input, numSamples, &amp_coefficients[5 * (size_t) k],
+                                              &group.amp_states[(size_t) (k * biquadStateSize * W)], 1);
+                lane_kernels->process_biquads(filtered_decorr_output, numSamples, &amp_coefficients[5 * (size_t) decorrFilter],
+                                              &group.amp_states[(size_t) (decorrFilter * biquadStateSize * W)], 1);
+            }
+            else{
+                lane_kernels->process_biquads(filtered_input, numSamples, &energy_coefficients[5 * (size_t) (k * numEnergyBiquads)],
+                                              &group.energy_states[(size_t) (k * numEnergyBiquads * biquadStateSize * W)], numEnergyBiquads);
+                lane_kernels->process_biquads(filtered_decorr_output, numSamples, &energy_coefficients[5 * (size_t) (decorrFilter * numEnergyBiquads)],
+                                              &group.energy_states[(size_t) (decorrFilter * numEnergyBiquads * biquadStateSize * W)], numEnergyBiquads);
+            }
+        }
+
+        //panning, the bands are added up
+        for (int k = 0; k < numFreqBands; k++){
+            const float* panner_inputs[2] = {band_decorr_block[k].data(), band_input_block[k].data()};
+            float* panner_output = (k == 0) ? output : panner_block.data();
+            pan[k].process_block(panner_inputs, panner_output, count, *kernels);
+            if (k > 0)
+                for (int i = 0; i < count; i++)
+                    output[i] += panner_output[i];
+        }
+
+        //transient handling
+        if (handle_transients){
+            lane_kernels->detect_transients(input, gain_block.data(), numSamples, group.transients);
+            lane_kernels->crossfade(output, input, output, gain_block.data(), count);
+        }
+
+        for (int l = 0; l < numLanes; l++){
+            float* channelOut = outputs[firstChannel + l];
+            for (int i = 0; i < numSamples; i++)
+                channelOut[i] = output[i * W + l];
+        }
+    }
+}
@@ -0,0 +1,148 @@
+/*
+  ==============================================================================
+
+    BatchWidener.h
+    Widens many independent stereo streams with the same settings at once.
+    Every channel of every stream is a lane of a SIMD register (4, 8 or 16
+    floats, from the instruction set tier picked as in SimdKernels), and the
+    channels of a group of lanes are interleaved sample by sample, so every
+    stage runs one register per sample for the whole group: the velvet noise
+    or allpass decorrelator, the filterbank, the panners and the transient
+    detector. All streams share the filter coefficients, the panner angles
+    and the parameter smoothing, and have their own filter states and
+    transient detectors.
+
+    Each lane gives the same output as the time domain engine of the plugin
+    with the same parameters, bit for bit. Only the plugin's default modes are
+    supported: no transient lookahead, independent and full-band transient
+    detection, no multirate low band and no mid decorrelation. The velvet
+    noise sequence is the generated one, not the optimised filters.
+
+  ==============================================================================
+*/
+
+#pragma once
+#include "DspCore.h"
+#include "SimdKernels.h"
+#include "VelvetNoise.h"
+#include "AllpassBiquadCascade.h"
+#include "LinkwitzCrossover.h"
+#include "ButterworthFilter.h"
+#include "Panner.h"
+
+class BatchWidener{
+public:
+    BatchWidener();
+    ~BatchWidener();
+
+    //allocates everything, process does not allocate
+    void prepare(int numStreams, double sampleRate, int maxBlockSize);
+    //clears the filter states and transient detectors, for a new batch of streams
+    void reset();
+    //the plugin's parameters, widths in percent and the cutoff in Hz. The widths
+    //and the cutoff move towards them once per block, as in the plugin
+    void set_parameters(float widthLower, float widthHigher, float cutoffFrequency,
+                        bool isAmpPreserve, bool hasAllpassDecorrelation, bool handleTransients);
+    //jump to the parameters instead of smoothing towards them
+    void reset_parameter_smoothing();
+    //channel c of stream s is inputs[2 * s + c]. The outputs can be the inputs
+    void process(const float* const* inputs, float* const* outputs, int numSamples);
+
+    int get_num_streams() const { return num_streams; }
+    int get_lane_width() const { return lane_width; }
+    SimdKernels::Tier get_tier() const { return kernels->tier; }
+
+    //the state of the transient handlers of a group of lanes. The state machine
+    //of TransientHandler is a position in its gain table (see
+    //TransientHandler::get_gain_table): 0 at an onset, and widened after the
+    //inhibit time
+    struct TransientLanes{
+        float* envelope;                        //last 3 samples of the envelopes
+        float* last_envelope;
+        float* second_last_envelope;
+        float* threshold;
+        double* running_mean;
+        int* position;
+        unsigned long num_samps;                //the same for all lanes
+        double inv_num_samps;                   //1 / num_samps, see OnsetDetector::get_next_reciprocal
+        float attack_coeff, release_coeff;
+        const float* gain_table;                //gain of the input at each position, from TransientHandler
+        int widened;                            //last position, onsets are detected there
+    };
+
+    //kernels over a group of interleaved lanes, one table per tier
+    struct LaneKernels{
+        //the biquads one after the other, in place. Each biquad has b0, b1, b2,
+        //a0, a1 in coefficients and x1, x2, y1, y2 of every lane in states
+        void (*process_biquads)(float* data, int numSamples, const float* coefficients, float* states, int numBiquads);
+        //the onset detector and state machine of TransientHandler, the gains of the input
+        void (*detect_transients)(const float* input, float* dryGains, int numSamples, TransientLanes& lanes);
+        //output[i] = gains[i] * dry[i] + (1 - gains[i]) * wet[i], output can be wet
+        void (*crossfade)(float* output, const float* dry, const float* wet, const float* gains, int numSamples);
+    };
+
+private:
+    void update_filter_coefficients();
+    inline float one_pole_filter(float input, float previous_output);
+
+    //as in the plugin
+    enum{
+        vnLenMs = 15,
+        density = 1000,
+        targetDecaydB = 10,
+        numAllpassBiquads = 200,
+        maxGroupDelayMs = 15,
+        prewarpFreqHz = 1000,
+        smoothingTimeMs = 10,
+        numFreqBands = 2,
+        numFilters = 4,                         //input low and high band, decorrelated low and high band
+        numEnergyBiquads = 4,
+        biquadStateSize = 4,
+    };
+
+    const SimdKernels* kernels = nullptr;
+    const LaneKernels* lane_kernels = nullptr;
+    int num_streams = 0;
+    int num_groups = 0;
+    int lane_width = 4;
+    int max_block_size = 0;
+
+    //the coefficients of the plugin's DSP classes, the same for all lanes
+    std::unique_ptr<VelvetNoise> velvet;
+    std::unique_ptr<AllpassBiquadCascade> allpass;
+    std::unique_ptr<LinkwitzCrossover[]> amp_filters;       //lowpass, highpass
+    std::unique_ptr<ButterworthFilter[]> energy_filters;
+    std::unique_ptr<Panner[]> pan;                          //per band
+    std::vector<int> vn_delays;
+    std::vector<float> vn_values;
+    int vn_max_delay = 0;
+    std::vector<float> allpass_coefficients;
+    std::vector<float> amp_coefficients;                    //per filter
+    std::vector<float> energy_coefficients;
+    std::vector<float> gain_table;
+
+    //per group of lanes
+    struct Group{
+        std::vector<float> vn_history;                      //the input of the longest delay, then the block
+        std::vector<float> allpass_states;
+        std::vector<float> amp_states;                      //per filter
+        std::vector<float> energy_states;
+        std::vector<float> transient_floats;
+        std::vector<double> running_mean;
+        std::vector<int> position;
+        TransientLanes transients;
+    };
+    std::vector<Group> groups;
+
+    //block buffers of one group, [sample][lane]
+    std::vector<float> input_block, decorr_block, output_block, panner_block, gain_block;
+    std::vector<float> band_input_block[numFreqBands], band_decorr_block[numFreqBands];
+
+    //parameters
+    float target_width_lower = 0.0f, target_width_higher = 0.0f, target_cutoff = 500.0f;
+    float prev_width_lower = 0.0f, prev_width_higher = 0.0f, prev_cutoff = 500.0f;
+    bool amp_preserve = false, allpass_decorrelation = false, handle_transients = false;
+    float smooth_factor = 0.0f;
+
+    STEREOWIDENER_NON_COPYABLE (BatchWidener)
+};
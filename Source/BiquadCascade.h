@@ -9,7 +9,7 @@
 */
 
 #pragma once
-#include "JuceHeader.h"
+#include "DspCore.h"
 #include "BiquadFilter.h"
 #include <random>
 
@@ -22,6 +22,9 @@ public:
     void initialize(int numBq, float sR, float** b, float** a);
     void update(float** b_new, float** a_new);
     float process(const float input);
+    int get_num_biquads() const { return numBiquads; }
+    //b0, b1, b2, a0, a1 of one biquad
+    void get_coefficients(int biquad, float* coefficients) const { biquads[biquad].get_coefficients(coefficients); }
     
     
 private:
@@ -37,6 +37,11 @@ void BiquadFilter::update(float b0, float b1, float b2, float a0, float a1){
     b[0] = b0; b[1] = b1; b[2] = b2;
 }
 
+void BiquadFilter::get_coefficients(float* coefficients) const{
+    coefficients[0] = b[0]; coefficients[1] = b[1]; coefficients[2] = b[2];
+    coefficients[3] = a[0]; coefficients[4] = a[1];
+}
+
 float BiquadFilter::process(const float input){
     float output = b[0] * input;
     for (int i = 0; i < order; i++){
@@ -9,7 +9,7 @@
 */
 
 #pragma once
-#include "JuceHeader.h"
+#include "DspCore.h"
 #include <complex>
 
 
@@ -22,6 +22,8 @@ public:
     void initialize(float b0, float b1, float b2, float a0, float a1);
     void update(float b0, float b1, float b2, float a0, float a1);
     float process(const float input);
+    //b0, b1, b2, a0, a1
+    void get_coefficients(float* coefficients) const;
     
     
 private:
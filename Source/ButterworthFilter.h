@@ -21,13 +21,16 @@ public:
     void update(float newCutoffFreq);
     void setCoefficients();
     float process(const float input);
+    int get_num_biquads() const { return biquadCascade.get_num_biquads(); }
+    //b0, b1, b2, a0, a1 of one biquad
+    void get_coefficients(int biquad, float* coefficients) const { biquadCascade.get_coefficients(biquad, coefficients); }
     
     
 private:
     const float PI = std::acos(-1);
     const int order = 8;       //filter order
     bool lowpass;               //type of filter, 'lowpass' or 'highpass'
-    float numBiquads;
+    int numBiquads;
     float sample_rate;
     float cutoff_frequency = 500;    //cutoff frequency in Hz
     float bilinear_warp_factor;
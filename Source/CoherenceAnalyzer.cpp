@@ -0,0 +1,206 @@
+/*
+  ==============================================================================
+
+    CoherenceAnalyzer.cpp
+
+  ==============================================================================
+*/
+
+#include "CoherenceAnalyzer.h"
+
+CoherenceAnalyzer::CoherenceAnalyzer() : juce::Thread("StereoWidener coherence analysis"){
+    for (int band = 0; band < maxBands; band++)
+        band_frequencies[band] = 0.0f;
+    for (int signal = 0; signal < 2; signal++){
+        for (int band = 0; band <= maxBands; band++){
+            coherence[signal][band] = 0.0f;
+            correlation[signal][band] = 0.0f;
+        }
+    }
+}
+
+CoherenceAnalyzer::~CoherenceAnalyzer(){
+    stopThread(1000);
+}
+
+void CoherenceAnalyzer::prepare(double sampleRate){
+    const juce::ScopedLock sl (lock);
+    stopThread(1000);
+    prepared = false;
+
+    sample_rate = sampleRate;
+    frame_size = juce::nextPowerOfTwo((int) std::ceil(sampleRate * frameLengthMs * 0.001));
+    num_bins = frame_size / 2 + 1;
+    fft = std::make_unique<juce::dsp::FFT>(juce::findHighestSetBit((juce::uint32) frame_size));
+
+    const float PI = std::acos(-1.0f);
+    window.resize((size_t) frame_size);
+    for (int n = 0; n < frame_size; n++)
+        window[n] = 0.5f * (1.0f - std::cos(2.0f * PI * n / frame_size));
+    for (int chan = 0; chan < numFrameChannels; chan++)
+        spectra[chan].assign(2 * (size_t) frame_size, 0.0f);
+
+    //bands of at least one ERB, as many as fit in maxBands
+    auto erb_number = [] (double frequency){ return 21.4 * std::log10(1.0 + 0.00437 * frequency); };
+    auto erb_frequency = [] (double erbNumber){ return (std::pow(10.0, erbNumber / 21.4) - 1.0) / 0.00437; };
+    const double lowest = erb_number(minFrequencyHz);
+    const double highest = erb_number(juce::jmin((double) maxFrequencyHz, 0.45 * sampleRate));
+    const double bandwidth = juce::jmax(1.0, (highest - lowest) / maxBands);
+    const int numBands = juce::jlimit(1, (int) maxBands, (int) ((highest - lowest) / bandwidth));
+    band_edges.resize((size_t) numBands + 1);
+    for (int band = 0; band <= numBands; band++){
+        const int bin = juce::roundToInt(erb_frequency(lowest + band * bandwidth) * frame_size / sampleRate);
+        //every band has at least one bin
+        band_edges[band] = (band == 0) ? juce::jmax(1, bin) : juce::jmax(band_edges[band - 1] + 1, bin);
+        if (band < numBands)
+            band_frequencies[band] = (float) erb_frequency(lowest + (band + 0.5) * bandwidth);
+    }
+    num_bands = numBands;
+
+    //frames analysed are frame_size * frameDecimation samples apart
+    smoothing = std::exp(-(double) (frame_size * frameDecimation) / (averagingTimeMs * 0.001 * sampleRate));
+
+    slots.assign((size_t) ((numSlots + 1) * numFrameChannels * frame_size), 0.0f);
+    slot_generations.assign((size_t) numSlots + 1, -1);
+    fifo.reset();
+    period_position = 0;
+    write_slot = -1;
+    push_generation = generation.load();
+
+    prepared = true;
+    if (enabled)
+        startThread();
+}
+
+void CoherenceAnalyzer::set_enabled(bool shouldBeEnabled){
+    const juce::ScopedLock sl (lock);
+    if (shouldBeEnabled && ! enabled){
+        //the analysis thread is stopped, so the frames left over from the last time
+        //can be dropped here. A frame the audio thread is still copying is from the
+        //old generation and is dropped by the analysis thread
+        stopThread(1000);
+        generation++;
+        fifo.finishedRead(fifo.getNumReady());
+    }
+    enabled = shouldBeEnabled;
+    if (enabled && prepared)
+        startThread();
+    else
+        stopThread(1000);
+}
+
+void CoherenceAnalyzer::push(const float* inputLeft, const float* inputRight, const float* outputLeft, const float* outputRight, int numSamples){
+    if (! enabled || ! prepared)
+        return;
+
+    const float* sources[numFrameChannels] = {inputLeft, inputRight, outputLeft, outputRight};
+    const int period = frame_size * frameDecimation;
+    //a frame that started before the analysis was turned off and on again is
+    //copied again from the start, into the same slot
+    const int current_generation = generation.load();
+    if (current_generation != push_generation){
+        push_generation = current_generation;
+        period_position = 0;
+    }
+    int i = 0;
+    while (i < numSamples){
+        if (period_position == 0){
+            //the whole frame goes to one slot, or is dropped
+            int start1, size1, start2, size2;
+            fifo.prepareToWrite(1, start1, size1, start2, size2);
+            write_slot = (size1 > 0) ? start1 : (size2 > 0 ? start2 : -1);
+        }
+        if (period_position < frame_size){
+            const int length = juce::jmin(frame_size - period_position, numSamples - i);
+            if (write_slot >= 0){
+                float* slot = &slots[(size_t) (write_slot * numFrameChannels * frame_size)];
+                for (int chan = 0; chan < numFrameChannels; chan++)
+                    juce::FloatVectorOperations::copy(slot + chan * frame_size + period_position, sources[chan] + i, length);
+            }
+            period_position += length;
+            i += length;
+            if (period_position == frame_size && write_slot >= 0){
+                slot_generations[(size_t) write_slot] = push_generation;
+                fifo.finishedWrite(1);
+                write_slot = -1;
+            }
+        }
+        else{
+            const int length = juce::jmin(period - period_position, numSamples - i);
+            period_position += length;
+            i += length;
+        }
+        if (period_position == period)
+            period_position = 0;
+    }
+}
+
+void CoherenceAnalyzer::run(){
+    //the averages start over every time the analysis is enabled
+    const int numBands = num_bands;
+    const int run_generation = generation.load();
+    for (int signal = 0; signal < 2; signal++){
+        auto_left[signal].assign((size_t) numBands + 1, 0.0);
+        auto_right[signal].assign((size_t) numBands + 1, 0.0);
+        cross_re[signal].assign((size_t) numBands + 1, 0.0);
+        cross_im[signal].assign((size_t) numBands + 1, 0.0);
+    }
+
+    while (! threadShouldExit()){
+        while (fifo.getNumReady() > 0 && ! threadShouldExit()){
+            int start1, size1, start2, size2;
+            fifo.prepareToRead(1, start1, size1, start2, size2);
+            const int slot = (size1 > 0) ? start1 : start2;
+            if (slot_generations[(size_t) slot] == run_generation)
+                analyse_frame(&slots[(size_t) (slot * numFrameChannels * frame_size)]);
+            fifo.finishedRead(1);
+        }
+        wait(pollIntervalMs);
+    }
+}
+
+void CoherenceAnalyzer::analyse_frame(const float* frame){
+    for (int chan = 0; chan < numFrameChannels; chan++){
+        float* data = spectra[chan].data();
+        juce::FloatVectorOperations::multiply(data, frame + chan * frame_size, window.data(), frame_size);
+        fft->performRealOnlyForwardTransform(data, true);
+    }
+
+    const int numBands = num_bands;
+    for (int signal = 0; signal < 2; signal++){
+        const float* left = spectra[2 * signal].data();
+        const float* right = spectra[2 * signal + 1].data();
+        //the last entry is the whole spectrum, DC excluded
+        for (int band = 0; band <= numBands; band++){
+            const int first = (band < numBands) ? band_edges[band] : 1;
+            const int end = (band < numBands) ? band_edges[band + 1] : num_bins;
+            double sum_left = 0.0, sum_right = 0.0, sum_re = 0.0, sum_im = 0.0;
+            for (int k = first; k < end; k++){
+                const double lr = left[2 * k], li = left[2 * k + 1];
+                const double rr = right[2 * k], ri = right[2 * k + 1];
+                sum_left += lr * lr + li * li;
+                sum_right += rr * rr + ri * ri;
+                //left times the conjugate of right
+                sum_re += lr * rr + li * ri;
+                sum_im += li * rr - lr * ri;
+            }
+
+            auto_left[signal][band] = smoothing * auto_left[signal][band] + (1.0 - smoothing) * sum_left;
+            auto_right[signal][band] = smoothing * auto_right[signal][band] + (1.0 - smoothing) * sum_right;
+            cross_re[signal][band] = smoothing * cross_re[signal][band] + (1.0 - smoothing) * sum_re;
+            cross_im[signal][band] = smoothing * cross_im[signal][band] + (1.0 - smoothing) * sum_im;
+
+            //silent bands read as 0
+            const double norm = std::sqrt(auto_left[signal][band] * auto_right[signal][band]);
+            const int index = (band < numBands) ? band : (int) maxBands;
+            if (norm > 1e-12){
+                coherence[signal][index] = (float) (std::hypot(cross_re[signal][band], cross_im[signal][band]) / norm);
+                correlation[signal][index] = (float) (cross_re[signal][band] / norm);
+            }
+            else{
+                coherence[signal][index] = 0.0f;
+                correlation[signal][index] = 0.0f;
+            }
+        }
+    }
+}
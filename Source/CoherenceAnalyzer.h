@@ -0,0 +1,103 @@
+/*
+  ==============================================================================
+
+    CoherenceAnalyzer.h
+    Real-time interchannel coherence of the input and the output, per ERB
+    band. The audio thread copies every frameDecimation-th frame of the
+    stereo input and output into a slot of a lock-free FIFO, and does
+    nothing else; a frame is dropped when no slot is free. A background
+    thread, which runs only while the analysis is enabled, windows the
+    frames, accumulates the auto and cross spectra of each band over time,
+    and publishes the results through atomics.
+
+    The correlation of a band is calculate_interchannel_coherence in
+    Python/src/utils.py applied to the band, Re(Sxy) / sqrt(Sxx Syy), but
+    keeping its sign. The coherence is |Sxy| / sqrt(Sxx Syy), which also
+    counts the channels as coherent when they differ only in phase.
+
+  ==============================================================================
+*/
+
+#pragma once
+#include "JuceHeader.h"
+
+class CoherenceAnalyzer : private juce::Thread{
+public:
+    CoherenceAnalyzer();
+    ~CoherenceAnalyzer() override;
+
+    //message thread, not while the audio thread pushes
+    void prepare(double sampleRate);
+    //message thread, the editor analyses while it is open
+    void set_enabled(bool shouldBeEnabled);
+
+    //audio thread, once per block. The input has to be aligned with the output
+    void push(const float* inputLeft, const float* inputRight, const float* outputLeft, const float* outputRight, int numSamples);
+
+    //any thread
+    int get_num_bands() const { return num_bands; }
+    float get_band_frequency(int band) const { return band_frequencies[band]; }
+    float get_coherence(int signal, int band) const { return coherence[signal][band]; }
+    float get_correlation(int signal, int band) const { return correlation[signal][band]; }
+    //over the whole spectrum
+    float get_broadband_coherence(int signal) const { return coherence[signal][maxBands]; }
+    float get_broadband_correlation(int signal) const { return correlation[signal][maxBands]; }
+
+    enum{
+        inputSignal = 0,
+        outputSignal,
+        maxBands = 48,
+    };
+
+private:
+    void run() override;
+    void analyse_frame(const float* frame);
+
+    enum{
+        frameLengthMs = 85,
+        frameDecimation = 2,                    //frames copied, one in this many
+        numSlots = 4,
+        averagingTimeMs = 500,
+        minFrequencyHz = 50,
+        maxFrequencyHz = 16000,
+        pollIntervalMs = 20,
+        numFrameChannels = 4,                   //input left and right, output left and right
+    };
+
+    juce::CriticalSection lock;                 //prepare and set_enabled
+    std::atomic<bool> enabled { false };
+    std::atomic<bool> prepared { false };
+    double sample_rate = 44100.0;
+    int frame_size = 0;
+    int num_bins = 0;
+
+    //hand-off, the FIFO counts slots of numFrameChannels * frame_size samples
+    juce::AbstractFifo fifo { numSlots + 1 };
+    std::vector<float> slots;
+    //counts the times the analysis was enabled. Each slot keeps the count of when
+    //its frame started, so that audio from before the analysis was last turned off
+    //is never analysed
+    std::atomic<int> generation { 0 };
+    std::vector<int> slot_generations;
+
+    //audio thread
+    int period_position = 0;                    //position in frame_size * frameDecimation
+    int write_slot = -1;                        //slot of the frame being copied, -1 if dropped
+    int push_generation = 0;                    //generation of the frame being copied
+
+    //analysis thread
+    std::unique_ptr<juce::dsp::FFT> fft;
+    std::vector<float> window;
+    std::vector<float> spectra[numFrameChannels];
+    std::vector<int> band_edges;                //first bin of each band, and the end of the last
+    std::vector<double> auto_left[2], auto_right[2], cross_re[2], cross_im[2];  //per band, and the whole spectrum
+    double smoothing = 0.0;
+
+    //results
+    std::atomic<int> num_bands { 0 };
+    std::atomic<float> band_frequencies[maxBands];
+    std::atomic<float> coherence[2][maxBands + 1];
+    std::atomic<float> correlation[2][maxBands + 1];
+
+    JUCE_DECLARE_NON_COPYABLE (CoherenceAnalyzer)
+};
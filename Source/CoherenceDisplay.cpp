@@ -0,0 +1,55 @@
+/*
+  ==============================================================================
+
+    CoherenceDisplay.cpp
+
+  ==============================================================================
+*/
+
+#include "CoherenceDisplay.h"
+
+CoherenceDisplay::CoherenceDisplay(CoherenceAnalyzer& analyzer) : coherence_analyzer(analyzer){
+    coherence_analyzer.set_enabled(true);
+    startTimerHz(refreshHz);
+}
+
+CoherenceDisplay::~CoherenceDisplay(){
+    stopTimer();
+    coherence_analyzer.set_enabled(false);
+}
+
+void CoherenceDisplay::timerCallback(){
+    repaint();
+}
+
+void CoherenceDisplay::paint(juce::Graphics& g){
+    auto bounds = getLocalBounds().toFloat();
+    const auto input_colour = juce::Colours::grey;
+    const auto output_colour = juce::Colours::orange;
+
+    //broadband correlation, as calculate_interchannel_coherence
+    g.setFont(juce::Font("Times New Roman", 12.0f, juce::Font::plain));
+    g.setColour(juce::Colours::lightgrey);
+    const juce::String text = "Coherence per ERB band, correlation in "
+        + juce::String(coherence_analyzer.get_broadband_correlation(CoherenceAnalyzer::inputSignal), 2)
+        + ", out " + juce::String(coherence_analyzer.get_broadband_correlation(CoherenceAnalyzer::outputSignal), 2);
+    g.drawText(text, bounds.removeFromTop((float) textHeight), juce::Justification::centredLeft, true);
+
+    g.setColour(juce::Colours::black.withAlpha(0.3f));
+    g.fillRect(bounds);
+    const int numBands = coherence_analyzer.get_num_bands();
+    if (numBands == 0)
+        return;
+
+    //the input as an outline, the output filled in front of it
+    const float band_width = bounds.getWidth() / numBands;
+    for (int band = 0; band < numBands; band++){
+        const float x = bounds.getX() + band * band_width;
+        const float input_height = juce::jlimit(0.0f, 1.0f, coherence_analyzer.get_coherence(CoherenceAnalyzer::inputSignal, band)) * bounds.getHeight();
+        const float output_height = juce::jlimit(0.0f, 1.0f, coherence_analyzer.get_coherence(CoherenceAnalyzer::outputSignal, band)) * bounds.getHeight();
+        g.setColour(output_colour);
+        g.fillRect(x + 1.0f, bounds.getBottom() - output_height, band_width - 2.0f, output_height);
+        g.setColour(input_colour);
+        g.drawRect(x + 1.0f, bounds.getBottom() - input_height, band_width - 2.0f, input_height, 1.0f);
+    }
+}
@@ -0,0 +1,32 @@
+/*
+  ==============================================================================
+
+    CoherenceDisplay.h
+    Interchannel coherence of the input and the output in each ERB band,
+    from the CoherenceAnalyzer of the processor. The analysis runs while
+    the display exists.
+
+  ==============================================================================
+*/
+
+#pragma once
+#include "JuceHeader.h"
+#include "CoherenceAnalyzer.h"
+
+class CoherenceDisplay : public juce::Component, private juce::Timer{
+public:
+    CoherenceDisplay(CoherenceAnalyzer& analyzer);
+    ~CoherenceDisplay() override;
+
+    void paint(juce::Graphics& g) override;
+
+private:
+    void timerCallback() override;
+    enum{
+        refreshHz = 10,
+        textHeight = 16,
+    };
+    CoherenceAnalyzer& coherence_analyzer;
+
+    JUCE_DECLARE_NON_COPYABLE (CoherenceDisplay)
+};
@@ -34,3 +34,30 @@ void DelayLine::prepare(const int L, const float sampleRate){
 }
 
 
+AlignmentDelay::AlignmentDelay(){}
+AlignmentDelay::~AlignmentDelay(){}
+
+void AlignmentDelay::prepare(const int maxLength){
+    jassert(maxLength >= 0);
+    size = maxLength + 1;
+    buffer.assign((size_t) size, 0.0f);
+    writePtr = 0;
+    length = 0;
+}
+
+void AlignmentDelay::setLength(const int L){
+    jassert(L >= 0 && L < size);
+    //the sample written k samples ago is read L - k samples from now, the ones
+    //older than the previous delay are stale
+    for (int k = length + 1; k <= L; k++){
+        int index = writePtr - k;
+        if (index < 0)
+            index += size;
+        buffer[(size_t) index] = 0.0f;
+    }
+    length = L;
+}
+
+void AlignmentDelay::clear(){
+    std::fill(buffer.begin(), buffer.end(), 0.0f);
+}
@@ -9,7 +9,7 @@
 */
 
 #pragma once
-#include "JuceHeader.h"
+#include "DspCore.h"
 
 class DelayLine{
 public:
@@ -36,6 +36,12 @@ public:
         delayBuffer[writePtr] = input;
     }
 
+    //change the delay length without clearing the buffer
+    inline void setLength(const int L) {
+        jassert(L >= 0 && L < maxDelay);
+        length = L;
+    }
+
     //update pointers
     inline void update() {
         --writePtr;
@@ -56,3 +62,37 @@ private:
     float delayBuffer[maxDelay];
     int readPtr = 0, writePtr = 0, length;
 };
+
+
+//a delay of at most a few thousand samples that lines up two signal paths
+//(transient lookahead, multirate and engine latency). The buffer is allocated
+//in prepare, and the delay can change on the audio thread up to that length
+class AlignmentDelay{
+public:
+    AlignmentDelay();
+    ~AlignmentDelay();
+    
+    //allocates the buffer, the delay is 0
+    void prepare(const int maxLength);
+    //change the delay. When it grows, the samples older than the previous
+    //delay are cleared, so that the line does not replay stale samples
+    void setLength(const int L);
+    //clears the whole buffer, at most maxLength + 1 samples
+    void clear();
+    int getLength() const noexcept { return length; }
+    
+    //write a sample and read the one written length samples before it
+    inline float process(const float input) noexcept {
+        buffer[writePtr] = input;
+        int readPtr = writePtr - length;
+        if (readPtr < 0)
+            readPtr += size;
+        if (++writePtr == size)
+            writePtr = 0;
+        return buffer[readPtr];
+    }
+    
+private:
+    std::vector<float> buffer;
+    int size = 1, writePtr = 0, length = 0;
+};
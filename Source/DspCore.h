@@ -0,0 +1,30 @@
+/*
+  ==============================================================================
+
+    DspCore.h
+    The standard headers and the few macros the DSP classes share. They do
+    not include JuceHeader.h, so that they also build without JUCE, in the
+    core library of Library/. In the plugin and the tools JuceHeader.h is
+    included first, and its jassert is used.
+
+  ==============================================================================
+*/
+
+#pragma once
+#include <algorithm>
+#include <cassert>
+#include <climits>
+#include <cmath>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+#ifndef jassert
+ #define jassert(expression) assert(expression)
+#endif
+
+//as JUCE_DECLARE_NON_COPYABLE
+#define STEREOWIDENER_NON_COPYABLE(className) \
+    className (const className&) = delete; \
+    className& operator= (const className&) = delete;
@@ -0,0 +1,218 @@
+/*
+  ==============================================================================
+
+    HrtfWidener.cpp
+
+  ==============================================================================
+*/
+
+#include "HrtfWidener.h"
+#include <complex>
+
+HrtfFilterDesigner::HrtfFilterDesigner() : juce::Thread("StereoWidener HRTF design"){
+    startThread();
+}
+
+HrtfFilterDesigner::~HrtfFilterDesigner(){
+    stopThread(1000);
+}
+
+void HrtfFilterDesigner::add(HrtfWidener* widener){
+    const juce::ScopedLock sl (lock);
+    wideners.addIfNotAlreadyThere(widener);
+}
+
+void HrtfFilterDesigner::remove(HrtfWidener* widener){
+    const juce::ScopedLock sl (lock);
+    wideners.removeFirstMatchingValue(widener);
+}
+
+void HrtfFilterDesigner::run(){
+    while (! threadShouldExit()){
+        wait(pollIntervalMs);
+        const juce::ScopedLock sl (lock);
+        for (auto* widener : wideners)
+            widener->design_requested_filters();
+    }
+}
+
+
+HrtfWidener::HrtfWidener(){
+    for (int s = 0; s < numSlots; s++)
+        slot_free[s] = true;
+}
+
+HrtfWidener::~HrtfWidener(){
+    if (designer != nullptr)
+        (*designer)->remove(this);
+}
+
+void HrtfWidener::prepare(double sampleRate, float speakerAngle, bool designInBackground){
+    if (designer != nullptr)
+        (*designer)->remove(this);
+    sample_rate = sampleRate;
+    design_in_background = designInBackground;
+
+    hrir_fft = std::make_unique<juce::dsp::FFT>(juce::findHighestSetBit((juce::uint32) hrirLength));
+    partition_fft = std::make_unique<juce::dsp::FFT>(juce::findHighestSetBit((juce::uint32) (2 * partitionSize)));
+    hrir.assign(hrirLength, 0.0f);
+    hrir_scratch.assign(2 * hrirLength, 0.0f);
+    partition_scratch.assign(4 * partitionSize, 0.0f);
+    for (int s = 0; s < numSlots; s++){
+        slots[s].ipsilateral.prepare(partitionSize, hrirLength);
+        slots[s].contralateral.prepare(partitionSize, hrirLength);
+        slot_free[s] = true;
+    }
+
+    for (int ear = 0; ear < 2; ear++){
+        convolvers[ear].prepare(partitionSize, numPartitions);
+        input_block[ear].assign(partitionSize, 0.0f);
+        output_block[ear].assign(partitionSize, 0.0f);
+        previous_output[ear].assign(partitionSize, 0.0f);
+    }
+    accumulator.assign((size_t) convolvers[0].get_spectrum_size(), 0.0f);
+    position = 0;
+
+    //the first filters are used without a crossfade
+    ready_slot = -1;
+    designed_angle = -1;
+    requested_angle = juce::roundToInt(juce::jlimit(0.0f, (float) maxSpeakerAngleDeg, speakerAngle) / angularResolutionDeg);
+    design_requested_filters();
+    current_slot = ready_slot.exchange(-1);
+    previous_slot = -1;
+    crossfade_position = 0;
+
+    if (design_in_background){
+        if (designer == nullptr)
+            designer = std::make_unique<juce::SharedResourcePointer<HrtfFilterDesigner>>();
+        (*designer)->add(this);
+    }
+}
+
+void HrtfWidener::reset(){
+    for (int ear = 0; ear < 2; ear++){
+        convolvers[ear].reset();
+        std::fill(input_block[ear].begin(), input_block[ear].end(), 0.0f);
+        std::fill(output_block[ear].begin(), output_block[ear].end(), 0.0f);
+    }
+    position = 0;
+    if (previous_slot >= 0){
+        slot_free[previous_slot] = true;
+        previous_slot = -1;
+    }
+}
+
+void HrtfWidener::get_hrir_from_spherical_head_model(float azimuth, int ear, double sampleRate, float* hrirOutput,
+                                                     juce::dsp::FFT& fft, float* scratch){
+    //Romblom and Bahu's 1-pole 1-zero head shadowing filter with the tanh fit of
+    //the zero, and the time delay of the wave around the head, as in interaural_cues.py.
+    //The spectrum is sampled at the bins of the HRIR length
+    const double PI = std::acos(-1.0);
+    const double head_radius = 0.075, speed_sound = 340.0;
+    const double incidence_angle = (ear == leftEar) ? 90.0 - azimuth : 90.0 + azimuth;
+    const double time_delay = head_radius / speed_sound * ((std::abs(incidence_angle) < 90.0)
+                              ? -std::cos(incidence_angle * PI / 180.0) : (std::abs(incidence_angle) - 90.0) * PI / 180.0);
+    const double zero_location_control = 1.15 - 0.85 * std::tanh(1.7 * (incidence_angle - 97.4));
+    const double fundamental_frequency = speed_sound / head_radius;
+
+    jassert(fft.getSize() == hrirLength);
+    for (int k = 0; k <= hrirLength / 2; k++){
+        const double frequency = k * sampleRate / hrirLength;
+        const std::complex<double> intermediate (0.0, 2.0 * PI * frequency / (2.0 * fundamental_frequency));
+        const std::complex<double> head_shadow = (1.0 + zero_location_control * intermediate) / (1.0 + intermediate);
+        const std::complex<double> response = head_shadow * std::polar(1.0, -2.0 * PI * time_delay * frequency);
+        scratch[2 * k] = (float) response.real();
+        scratch[2 * k + 1] = (float) response.imag();
+    }
+    fft.performRealOnlyInverseTransform(scratch);
+
+    //fftshift
+    for (int n = 0; n < hrirLength; n++)
+        hrirOutput[n] = scratch[(n + hrirLength / 2) % hrirLength];
+}
+
+void HrtfWidener::design_requested_filters(){
+    bool expected = false;
+    if (! designing.compare_exchange_strong(expected, true))
+        return;
+
+    const int angle = requested_angle;
+    if (angle != designed_angle && ready_slot < 0){
+        for (int s = 0; s < numSlots; s++){
+            if (! slot_free[s])
+                continue;
+            slot_free[s] = false;
+            //the speakers are at +/- angle, each ear gets half of both
+            const float azimuth = (float) (angle * angularResolutionDeg);
+            get_hrir_from_spherical_head_model(azimuth, leftEar, sample_rate, hrir.data(), *hrir_fft, hrir_scratch.data());
+            juce::FloatVectorOperations::multiply(hrir.data(), 0.5f, hrirLength);
+            slots[s].ipsilateral.set_impulse_response(hrir.data(), hrirLength, *partition_fft, partition_scratch.data());
+            get_hrir_from_spherical_head_model(azimuth, rightEar, sample_rate, hrir.data(), *hrir_fft, hrir_scratch.data());
+            juce::FloatVectorOperations::multiply(hrir.data(), 0.5f, hrirLength);
+            slots[s].contralateral.set_impulse_response(hrir.data(), hrirLength, *partition_fft, partition_scratch.data());
+            designed_angle = angle;
+            ready_slot = s;
+            break;
+        }
+    }
+    designing = false;
+}
+
+void HrtfWidener::set_speaker_angle(float speakerAngle){
+    requested_angle = juce::roundToInt(juce::jlimit(0.0f, (float) maxSpeakerAngleDeg, speakerAngle) / angularResolutionDeg);
+    if (! design_in_background)
+        design_requested_filters();
+}
+
+void HrtfWidener::process(const float* inputLeft, const float* inputRight, float* outputLeft, float* outputRight, int numSamples){
+    for (int i = 0; i < numSamples; i++){
+        const float left = inputLeft[i], right = inputRight[i];
+        outputLeft[i] = output_block[leftEar][position];
+        outputRight[i] = output_block[rightEar][position];
+        input_block[leftEar][position] = left;
+        input_block[rightEar][position] = right;
+        if (++position == partitionSize){
+            process_partition();
+            position = 0;
+        }
+    }
+}
+
+void HrtfWidener::process_partition(){
+    //new filters are taken when the last crossfade is over
+    if (previous_slot < 0 && ready_slot >= 0){
+        previous_slot = current_slot;
+        current_slot = ready_slot.exchange(-1);
+        crossfade_position = 0;
+    }
+
+    for (int ear = 0; ear < 2; ear++)
+        convolvers[ear].push_input(input_block[ear].data());
+
+    //each ear hears its own speaker directly, and the other one around the head
+    auto render = [this] (const FilterSet& filters, std::vector<float>* output){
+        for (int ear = 0; ear < 2; ear++){
+            std::fill(accumulator.begin(), accumulator.end(), 0.0f);
+            convolvers[ear].multiply_accumulate(filters.ipsilateral, accumulator.data());
+            convolvers[1 - ear].multiply_accumulate(filters.contralateral, accumulator.data());
+            convolvers[ear].get_output(accumulator.data(), output[ear].data());
+        }
+    };
+    render(slots[current_slot], output_block);
+
+    if (previous_slot >= 0){
+        //linear crossfade, the outputs of both filters are coherent
+        render(slots[previous_slot], previous_output);
+        const float fade_length = (float) (crossfadePartitions * partitionSize);
+        for (int ear = 0; ear < 2; ear++){
+            for (int n = 0; n < partitionSize; n++){
+                const float gain = (crossfade_position * partitionSize + n + 1) / fade_length;
+                output_block[ear][n] = previous_output[ear][n] + gain * (output_block[ear][n] - previous_output[ear][n]);
+            }
+        }
+        if (++crossfade_position == crossfadePartitions){
+            slot_free[previous_slot] = true;
+            previous_slot = -1;
+        }
+    }
+}
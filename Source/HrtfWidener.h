@@ -0,0 +1,123 @@
+/*
+  ==============================================================================
+
+    HrtfWidener.h
+    Port of HRTFStereoWidener (Python/src/hrtf_widener.py). The stereo input
+    is played through a pair of virtual speakers at +/- the speaker angle,
+    and each ear receives both speakers through the HRIRs of a spherical
+    head (get_hrtf_from_spherical_head_model in interaural_cues.py). By the
+    symmetry of the head, the direct paths share the ipsilateral HRIR and
+    the crosstalk paths the contralateral one. The HRIRs run through
+    uniformly partitioned FFT convolution.
+
+    When the speaker angle changes, the new filters are designed on a
+    background thread (on the audio thread when rendering offline, so the
+    output does not depend on timing) into a free slot, and the audio
+    thread crossfades from the old filters to the new ones.
+
+  ==============================================================================
+*/
+
+#pragma once
+#include "JuceHeader.h"
+#include "PartitionedConvolver.h"
+
+class HrtfWidener;
+
+//one thread designs the filters of all instances
+class HrtfFilterDesigner : private juce::Thread{
+public:
+    HrtfFilterDesigner();
+    ~HrtfFilterDesigner() override;
+
+    void add(HrtfWidener* widener);
+    //waits for a design of the widener to finish
+    void remove(HrtfWidener* widener);
+
+private:
+    void run() override;
+    enum{
+        pollIntervalMs = 5,
+    };
+    juce::CriticalSection lock;
+    juce::Array<HrtfWidener*> wideners;
+
+    JUCE_DECLARE_NON_COPYABLE (HrtfFilterDesigner)
+};
+
+
+class HrtfWidener{
+public:
+    HrtfWidener();
+    ~HrtfWidener();
+
+    //the filters for the current angle are designed before this returns
+    void prepare(double sampleRate, float speakerAngle, bool designInBackground);
+    void reset();
+    //matches the output of hrtf_widener.py, which convolves in 'same' mode
+    int get_latency() const { return partitionSize + (hrirLength - 1) / 2; }
+
+    //audio thread, once per block before processing
+    void set_speaker_angle(float speakerAngle);
+    //input and output can be the same buffers
+    void process(const float* inputLeft, const float* inputRight, float* outputLeft, float* outputRight, int numSamples);
+
+    //HRIR of one ear for a source at the azimuth (degrees, positive to the
+    //left), centred at hrirLength / 2 as in interaural_cues.py
+    static void get_hrir_from_spherical_head_model(float azimuth, int ear, double sampleRate, float* hrir,
+                                                   juce::dsp::FFT& fft, float* scratch);
+
+    enum{
+        leftEar = 0,
+        rightEar,
+        hrirLength = 1024,                      //num_time_samples in hrtf_widener.py
+        angularResolutionDeg = 2,               //angular_res_deg in hrtf_widener.py
+        maxSpeakerAngleDeg = 90,
+    };
+
+private:
+    friend class HrtfFilterDesigner;
+    //designs the filters for the requested angle when they are not designed
+    //yet and a slot is free. Called by the designer thread or the audio thread
+    void design_requested_filters();
+    void process_partition();
+
+    enum{
+        partitionSize = 128,
+        numPartitions = hrirLength / partitionSize,
+        numSlots = 3,                           //current, fading out, designed
+        crossfadePartitions = 4,
+    };
+    struct FilterSet{
+        PartitionedFilter ipsilateral, contralateral;
+    };
+
+    double sample_rate = 44100.0;
+    bool design_in_background = false;
+    std::unique_ptr<juce::SharedResourcePointer<HrtfFilterDesigner>> designer;
+
+    //hand-off between the designer and the audio thread. A slot is written
+    //only while it is free, and published through ready_slot
+    FilterSet slots[numSlots];
+    std::atomic<bool> slot_free[numSlots];
+    std::atomic<int> ready_slot { -1 };
+    std::atomic<int> requested_angle { 0 };     //in steps of angularResolutionDeg
+    std::atomic<int> designed_angle { -1 };
+    std::atomic<bool> designing { false };
+    int current_slot = 0;
+    int previous_slot = -1;                     //fading out
+    int crossfade_position = 0;                 //partitions into the crossfade
+
+    //designer scratch
+    std::unique_ptr<juce::dsp::FFT> hrir_fft;
+    std::unique_ptr<juce::dsp::FFT> partition_fft;
+    std::vector<float> hrir, hrir_scratch, partition_scratch;
+
+    //audio thread
+    PartitionedConvolver convolvers[2];
+    std::vector<float> accumulator;
+    std::vector<float> input_block[2], output_block[2], previous_output[2];
+    int position = 0;
+
+    JUCE_DECLARE_NON_COPYABLE (HrtfWidener)
+};
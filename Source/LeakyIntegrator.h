@@ -9,52 +9,38 @@
 */
 
 #pragma once
-#include "JuceHeader.h"
+#include "DspCore.h"
 
 class LeakyIntegrator{
 public:
     LeakyIntegrator(){};
-    ~LeakyIntegrator(){
-        delete [] signal_env;
-    };
+    ~LeakyIntegrator(){};
     
     inline float ms_to_samps(float time_ms){
         return (time_ms * 1e-3 * sample_rate);
     }
     
-    void prepare(int bufferSize, float sampleRate, float attack_time_ms, float release_time_ms){
-        buffer_size = bufferSize;
+    void prepare(float sampleRate, float attack_time_ms, float release_time_ms){
         sample_rate = sampleRate;
-        tau_attack = ms_to_samps(attack_time_ms);
-        tau_release = ms_to_samps(release_time_ms);
-        signal_env = new float[buffer_size];
-        for(int i=0; i < buffer_size; i++){
-            signal_env[i] = 0.0f;
-        }
+        //the smoothing coefficients only depend on the time constants,
+        //so they are calculated once here instead of every sample
+        attack_coeff = 1.0f - std::exp(-1.0f / ms_to_samps(attack_time_ms));
+        release_coeff = 1.0f - std::exp(-1.0f / ms_to_samps(release_time_ms));
+        signal_env = 0.0f;
     }
     
-    //signal envelope calculation with a leaky integrator
-    float* process(float* input_buffer){
-        float prev_env_samp;
-        for (int i = 0; i< buffer_size; i++){
-            if (i == 0)
-                prev_env_samp = signal_env[buffer_size-1];
-            else
-                prev_env_samp = signal_env[i-1];
-            if (input_buffer[i] > prev_env_samp){
-                signal_env[i] = prev_env_samp + (1-std::exp(-1.0/tau_attack)) * (std::abs(input_buffer[i]) - prev_env_samp);
-            }
-            else{
-                signal_env[i] = prev_env_samp + (1-std::exp(-1.0/tau_release)) * (std::abs(input_buffer[i]) - prev_env_samp);
-            }
-        }
+    //signal envelope calculation with a leaky integrator, one sample at a time
+    inline float process(const float input){
+        const float coeff = (input > signal_env) ? attack_coeff : release_coeff;
+        signal_env += coeff * (std::abs(input) - signal_env);
         return signal_env;
     }
+    float get_attack_coeff() const { return attack_coeff; }
+    float get_release_coeff() const { return release_coeff; }
     
 private:
     float sample_rate;
-    int buffer_size;
-    float tau_attack;
-    float tau_release;
-    float* signal_env;
+    float attack_coeff;
+    float release_coeff;
+    float signal_env = 0.0f;        //last envelope sample
 };
@@ -119,6 +119,15 @@ void LinkwitzCrossover::update(float newCutoffFrequency){
     setCoefficients();
 }
 
+void LinkwitzCrossover::get_coefficients(float* coefficients) const{
+    jassert(order == 2);
+    const float sign = lowpass ? 1.0f : -1.0f;
+    for (int i = 0; i <= order; i++)
+        coefficients[i] = sign * numCoeffs[i];
+    coefficients[3] = denCoeffs[0];
+    coefficients[4] = denCoeffs[1];
+}
+
 float LinkwitzCrossover::process(const float input){
     float output = numCoeffs[0] * input;
     for (int i = 0; i < order; i++){
@@ -9,7 +9,7 @@
 */
 
 #pragma once
-#include "JuceHeader.h"
+#include "DspCore.h"
 #include "DelayLine.h"
 
 class LinkwitzCrossover{
@@ -22,6 +22,9 @@ public:
     float process(const float input);
     void update(float newCutoffFreq);
     void setCoefficients();
+    //b0, b1, b2, a0, a1 of the 2nd order filter. The sign of the highpass output
+    //is in the b coefficients, so a biquad with them gives the output of process
+    void get_coefficients(float* coefficients) const;
     
     
 private:
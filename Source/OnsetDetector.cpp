@@ -18,89 +18,92 @@ void OnsetDetector::prepare(int bufferSize, float sampleRate){
     buffer_size = bufferSize;
     sample_rate = sampleRate;
     //initialise leaky integrator
-    leaky.prepare(bufferSize, sampleRate, attack_time_ms, release_time_ms);
+    leaky.prepare(sampleRate, attack_time_ms, release_time_ms);
     threshold = 0.0;
     //keeps track of the mean of the signal envelope
     running_mean_env = 0.0;
+    num_samps = 0;
+    inv_num_samps = 0.0;
+    second_last_samp = 0.0;
+    last_samp = 0.0;
+    cur_samp = 0.0;
+    onset_indices.assign((size_t) buffer_size, 0);
+    num_onsets = 0;
 }
 
-inline bool OnsetDetector::check_local_peak(){
-    if ((last_samp > second_last_samp) && (last_samp > cur_samp))
-        return true;
-    else
-        return false;
-}
-
-inline bool OnsetDetector::check_direction(bool is_rising){
-    //checks direction of signal. If is_rising is true, returns
-    //true if direction is rising. If is_rising is false, returns
-    //true if direction is falling.
-    
-    if (is_rising)
-        return ((second_last_samp < last_samp) && (last_samp < cur_samp));
-    else
-        return ((second_last_samp > last_samp) && (last_samp > cur_samp));
-}
 
-float* OnsetDetector::get_signal_envelope(float* input_buffer){
-    return leaky.process(input_buffer);
+void OnsetDetector::set_envelope_sum(double envelope_sum, unsigned long num_samples){
+    num_samps = num_samples;
+    inv_num_samps = (num_samples > 0) ? 1.0 / (double) num_samples : 0.0;
+    running_mean_env = envelope_sum * inv_num_samps;
 }
 
 
-inline bool OnsetDetector::check_onset(float cur_threshold, bool check_offset){
-    //checks if there is an onset or offset based on the current value of threshold
-    //checks for offset if check_offset is true, else checks for onset
-    if (!check_offset)
-        return (check_direction(true) && (last_samp > cur_threshold));
-    else
-        return (check_direction(false) && (last_samp < cur_threshold));
-}
-
-void OnsetDetector::process(float* input_buffer){
-    //set flags to false initially
+void OnsetDetector::process(const float* input_buffer, int num_samples){
+    //Single pass over the input that calculates the signal envelope, its running
+    //mean, the dynamic threshold and the onset/offset flags sample by sample.
+    //The detector state is copied into locals so that the loop runs in registers.
+    jassert(num_samples <= buffer_size);
     onset_flag = false;
     offset_flag = false;
-    //get signal envelope
-    float* signal_env = this->get_signal_envelope(input_buffer);
-    for (int i = 0; i < buffer_size; i++){
-        //update the values of the last 3 samples
-        if (i == 0){
-            second_last_samp = last_samp;
-            last_samp = cur_samp;
-            cur_samp = signal_env[i];
-        }
-        else if (i == 1){
-            second_last_samp = last_samp;
-            last_samp = signal_env[i-1];
-            cur_samp = signal_env[i];
-        }
-        else{
-            second_last_samp = signal_env[i-2];
-            last_samp = signal_env[i-1];
-            cur_samp = signal_env[i];
-        }
-        
-        //to prevent overflow
-        num_samps = num_samps < ULONG_MAX? num_samps:0;
+    onset_index = -1;
+    offset_index = -1;
+    num_onsets = 0;
+    
+    float env_2 = second_last_samp;
+    float env_1 = last_samp;
+    float env_0 = cur_samp;
+    double mean = running_mean_env;
+    float thresh = threshold;
+    const float peak_weight = (1.0f - peak_forget_factor) * threshold_scale;
+    const float weight = (1.0f - forget_factor) * threshold_scale;
+    
+    //to prevent overflow
+    if (num_samps > ULONG_MAX - (unsigned long) num_samples)
+        num_samps = 0;
+    double count = (double) num_samps;
+    double scaling = inv_num_samps;
+    
+    for (int i = 0; i < num_samples; i++){
+        //update the values of the last 3 samples of the signal envelope
+        env_2 = env_1;
+        env_1 = env_0;
+        env_0 = leaky.process(input_buffer[i]);
         
         //calculate running mean of the signal envelope
-        float scaling = 1.0/(++num_samps);
-        running_mean_env = signal_env[i] * scaling + (1-scaling) * running_mean_env;
+        count += 1.0;
+        scaling = get_next_reciprocal(count, scaling);
+        mean += scaling * (env_0 - mean);
+        const float cur_mean = (float) mean;
         
-        // if a local peak is detected, update threshold to 2xrunning_mean, else
+        // if a local peak is detected, update threshold to 4xrunning_mean, else
         // keep the last value. Do this with an exponential smoother.
-        forget_factor = this->check_local_peak()?0.01:0.99;
-        threshold = (1 - forget_factor) * 4.0 * running_mean_env + (forget_factor * threshold);
+        const bool is_local_peak = (env_1 > env_2) && (env_1 > env_0);
+        thresh = is_local_peak ? (peak_weight * cur_mean + peak_forget_factor * thresh)
+                               : (weight * cur_mean + forget_factor * thresh);
         
-        //if onset or offset has already been detected, continue
-        if (onset_flag || offset_flag){
-            continue;
+        //every onset is reported with its sample index so that the
+        //transient handler can act on it independently of the buffer size
+        const bool is_rising = (env_2 < env_1) && (env_1 < env_0);
+        const bool is_falling = (env_2 > env_1) && (env_1 > env_0);
+        if (is_rising && env_1 > thresh){
+            onset_indices[num_onsets++] = i;
         }
-        //these flags are set only once per buffer, but the
-        //rest of the calculations are carried out sample by sample
-        else{
-            onset_flag = this->check_onset(threshold, false);
-            offset_flag = this->check_onset(threshold, true);
+        else if (offset_index < 0 && is_falling && env_1 < thresh){
+            offset_index = i;
         }
     }
+    
+    second_last_samp = env_2;
+    last_samp = env_1;
+    cur_samp = env_0;
+    running_mean_env = mean;
+    num_samps += (unsigned long) num_samples;
+    inv_num_samps = scaling;
+    threshold = thresh;
+    
+    if (num_onsets > 0)
+        onset_index = onset_indices[0];
+    onset_flag = onset_index >= 0;
+    offset_flag = offset_index >= 0;
 }
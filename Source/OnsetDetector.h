@@ -16,16 +16,36 @@ public:
     //public variables
     bool onset_flag = false;
     bool offset_flag = false;
+    int onset_index = -1;             //first sample in the buffer with an onset (-1 if none)
+    int offset_index = -1;            //first sample in the buffer with an offset (-1 if none)
+    std::vector<int> onset_indices;   //all samples in the buffer that were detected as onsets
+    int num_onsets = 0;
     
     //public methods
     OnsetDetector();
     ~OnsetDetector();
     void prepare(int bufferSize, float sampleRate);
-    void process(float* input_buffer);
-    inline bool check_local_peak();
-    inline bool check_direction(bool is_rising);
-    inline bool check_onset(float cur_threshold, bool check_offset);
-    float* get_signal_envelope(float* input_buffer);
+    void process(const float* input_buffer, int num_samples);
+    //the running mean depends on the whole signal history. These let an offline
+    //render that is split into segments carry it over from one segment to the next
+    double get_envelope_sum() const { return running_mean_env * (double) num_samps; }
+    void set_envelope_sum(double envelope_sum, unsigned long num_samples);
+    //1 / count from 1 / (count - 1), for the running mean. Past the first few
+    //thousand samples one Newton step is within 1 / count^2 of it, so the
+    //running mean does not divide once per sample
+    static inline double get_next_reciprocal(double count, double last_reciprocal){
+        if (count < exact_reciprocal_count)
+            return 1.0 / count;
+        return last_reciprocal * (2.0 - count * last_reciprocal);
+    }
+    enum{
+        exact_reciprocal_count = 4096,
+    };
+    //forget factors for threshold calculation at and away from a local peak
+    static constexpr float peak_forget_factor = 0.01f;
+    static constexpr float forget_factor = 0.99f;
+    static constexpr float threshold_scale = 4.0f;   //threshold is a multiple of the running mean
+    const LeakyIntegrator& get_envelope_follower() const { return leaky; }
 
 private:
     int buffer_size;
@@ -36,11 +56,12 @@ private:
         release_time_ms = 50,
     };
     float  threshold;                 //dynamic threshold for onset calculation
-    float running_mean_env;           //running mean of the signal envelope
+    double running_mean_env;          //running mean of the signal envelope (in double precision,
+                                      //so that it keeps updating when num_samps is large)
     unsigned long num_samps = 0;      //keeps track of number of samples in input signal
+    double inv_num_samps = 0.0;       //1 / num_samps, see get_next_reciprocal
     float second_last_samp = 0.0;     //last 3 samples of the signal envelope
     float last_samp = 0.0;
     float cur_samp = 0.0;
-    float forget_factor = 0.0;        //forget factor for threshold calculation
 
     };
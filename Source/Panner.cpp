@@ -31,9 +31,14 @@ float Panner::process(const float* input){
     return output[0] + output[1];
 }
 
+void Panner::process_block(const float* const* input, float* outputBlock, int numSamples, const SimdKernels& kernels){
+    //the angle only changes between blocks
+    kernels.weighted_sum(outputBlock, input[0], std::sin(angle), input[1], std::cos(angle), numSamples);
+}
+
 void Panner::updateWidth(float newWidth){
     width = newWidth;
-    angle = (float) juce::jmap (width, 0.f, 1.0f, 0.f, PI/2.0f);
+    angle = (PI/2.0f) * width;
 }
 
 
@@ -9,7 +9,8 @@
 */
 
 #pragma once
-#include "JuceHeader.h"
+#include "DspCore.h"
+#include "SimdKernels.h"
 class Panner{
 public:
     Panner();
@@ -17,6 +18,8 @@ public:
     
     void initialize();
     float process(const float* input);
+    //process over a block, input[0] and input[1] are blocks
+    void process_block(const float* const* input, float* outputBlock, int numSamples, const SimdKernels& kernels);
     void updateWidth(float newWidth);
     
     
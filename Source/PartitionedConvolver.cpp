@@ -0,0 +1,86 @@
+/*
+  ==============================================================================
+
+    PartitionedConvolver.cpp
+
+  ==============================================================================
+*/
+
+#include "PartitionedConvolver.h"
+
+PartitionedFilter::PartitionedFilter(){}
+PartitionedFilter::~PartitionedFilter(){}
+
+void PartitionedFilter::prepare(int partitionSize, int maxLength){
+    partition_size = partitionSize;
+    num_bins = partitionSize + 1;
+    max_partitions = (maxLength + partitionSize - 1) / partitionSize;
+    num_partitions = 0;
+    spectra.assign((size_t) (max_partitions * 2 * num_bins), 0.0f);
+}
+
+void PartitionedFilter::set_impulse_response(const float* impulseResponse, int length, juce::dsp::FFT& fft, float* scratch){
+    jassert(fft.getSize() == 2 * partition_size);
+    num_partitions = juce::jmin(max_partitions, (length + partition_size - 1) / partition_size);
+    for (int p = 0; p < num_partitions; p++){
+        const int start = p * partition_size;
+        const int size = juce::jmin(partition_size, length - start);
+        juce::FloatVectorOperations::clear(scratch, 4 * partition_size);
+        juce::FloatVectorOperations::copy(scratch, impulseResponse + start, size);
+        fft.performRealOnlyForwardTransform(scratch, true);
+        juce::FloatVectorOperations::copy(&spectra[(size_t) (p * 2 * num_bins)], scratch, 2 * num_bins);
+    }
+}
+
+
+PartitionedConvolver::PartitionedConvolver(){}
+PartitionedConvolver::~PartitionedConvolver(){}
+
+void PartitionedConvolver::prepare(int partitionSize, int maxPartitions){
+    partition_size = partitionSize;
+    num_bins = partitionSize + 1;
+    max_partitions = maxPartitions;
+    fft = std::make_unique<juce::dsp::FFT>(juce::findHighestSetBit((juce::uint32) (2 * partitionSize)));
+    input_history.assign(2 * (size_t) partitionSize, 0.0f);
+    delay_line.assign((size_t) (max_partitions * 2 * num_bins), 0.0f);
+    fft_data.assign(4 * (size_t) partitionSize, 0.0f);
+    newest = 0;
+}
+
+void PartitionedConvolver::reset(){
+    std::fill(input_history.begin(), input_history.end(), 0.0f);
+    std::fill(delay_line.begin(), delay_line.end(), 0.0f);
+    newest = 0;
+}
+
+void PartitionedConvolver::push_input(const float* block){
+    //the previous block, then this one
+    juce::FloatVectorOperations::copy(input_history.data(), input_history.data() + partition_size, partition_size);
+    juce::FloatVectorOperations::copy(input_history.data() + partition_size, block, partition_size);
+
+    juce::FloatVectorOperations::copy(fft_data.data(), input_history.data(), 2 * partition_size);
+    fft->performRealOnlyForwardTransform(fft_data.data(), true);
+    newest = (newest == 0) ? max_partitions - 1 : newest - 1;
+    juce::FloatVectorOperations::copy(&delay_line[(size_t) (newest * 2 * num_bins)], fft_data.data(), 2 * num_bins);
+}
+
+void PartitionedConvolver::multiply_accumulate(const PartitionedFilter& filter, float* accumulator) const{
+    //partition p of the filter multiplies the input from p blocks ago
+    const int numPartitions = juce::jmin(filter.get_num_partitions(), max_partitions);
+    for (int p = 0; p < numPartitions; p++){
+        const int position = (newest + p) % max_partitions;
+        const float* input = &delay_line[(size_t) (position * 2 * num_bins)];
+        const float* partition = filter.get_partition(p);
+        for (int k = 0; k < 2 * num_bins; k += 2){
+            accumulator[k] += input[k] * partition[k] - input[k + 1] * partition[k + 1];
+            accumulator[k + 1] += input[k] * partition[k + 1] + input[k + 1] * partition[k];
+        }
+    }
+}
+
+void PartitionedConvolver::get_output(float* accumulator, float* block){
+    //the second half is free of circular aliasing
+    juce::FloatVectorOperations::copy(fft_data.data(), accumulator, 2 * num_bins);
+    fft->performRealOnlyInverseTransform(fft_data.data());
+    juce::FloatVectorOperations::copy(block, fft_data.data() + partition_size, partition_size);
+}
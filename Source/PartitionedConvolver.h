@@ -0,0 +1,66 @@
+/*
+  ==============================================================================
+
+    PartitionedConvolver.h
+    Uniformly partitioned overlap-save convolution. An impulse response is
+    cut into partitions of the block length, each kept as the spectrum of
+    the partition zero padded to twice its length. The input spectra of the
+    last blocks are kept in a frequency domain delay line, so one forward FFT
+    of an input serves any number of filters, and the products of all
+    filters that feed an output are summed before one inverse FFT.
+
+  ==============================================================================
+*/
+
+#pragma once
+#include "JuceHeader.h"
+
+class PartitionedFilter{
+public:
+    PartitionedFilter();
+    ~PartitionedFilter();
+
+    void prepare(int partitionSize, int maxLength);
+    //fft has 2 * partitionSize points, scratch holds 4 * partitionSize floats
+    void set_impulse_response(const float* impulseResponse, int length, juce::dsp::FFT& fft, float* scratch);
+
+    int get_num_partitions() const { return num_partitions; }
+    //partition_size + 1 bins, interleaved re/im
+    const float* get_partition(int index) const { return &spectra[(size_t) (index * 2 * num_bins)]; }
+
+private:
+    int partition_size = 0;
+    int num_bins = 0;
+    int max_partitions = 0;
+    int num_partitions = 0;
+    std::vector<float> spectra;
+};
+
+
+class PartitionedConvolver{
+public:
+    PartitionedConvolver();
+    ~PartitionedConvolver();
+
+    void prepare(int partitionSize, int maxPartitions);
+    void reset();
+    int get_partition_size() const { return partition_size; }
+    //FFT of the last two blocks of input into the delay line, block has partition_size samples
+    void push_input(const float* block);
+    //adds the spectrum of the delay line convolved with the filter to accumulator
+    void multiply_accumulate(const PartitionedFilter& filter, float* accumulator) const;
+    //partition_size output samples from an accumulated spectrum
+    void get_output(float* accumulator, float* block);
+    //size of an accumulator, in floats
+    int get_spectrum_size() const { return 2 * num_bins; }
+
+private:
+    std::unique_ptr<juce::dsp::FFT> fft;
+    int partition_size = 0;
+    int num_bins = 0;
+    int max_partitions = 0;
+    int newest = 0;                             //position of the latest input spectrum
+    std::vector<float> input_history;           //the last two blocks of input
+    std::vector<float> delay_line;              //max_partitions spectra
+    std::vector<float> fft_data;
+};
@@ -11,11 +11,11 @@
 
 //==============================================================================
 StereoWidenerAudioProcessorEditor::StereoWidenerAudioProcessorEditor (StereoWidenerAudioProcessor& p, juce::AudioProcessorValueTreeState& vts)
-    : AudioProcessorEditor (&p), audioProcessor (p), valueTreeState (vts)
+    : AudioProcessorEditor (&p), audioProcessor (p), valueTreeState (vts), coherenceDisplay (p.getCoherenceAnalyzer())
 {
     // Make sure that before the constructor has finished, you've set the
     // editor's size to whatever you need it to be.
-    setSize (300,500);
+    setSize (300,980);
     
     //add sliders and labels
     addAndMakeVisible(widthLowerSlider);
@@ -125,7 +125,143 @@ StereoWidenerAudioProcessorEditor::StereoWidenerAudioProcessorEditor (StereoWide
     handleTransientsLabel.setText ("Transient detection", juce::dontSendNotification);
     handleTransientsLabel.setFont(juce::Font ("Transient detection", 12.0f, juce::Font::plain));
     handleTransientsLabel.setFont(juce::Font ("Times New Roman", 12.0f, juce::Font::plain));
+    
+    //add slider for the transient lookahead
+    addAndMakeVisible(lookaheadSlider);
+    lookaheadSlider.setSliderStyle(juce::Slider::SliderStyle::LinearHorizontal);
+    lookaheadSlider.setTextBoxStyle(juce::Slider::TextBoxRight, false, 60, 20);
+    lookaheadAttach.reset (new juce::AudioProcessorValueTreeState::SliderAttachment (valueTreeState, "lookaheadSamples", lookaheadSlider));
+    
+    addAndMakeVisible(lookaheadLabel);
+    lookaheadLabel.setText("Transient lookahead (samples)", juce::dontSendNotification);
+    lookaheadLabel.setFont(juce::Font("Times New Roman", 12.0f, juce::Font::plain));
+    lookaheadLabel.attachToComponent (&lookaheadSlider, false);
+    
+    //add drop-down menu for linking transient detection across channels
+    addAndMakeVisible(transientLinkModeBox);
+    transientLinkModeBox.addItemList(vts.getParameter("transientLinkMode")->getAllValueStrings(), 1);
+    transientLinkModeAttach.reset (new juce::AudioProcessorValueTreeState::ComboBoxAttachment (valueTreeState, "transientLinkMode", transientLinkModeBox));
+    
+    addAndMakeVisible(transientLinkModeLabel);
+    transientLinkModeLabel.setText("Transient link mode", juce::dontSendNotification);
+    transientLinkModeLabel.setFont(juce::Font("Times New Roman", 12.0f, juce::Font::plain));
+    transientLinkModeLabel.attachToComponent (&transientLinkModeBox, false);
+    
+    // add toggle button for band-limited transient handling
+    addAndMakeVisible(transientHighBandOnly);
+    // [=] indicates a lambda function, it sets the parameterChangedCallback below
+    transientHighBandOnlyAttach = std::make_unique<juce::ParameterAttachment>(*vts.getParameter("transientHighBandOnly"), [=] (float value) {
+            bool isSelected = value == 1.0f;
+            transientHighBandOnly.setToggleState(isSelected, juce::sendNotificationSync);
+        });
+    
+    transientHighBandOnly.onClick = [=] {
+        //if toggle state is true, then
+        if (transientHighBandOnly.getToggleState())
+            transientHighBandOnlyAttach->setValueAsCompleteGesture(1.0f);
+        else
+            transientHighBandOnlyAttach->setValueAsCompleteGesture(0.0f);
+    };
+    transientHighBandOnlyAttach->sendInitialUpdate();
+    
+    //add labels
+    addAndMakeVisible(transientHighBandOnlyLabel);
+    transientHighBandOnlyLabel.setText ("Transients in high band only", juce::dontSendNotification);
+    transientHighBandOnlyLabel.setFont(juce::Font ("Times New Roman", 12.0f, juce::Font::plain));
+    
+    // add toggle button for processing the low band at a lower sample rate
+    addAndMakeVisible(multirateLowBand);
+    // [=] indicates a lambda function, it sets the parameterChangedCallback below
+    multirateLowBandAttach = std::make_unique<juce::ParameterAttachment>(*vts.getParameter("multirateLowBand"), [=] (float value) {
+            bool isSelected = value == 1.0f;
+            multirateLowBand.setToggleState(isSelected, juce::sendNotificationSync);
+        });
+    
+    multirateLowBand.onClick = [=] {
+        //if toggle state is true, then
+        if (multirateLowBand.getToggleState())
+            multirateLowBandAttach->setValueAsCompleteGesture(1.0f);
+        else
+            multirateLowBandAttach->setValueAsCompleteGesture(0.0f);
+    };
+    multirateLowBandAttach->sendInitialUpdate();
+    
+    //add labels
+    addAndMakeVisible(multirateLowBandLabel);
+    multirateLowBandLabel.setText ("Multirate low band", juce::dontSendNotification);
+    multirateLowBandLabel.setFont(juce::Font ("Times New Roman", 12.0f, juce::Font::plain));
+    
+    // add toggle button for decorrelating the mid signal once for both channels
+    addAndMakeVisible(midDecorrelation);
+    // [=] indicates a lambda function, it sets the parameterChangedCallback below
+    midDecorrelationAttach = std::make_unique<juce::ParameterAttachment>(*vts.getParameter("midDecorrelation"), [=] (float value) {
+            bool isSelected = value == 1.0f;
+            midDecorrelation.setToggleState(isSelected, juce::sendNotificationSync);
+        });
+    
+    midDecorrelation.onClick = [=] {
+        //if toggle state is true, then
+        if (midDecorrelation.getToggleState())
+            midDecorrelationAttach->setValueAsCompleteGesture(1.0f);
+        else
+            midDecorrelationAttach->setValueAsCompleteGesture(0.0f);
+    };
+    midDecorrelationAttach->sendInitialUpdate();
+    
+    //add labels
+    addAndMakeVisible(midDecorrelationLabel);
+    midDecorrelationLabel.setText ("Shared mid decorrelation", juce::dontSendNotification);
+    midDecorrelationLabel.setFont(juce::Font ("Times New Roman", 12.0f, juce::Font::plain));
+    
+    //add drop-down menu for the processing engine
+    addAndMakeVisible(engineBox);
+    engineBox.addItemList(vts.getParameter("engine")->getAllValueStrings(), 1);
+    engineAttach.reset (new juce::AudioProcessorValueTreeState::ComboBoxAttachment (valueTreeState, "engine", engineBox));
+    
+    addAndMakeVisible(engineLabel);
+    engineLabel.setText("Processing engine", juce::dontSendNotification);
+    engineLabel.setFont(juce::Font("Times New Roman", 12.0f, juce::Font::plain));
+    engineLabel.attachToComponent (&engineBox, false);
+    
+    //add slider for the angle of the virtual speakers in the HRTF engine
+    addAndMakeVisible(speakerAngleSlider);
+    speakerAngleSlider.setSliderStyle(juce::Slider::SliderStyle::LinearHorizontal);
+    speakerAngleSlider.setTextBoxStyle(juce::Slider::TextBoxRight, false, 60, 20);
+    speakerAngleAttach.reset (new juce::AudioProcessorValueTreeState::SliderAttachment (valueTreeState, "speakerAngle", speakerAngleSlider));
+    
+    addAndMakeVisible(speakerAngleLabel);
+    speakerAngleLabel.setText("HRTF speaker angle (degrees)", juce::dontSendNotification);
+    speakerAngleLabel.setFont(juce::Font("Times New Roman", 12.0f, juce::Font::plain));
+    speakerAngleLabel.attachToComponent (&speakerAngleSlider, false);
+    
+    //add the coherence of the input and output below the controls
+    addAndMakeVisible(coherenceDisplay);
+    
+   #if STEREOWIDENER_PROFILING
+    //add the DSP load readout below the controls
+    addAndMakeVisible(dspLoadLabel);
+    dspLoadLabel.setFont(juce::Font (juce::Font::getDefaultMonospacedFontName(), 11.0f, juce::Font::plain));
+    dspLoadLabel.setJustificationType(juce::Justification::topLeft);
+    setSize (getWidth(), getHeight() + dspLoadHeight);
+    startTimerHz(dspLoadRefreshHz);
+   #endif
+}
+
+#if STEREOWIDENER_PROFILING
+void StereoWidenerAudioProcessorEditor::timerCallback(){
+    //DSP load in percent of the block duration, min / avg / max over the last window
+    const auto& profiler = audioProcessor.getStageProfiler();
+    juce::String text = juce::String("DSP load %").paddedRight(' ', 16) + "min    avg    max\n";
+    for (int stage = 0; stage < StageProfiler::numStages; stage++){
+        const auto load = profiler.get_load(stage);
+        text << juce::String(StageProfiler::get_stage_name(stage)).paddedRight(' ', 16)
+             << juce::String(load.min * 100.0f, 2).paddedRight(' ', 7)
+             << juce::String(load.avg * 100.0f, 2).paddedRight(' ', 7)
+             << juce::String(load.max * 100.0f, 2) << "\n";
+    }
+    dspLoadLabel.setText(text, juce::dontSendNotification);
 }
+#endif
     
 StereoWidenerAudioProcessorEditor::~StereoWidenerAudioProcessorEditor()
 {
@@ -139,7 +275,7 @@ void StereoWidenerAudioProcessorEditor::paint (juce::Graphics& g)
 
     g.setFont (juce::Font ("Times New Roman", 20.0f, juce::Font::bold));
     g.setColour (juce::Colours::lightgrey);
-    g.drawText ("StereoWidener", 150, 450, 180, 50, true);
+    g.drawText ("StereoWidener", 150, getHeight() - 50, 180, 50, true);
 }
 
 void StereoWidenerAudioProcessorEditor::resized()
@@ -159,4 +295,23 @@ void StereoWidenerAudioProcessorEditor::resized()
     
     handleTransients.setBounds (sliderLeft, 400, getWidth() - sliderLeft - 10, 50);
     handleTransientsLabel.setBounds(sliderLeft + 50, 420, getWidth() - sliderLeft - 10, 20);
+    lookaheadSlider.setBounds (sliderLeft, 470, getWidth() - sliderLeft - 10, 30);
+    transientLinkModeBox.setBounds (sliderLeft, 530, getWidth() - sliderLeft - 40, 24);
+    
+    transientHighBandOnly.setBounds (sliderLeft, 550, getWidth() - sliderLeft - 10, 50);
+    transientHighBandOnlyLabel.setBounds(sliderLeft + 50, 570, getWidth() - sliderLeft - 10, 20);
+    
+    multirateLowBand.setBounds (sliderLeft, 590, getWidth() - sliderLeft - 10, 50);
+    multirateLowBandLabel.setBounds(sliderLeft + 50, 610, getWidth() - sliderLeft - 10, 20);
+    
+    midDecorrelation.setBounds (sliderLeft, 630, getWidth() - sliderLeft - 10, 50);
+    midDecorrelationLabel.setBounds(sliderLeft + 50, 650, getWidth() - sliderLeft - 10, 20);
+    
+    engineBox.setBounds (sliderLeft, 700, getWidth() - sliderLeft - 40, 24);
+    speakerAngleSlider.setBounds (sliderLeft, 750, getWidth() - sliderLeft - 10, 30);
+    coherenceDisplay.setBounds (sliderLeft - 10, 790, getWidth() - sliderLeft, 130);
+    
+   #if STEREOWIDENER_PROFILING
+    dspLoadLabel.setBounds (sliderLeft - 10, 935, getWidth() - sliderLeft, dspLoadHeight);
+   #endif
 }
@@ -10,11 +10,15 @@
 
 #include <JuceHeader.h>
 #include "PluginProcessor.h"
+#include "CoherenceDisplay.h"
 
 //==============================================================================
 /**
 */
 class StereoWidenerAudioProcessorEditor  : public juce::AudioProcessorEditor
+                                         #if STEREOWIDENER_PROFILING
+                                          , private juce::Timer
+                                         #endif
 {
 public:
     StereoWidenerAudioProcessorEditor (StereoWidenerAudioProcessor&,            juce::AudioProcessorValueTreeState&);
@@ -41,11 +45,40 @@ private:
     juce::Label hasAllpassDecorrelationLabel;
     juce::ToggleButton handleTransients;
     juce::Label handleTransientsLabel;
+    juce::Slider lookaheadSlider;
+    juce::Label lookaheadLabel;
+    juce::ComboBox transientLinkModeBox;
+    juce::Label transientLinkModeLabel;
+    juce::ToggleButton transientHighBandOnly;
+    juce::Label transientHighBandOnlyLabel;
+    juce::ToggleButton multirateLowBand;
+    juce::Label multirateLowBandLabel;
+    juce::ToggleButton midDecorrelation;
+    juce::Label midDecorrelationLabel;
+    juce::ComboBox engineBox;
+    juce::Label engineLabel;
+    juce::Slider speakerAngleSlider;
+    juce::Label speakerAngleLabel;
+    CoherenceDisplay coherenceDisplay;
     
     std::unique_ptr <juce::AudioProcessorValueTreeState::SliderAttachment> widthLowerAttach;
     std::unique_ptr <juce::AudioProcessorValueTreeState::SliderAttachment> widthHigherAttach;
     std::unique_ptr <juce::AudioProcessorValueTreeState::SliderAttachment> cutoffFrequencyAttach;
-    std::unique_ptr <juce::ParameterAttachment> isAmpPreserveAttach, hasAllpassDecorrelationAttach, handleTransientsAttach;
+    std::unique_ptr <juce::AudioProcessorValueTreeState::SliderAttachment> lookaheadAttach;
+    std::unique_ptr <juce::AudioProcessorValueTreeState::SliderAttachment> speakerAngleAttach;
+    std::unique_ptr <juce::AudioProcessorValueTreeState::ComboBoxAttachment> transientLinkModeAttach;
+    std::unique_ptr <juce::AudioProcessorValueTreeState::ComboBoxAttachment> engineAttach;
+    std::unique_ptr <juce::ParameterAttachment> isAmpPreserveAttach, hasAllpassDecorrelationAttach, handleTransientsAttach, transientHighBandOnlyAttach, multirateLowBandAttach, midDecorrelationAttach;
+    
+   #if STEREOWIDENER_PROFILING
+    //DSP load readout of each stage
+    juce::Label dspLoadLabel;
+    void timerCallback() override;
+    enum{
+        dspLoadHeight = 120,
+        dspLoadRefreshHz = 4,
+    };
+   #endif
 
 
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (StereoWidenerAudioProcessorEditor)
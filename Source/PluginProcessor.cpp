@@ -9,6 +9,13 @@
 #include "PluginProcessor.h"
 #include "PluginEditor.h"
 
+#if STEREOWIDENER_TRACING
+//trace event names have to outlive the instance, so parameter changes are
+//recorded with these literals
+static const char* const tracedParameterIDs[] = {"widthLower", "widthHigher", "cutoffFrequency", "isAmpPreserve",
+    "hasAllpassDecorrelation", "handleTransients", "lookaheadSamples", "transientLinkMode", "transientHighBandOnly", "multirateLowBand", "midDecorrelation", "engine", "speakerAngle"};
+#endif
+
 //==============================================================================
 StereoWidenerAudioProcessor::StereoWidenerAudioProcessor()
 #ifndef JucePlugin_PreferredChannelConfigurations
@@ -51,6 +58,36 @@ StereoWidenerAudioProcessor::StereoWidenerAudioProcessor()
       (juce::ParameterID{"handleTransients",1},
        "Transient detection",
        0, 1, 0),
+    std::make_unique<juce::AudioParameterInt>
+      (juce::ParameterID{"lookaheadSamples",1},
+       "Transient lookahead",
+       0, maxLookaheadSamples, 0),
+    std::make_unique<juce::AudioParameterChoice>
+      (juce::ParameterID{"transientLinkMode",1},
+       "Transient link mode",
+       juce::StringArray{"Independent", "Linked (max)", "Linked (sum)"}, 0),
+    std::make_unique<juce::AudioParameterInt>
+      (juce::ParameterID{"transientHighBandOnly",1},
+       "Transients in high band only",
+       0, 1, 0),
+    std::make_unique<juce::AudioParameterInt>
+      (juce::ParameterID{"multirateLowBand",1},
+       "Multirate low band",
+       0, 1, 0),
+    std::make_unique<juce::AudioParameterInt>
+      (juce::ParameterID{"midDecorrelation",1},
+       "Shared mid decorrelation",
+       0, 1, 0),
+    std::make_unique<juce::AudioParameterChoice>
+      (juce::ParameterID{"engine",1},
+       "Processing engine",
+       juce::StringArray{"Time domain", "STFT", "HRTF"}, 0),
+    std::make_unique<juce::AudioParameterFloat>
+    (juce::ParameterID{"speakerAngle",1},
+     "Speaker angle",
+     0.0f,
+     (float) HrtfWidener::maxSpeakerAngleDeg,
+     30.0f),
     })
 #endif
 {
@@ -61,10 +98,37 @@ StereoWidenerAudioProcessor::StereoWidenerAudioProcessor()
     isAmpPreserve = parameters.getRawParameterValue("isAmpPreserve");
     hasAllpassDecorrelation = parameters.getRawParameterValue("hasAllpassDecorrelation");
     handleTransients = parameters.getRawParameterValue("handleTransients");
+    lookaheadSamples = parameters.getRawParameterValue("lookaheadSamples");
+    transientLinkMode = parameters.getRawParameterValue("transientLinkMode");
+    transientHighBandOnly = parameters.getRawParameterValue("transientHighBandOnly");
+    multirateLowBand = parameters.getRawParameterValue("multirateLowBand");
+    midDecorrelation = parameters.getRawParameterValue("midDecorrelation");
+    engine = parameters.getRawParameterValue("engine");
+    speakerAngle = parameters.getRawParameterValue("speakerAngle");
+
+   #if STEREOWIDENER_TRACING
+    traceInstance = traceRecorder->register_instance();
+    for (auto parameterID : tracedParameterIDs)
+        parameters.addParameterListener(parameterID, this);
+   #endif
+    startTimerHz(latencyUpdateHz);
+}
 
+StereoWidenerAudioProcessor::~StereoWidenerAudioProcessor(){
+    stopTimer();
+   #if STEREOWIDENER_TRACING
+    for (auto parameterID : tracedParameterIDs)
+        parameters.removeParameterListener(parameterID, this);
+   #endif
 }
 
-StereoWidenerAudioProcessor::~StereoWidenerAudioProcessor(){}
+#if STEREOWIDENER_TRACING
+void StereoWidenerAudioProcessor::parameterChanged(const juce::String& parameterID, float newValue){
+    for (auto tracedID : tracedParameterIDs)
+        if (parameterID == tracedID)
+            TRACE_INSTANT(*traceRecorder, traceInstance, tracedID, newValue);
+}
+#endif
 
 //==============================================================================
 const juce::String StereoWidenerAudioProcessor::getName() const
@@ -129,8 +193,17 @@ void StereoWidenerAudioProcessor::changeProgramName (int index, const juce::Stri
 }
 
 //read optimised VN file
-juce::StringArray StereoWidenerAudioProcessor::initialise_velvet_from_binary_file(){
-    auto input = juce::MemoryInputStream(BinaryData::opt_vn_filters_txt, BinaryData::opt_vn_filters_txtSize, false);
+juce::StringArray StereoWidenerAudioProcessor::initialise_velvet_from_binary_file(double sampleRate){
+    //the rates of Resources/opt_vn_filters_<rate>.txt
+    const int rates[] = {44100, 48000, 88200, 96000, 192000};
+    int nearest = rates[0];
+    for (int rate : rates)
+        if (std::abs(rate - sampleRate) < std::abs(nearest - sampleRate))
+            nearest = rate;
+    int size = 0;
+    const char* data = BinaryData::getNamedResource(("opt_vn_filters_" + juce::String(nearest) + "_txt").toRawUTF8(), size);
+    jassert(data != nullptr);
+    auto input = juce::MemoryInputStream(data, (size_t) size, false);
     //read the entire text file as a string
     const juce::String fileAsString = input.readEntireStreamAsString();
     //break each line into a new string
@@ -144,9 +217,21 @@ void StereoWidenerAudioProcessor::prepareToPlay (double sampleRate, int samplesP
 {
     // Use this method as the place to do any pre-playback
     // initialisation that you need..
+    TRACE_SCOPE(*traceRecorder, traceInstance, "prepareToPlay");
     allpassCascade = new AllpassBiquadCascade[numChannels];
     velvetSequence = new VelvetNoise[numChannels];
-    juce::StringArray opt_velvet_arrays = initialise_velvet_from_binary_file();
+    juce::StringArray opt_velvet_arrays = initialise_velvet_from_binary_file(sampleRate);
+    
+    //half of the biquads are shared, each channel has a quarter
+    midAllpassCascade = new AllpassBiquadCascade();
+    midAllpassCascade->initialize(numBiquads / 2, sampleRate, maxGroupDelayMs);
+    midAllpassBranches = new AllpassBiquadCascade[numChannels];
+    midVelvetSequence = new VelvetNoise();
+    if (useOptVelvetFilters)
+        midVelvetSequence->initialize_from_string(opt_velvet_arrays[0].toStdString());
+    else
+        midVelvetSequence->initialize(sampleRate, vnLenMs, density, targetDecaydB, logDistribution);
+    midVelvetSequence->split_taps_for_stereo();
     
     pan = new Panner[numFreqBands * numChannels];
     amp_preserve_filters = new LinkwitzCrossover* [numFreqBands * numChannels];
@@ -155,20 +240,67 @@ void StereoWidenerAudioProcessor::prepareToPlay (double sampleRate, int samplesP
     temp_output = new float[numFreqBands];
     pannerInputs = new float[numChannels];
     transient_handler = new TransientHandler[numChannels];
+    lookaheadDelay = std::vector<AlignmentDelay>(numChannels);
     final_output = new float* [numChannels];
     
+    //the low band is decimated as far as the sample rate allows
+    multirateFactor = 1;
+    while (multirateFactor < maxMultirateFactor && sampleRate / (2 * multirateFactor) >= minLowBandSampleRate)
+        multirateFactor *= 2;
+    multirateLatency = MultirateDecimator::get_round_trip_latency(multirateFactor);
+    multiratePhase = 0;
+    multirateActive = false;
+    //assigned rather than resized, so that a second prepare starts from fresh state
+    inputDecimator = std::vector<MultirateDecimator>(numChannels);
+    decorrDecimator = std::vector<MultirateDecimator>(numChannels);
+    lowBandInterpolator = std::vector<MultirateInterpolator>(numChannels);
+    lowRateAmpFilters = std::vector<LinkwitzCrossover>(2 * numChannels);
+    lowRateEnergyFilters = std::vector<ButterworthFilter>(2 * numChannels);
+    multirateAlignDelay = std::vector<AlignmentDelay>(3 * numChannels);
+    
+    //the kernels of the best instruction set of this CPU, unless overridden
+    simdKernels = &SimdKernels::get(SimdKernels::get_requested_tier());
+    
+    activeEngine = timeDomainEngine;
+    stftWidener = std::make_unique<StftWidener>();
+    stftWidener->prepare(numChannels, sampleRate);
+    //offline renders design the HRTF filters on the audio thread, so that
+    //the crossfades do not depend on the timing of the designer thread
+    hrtfWidener = std::make_unique<HrtfWidener>();
+    if (numChannels == 2)
+        hrtfWidener->prepare(sampleRate, *speakerAngle, ! isNonRealtime());
+    engineAlignDelay = std::vector<AlignmentDelay>(2 * numChannels);
+    const int maxEngineLatency = juce::jmax(stftWidener->get_latency(), numChannels == 2 ? hrtfWidener->get_latency() : 0);
+    
     int count = 0;
 
     for(int k = 0; k < numChannels; k++){
         //initialise transient handler
         if (handleTransients)
             transient_handler[k].prepare(samplesPerBlock, sampleRate);
+        lookaheadDelay[k].prepare(maxLookaheadSamples);
+        
+        //initialise the multirate low band
+        inputDecimator[k].prepare(multirateFactor);
+        decorrDecimator[k].prepare(multirateFactor);
+        lowBandInterpolator[k].prepare(multirateFactor);
+        for (int j = 0; j < 2; j++){
+            lowRateAmpFilters[2 * k + j].initialize(sampleRate / multirateFactor, "lowpass");
+            lowRateEnergyFilters[2 * k + j].initialize(sampleRate / multirateFactor, prewarpFreqHz, "lowpass");
+        }
+        for (int j = 0; j < 3; j++){
+            multirateAlignDelay[3 * k + j].prepare(multirateLatency);
+            multirateAlignDelay[3 * k + j].setLength(multirateLatency);
+        }
+        for (int j = 0; j < 2; j++)
+            engineAlignDelay[2 * k + j].prepare(maxEngineLatency);
         
         //initialise decorrelators
         allpassCascade[k].initialize(numBiquads, sampleRate, maxGroupDelayMs);
+        midAllpassBranches[k].initialize(numBiquads / 4, sampleRate, maxGroupDelayMs, k + 1);
         
         if (useOptVelvetFilters){
-            velvetSequence[k].initialize_from_string(opt_velvet_arrays[k]);
+            velvetSequence[k].initialize_from_string(opt_velvet_arrays[k].toStdString());
         }
         else{
             velvetSequence[k].initialize(sampleRate, vnLenMs, density, targetDecaydB, logDistribution);
@@ -176,8 +308,8 @@ void StereoWidenerAudioProcessor::prepareToPlay (double sampleRate, int samplesP
         
         //initialise panner inputs
         pannerInputs[k] = 0.f;
-        //final output buffer
-        final_output[k] = new float[samplesPerBlock];
+        //final output buffer, points to the transient handler's output
+        final_output[k] = nullptr;
 
         for (int i = 0; i < numFreqBands; i++){
             temp_output[i] = 0.0;
@@ -206,13 +338,34 @@ void StereoWidenerAudioProcessor::prepareToPlay (double sampleRate, int samplesP
     
     inputData = std::vector<std::vector<float>>(numChannels, std::vector<float>(samplesPerBlock, 0.0f));
     outputData = std::vector<std::vector<float>>(numChannels, std::vector<float>(samplesPerBlock, 0.0f));
+    detectorData = std::vector<std::vector<float>>(numChannels, std::vector<float>(samplesPerBlock, 0.0f));
+    linkedDetectorData = std::vector<float>(samplesPerBlock, 0.0f);
+    linkedDryGains = std::vector<float>(samplesPerBlock, 0.0f);
+    linkedOutputData = std::vector<std::vector<float>>(numChannels, std::vector<float>(samplesPerBlock, 0.0f));
+    lowBandOutputData = std::vector<std::vector<float>>(numChannels, std::vector<float>(samplesPerBlock, 0.0f));
+    highBandInputData = std::vector<std::vector<float>>(numChannels, std::vector<float>(samplesPerBlock, 0.0f));
+    highBandOutputData = std::vector<std::vector<float>>(numChannels, std::vector<float>(samplesPerBlock, 0.0f));
+    decorrData = std::vector<std::vector<float>>(numChannels, std::vector<float>(samplesPerBlock, 0.0f));
+    bandInputData = std::vector<std::vector<float>>(numFreqBands * numChannels, std::vector<float>(samplesPerBlock, 0.0f));
+    bandDecorrData = std::vector<std::vector<float>>(numFreqBands * numChannels, std::vector<float>(samplesPerBlock, 0.0f));
+    multirateQueue = std::vector<std::vector<float>>(numChannels, std::vector<float>(maxMultirateFactor, 0.0f));
+    multirateOutputData = std::vector<std::vector<float>>(numChannels, std::vector<float>(samplesPerBlock, 0.0f));
     prevWidthLower = 0.f;
     curWidthLower = 0.f;
     prevWidthHigher = 0.0f;
     curWidthHigher = 0.f;
     prevCutoffFreq = 500.0f;
     smooth_factor = std::exp(-1.0f / (smoothingTimeMs * 0.001f * sampleRate));
-
+    curLookahead = 0;
+    curLatency = 0;
+    hasOnsetMaps = false;
+    samplePosition = 0;
+    updateLookahead();
+    setLatencySamples(curLatency);
+    coherenceAnalyzer.prepare(sampleRate);
+   #if STEREOWIDENER_PROFILING
+    stageProfiler.prepare(sampleRate);
+   #endif
 }
 
 void StereoWidenerAudioProcessor::releaseResources()
@@ -225,12 +378,28 @@ void StereoWidenerAudioProcessor::releaseResources()
     delete [] gain_multiplier;
     delete [] allpassCascade;
     delete [] velvetSequence;
+    delete [] midAllpassBranches;
+    delete midAllpassCascade;
+    delete midVelvetSequence;
     delete [] transient_handler;
+    lookaheadDelay.clear();
+    inputDecimator.clear();
+    decorrDecimator.clear();
+    lowBandInterpolator.clear();
+    lowRateAmpFilters.clear();
+    lowRateEnergyFilters.clear();
+    multirateAlignDelay.clear();
+    stftWidener.reset();
+    hrtfWidener.reset();
+    engineAlignDelay.clear();
     
     for (int i = 0; i < numChannels * numFreqBands; i++){
         delete [] amp_preserve_filters[i];
         delete [] energy_preserve_filters[i];
     }
+    delete [] amp_preserve_filters;
+    delete [] energy_preserve_filters;
+    delete [] final_output;
     
 }
 
@@ -264,10 +433,178 @@ inline float StereoWidenerAudioProcessor::onePoleFilter(float input, float previ
     return (input * (1.0f-smooth_factor)) + (previous_output * smooth_factor);
 }
 
+void StereoWidenerAudioProcessor::resetParameterSmoothing(){
+    //jump to the current parameter values instead of smoothing towards them,
+    //e.g. for offline renders that should not fade in from zero width
+    //panners 0 and 2 have lowpassed signals
+    //panners 1 and 3 have highpass signals
+    curWidthLower = prevWidthLower = *widthLower;
+    curWidthHigher = prevWidthHigher = *widthHigher;
+    curCutoffFreq = prevCutoffFreq = *cutoffFrequency;
+    
+    int count = 0;
+    for(int k = 0; k < numChannels; k++){
+        pan[k * numFreqBands].updateWidth(curWidthLower/100.0);
+        pan[k * numFreqBands + 1].updateWidth(curWidthHigher/100.0);
+        for (int i = 0; i < numFreqBands; i++){
+            for (int j = 0; j < numChannels; j++){
+                amp_preserve_filters[count][j].update(curCutoffFreq);
+                energy_preserve_filters[count][j].update(curCutoffFreq);
+            }
+            count++;
+        }
+    }
+    for (int k = 0; k < 2 * numChannels; k++){
+        lowRateAmpFilters[k].update(curCutoffFreq);
+        lowRateEnergyFilters[k].update(curCutoffFreq);
+    }
+    updateLookahead();
+    setLatencySamples(curLatency);
+}
+
+std::vector<double> StereoWidenerAudioProcessor::getTransientEnvelopeSums(){
+    std::vector<double> envelopeSums;
+    for (int k = 0; k < numChannels; k++)
+        envelopeSums.push_back(transient_handler[k].get_onset_detector().get_envelope_sum());
+    return envelopeSums;
+}
+
+void StereoWidenerAudioProcessor::setTransientEnvelopeSums(const std::vector<double>& envelopeSums, juce::int64 numSamples){
+    jassert((int) envelopeSums.size() == numChannels);
+    for (int k = 0; k < numChannels; k++)
+        transient_handler[k].get_onset_detector().set_envelope_sum(envelopeSums[(size_t) k], (unsigned long) numSamples);
+}
+
+int StereoWidenerAudioProcessor::getProcessingPeriod(){
+    return activeEngine == stftEngine ? stftWidener->get_hop_size() : 1;
+}
+
+void StereoWidenerAudioProcessor::setOnsetMaps(const std::vector<std::vector<juce::int64>>& onsetMaps, juce::int64 startPosition){
+    jassert(onsetMaps.size() == 1 || (int) onsetMaps.size() == numChannels);
+    //there is no lookahead with onset maps, the maps are filtered with the hold time without it
+    hasOnsetMaps = true;
+    updateLookahead();
+    setLatencySamples(curLatency);
+    for (int k = 0; k < numChannels; k++)
+        transient_handler[k].set_onset_map(onsetMaps[juce::jmin((size_t) k, onsetMaps.size() - 1)]);
+    samplePosition = startPosition;
+}
+
+void StereoWidenerAudioProcessor::clearOnsetMaps(){
+    for (int k = 0; k < numChannels; k++)
+        transient_handler[k].clear_onset_map();
+    hasOnsetMaps = false;
+    updateLookahead();
+    setLatencySamples(curLatency);
+}
+
+bool StereoWidenerAudioProcessor::usesOnsetMaps(){
+    return hasOnsetMaps && isNonRealtime() && *handleTransients && ! usesBandLimitedTransients();
+}
+
+int StereoWidenerAudioProcessor::getRequestedEngine(){
+    const int requested = (int) *engine;
+    if (requested == hrtfEngine && numChannels != 2)
+        return timeDomainEngine;
+    return requested;
+}
+
+int StereoWidenerAudioProcessor::getEngineLatency(){
+    if (activeEngine == stftEngine)
+        return stftWidener->get_latency();
+    if (activeEngine == hrtfEngine)
+        return hrtfWidener->get_latency();
+    return multirateActive ? multirateLatency : 0;
+}
+
+bool StereoWidenerAudioProcessor::usesBandLimitedTransients(){
+    return *transientHighBandOnly && getRequestedEngine() == timeDomainEngine;
+}
+
+
+void StereoWidenerAudioProcessor::updateLookahead(){
+    //the audio path is only delayed when transients are handled. The cross-fade
+    //to the dry signal is complete before the transient arrives when the
+    //lookahead is at least as long as the cross-fade (5 ms).
+    //In band-limited mode the detector runs on the filterbank output, which is
+    //already delayed, so there is no lookahead. Neither is there with onset maps,
+    //which already know where the onsets are
+    const bool hasLookahead = *handleTransients && ! usesBandLimitedTransients() && ! usesOnsetMaps();
+    const int newLookahead = hasLookahead ? (int) *lookaheadSamples : 0;
+    if (newLookahead != curLookahead){
+        //the detector is only delayed with the rest of the signal when there is
+        //lookahead, its delay lines hold stale samples when it is turned on
+        const bool detectorStarts = curLookahead == 0;
+        curLookahead = newLookahead;
+        //the cross-fades are timed by the detector, the input is held for
+        //longer so that the transient is still dry when it comes out
+        for (int k = 0; k < numChannels; k++){
+            lookaheadDelay[k].setLength(curLookahead);
+            transient_handler[k].set_lookahead(curLookahead);
+            if (detectorStarts){
+                multirateAlignDelay[3 * k + 2].clear();
+                engineAlignDelay[2 * k + 1].clear();
+            }
+        }
+    }
+    
+    //the STFT and HRTF engines start from silence, the dry path is delayed by their latency
+    const int newEngine = getRequestedEngine();
+    if (newEngine != activeEngine){
+        activeEngine = newEngine;
+        if (activeEngine == stftEngine)
+            stftWidener->reset();
+        else if (activeEngine == hrtfEngine)
+            hrtfWidener->reset();
+        //these only hold the latency of the slower engine
+        if (activeEngine != timeDomainEngine)
+            for (int k = 0; k < 2 * numChannels; k++){
+                engineAlignDelay[k].clear();
+                engineAlignDelay[k].setLength(getEngineLatency());
+            }
+    }
+    
+    //the multirate low band is late by the delay of the resamplers, the rest of
+    //the signal path waits for it. Its state is cleared when it is switched on.
+    //The other engines have no low band of their own
+    const bool newMultirate = *multirateLowBand && multirateFactor > 1 && activeEngine == timeDomainEngine;
+    if (newMultirate != multirateActive){
+        multirateActive = newMultirate;
+        if (multirateActive){
+            multiratePhase = 0;
+            for (int k = 0; k < numChannels; k++){
+                inputDecimator[k].reset();
+                decorrDecimator[k].reset();
+                lowBandInterpolator[k].reset();
+                std::fill(multirateQueue[k].begin(), multirateQueue[k].end(), 0.0f);
+                //these only hold multirateLatency samples
+                for (int j = 0; j < 3; j++)
+                    multirateAlignDelay[3 * k + j].clear();
+            }
+        }
+    }
+    
+    //setLatencySamples locks JUCE's listener list and calls the host. The
+    //callers outside processBlock report the latency themselves, and the
+    //timer reports the changes made in processBlock on the message thread
+    curLatency = curLookahead + getEngineLatency();
+    pendingLatency = curLatency;
+}
+
+
+void StereoWidenerAudioProcessor::timerCallback(){
+    const int latency = pendingLatency;
+    if (latency != getLatencySamples())
+        setLatencySamples(latency);
+}
+
 
 void StereoWidenerAudioProcessor::processBlock (juce::AudioBuffer<float>& buffer, juce::MidiBuffer& midiMessages)
 {
     juce::ScopedNoDenormals noDenormals;
+    REALTIME_GUARD_SCOPE;
+    STAGE_PROFILER_BLOCK(stageProfiler, buffer.getNumSamples());
+    TRACE_SCOPE(*traceRecorder, traceInstance, "processBlock");
     int count = 0;
     
     //update parameter
@@ -304,9 +641,16 @@ void StereoWidenerAudioProcessor::processBlock (juce::AudioBuffer<float>& buffer
                 count++;
             }
         }
+        for (int k = 0; k < 2 * numChannels; k++){
+            lowRateAmpFilters[k].update(curCutoffFreq);
+            lowRateEnergyFilters[k].update(curCutoffFreq);
+        }
         prevCutoffFreq = curCutoffFreq;
     }
     
+    //update transient lookahead
+    updateLookahead();
+    
     auto totalNumInputChannels  = getTotalNumInputChannels();
     auto totalNumOutputChannels = getTotalNumOutputChannels();
     const int numSamples = buffer.getNumSamples();
@@ -316,59 +660,265 @@ void StereoWidenerAudioProcessor::processBlock (juce::AudioBuffer<float>& buffer
     for(int chan = 0; chan < totalNumInputChannels; chan++){
         const float* channelInData = buffer.getReadPointer(chan, 0);
 
-        for (int i = 0; i < numSamples; i++){
-            inputData[chan][i] = channelInData[i];
+        if (curLookahead > 0){
+            //the transient detector sees the input before the audio path does
+            for (int i = 0; i < numSamples; i++){
+                detectorData[chan][i] = channelInData[i];
+                inputData[chan][i] = lookaheadDelay[chan].process(channelInData[i]);
+            }
+        }
+        else{
+            for (int i = 0; i < numSamples; i++){
+                inputData[chan][i] = channelInData[i];
+            }
         }
     }
     
-    //process input to get output
-    for (int i = 0; i < numSamples; i++){
-        count = 0;
+    //in the STFT engine decorrelation, the filterbank and panning are one stage
+    if (activeEngine == stftEngine){
+        STAGE_PROFILER_SCOPE(stageProfiler, stft);
+        TRACE_SCOPE(*traceRecorder, traceInstance, "stft");
+        //the smoothed parameters
+        stftWidener->update_parameters(prevWidthLower/100.0f, prevWidthHigher/100.0f, prevCutoffFreq, *isAmpPreserve);
+        for(int chan = 0; chan < totalNumOutputChannels; chan++)
+            stftWidener->process(chan, &inputData[chan][0], &outputData[chan][0], numSamples);
+    }
+    //the HRTF engine replaces them with the virtual speakers
+    else if (activeEngine == hrtfEngine){
+        STAGE_PROFILER_SCOPE(stageProfiler, hrtf);
+        TRACE_SCOPE(*traceRecorder, traceInstance, "hrtf");
+        hrtfWidener->set_speaker_angle(*speakerAngle);
+        hrtfWidener->process(&inputData[0][0], &inputData[1][0], &outputData[0][0], &outputData[1][0], numSamples);
+    }
+    
+    if (activeEngine != timeDomainEngine){
+        //delay the input and the detector by as much as the engine
         for(int chan = 0; chan < totalNumOutputChannels; chan++){
-            float output = 0.0f;
-            float decorr_output = 0.0f;
-            
-            //decorrelate input channel by convolving with VN sequence
-            if (*hasAllpassDecorrelation)
-                decorr_output = allpassCascade[chan].process(inputData[chan][i]);
-            //or by passing through allpass cascade
-            else
-                decorr_output = velvetSequence[chan].process(inputData[chan][i]);
-            
-            //process in frequency bands
-            for(int k = 0; k < numFreqBands; k++){
-                float filtered_input = 0.0f;
-                float filtered_decorr_output = 0.0f;
-                //pass input and decorrelation output through filterbank
-                if (*isAmpPreserve){
-                    filtered_input = amp_preserve_filters[k][chan].process(inputData[chan][i]);
-                    filtered_decorr_output = amp_preserve_filters[numFreqBands + k][chan].process(decorr_output);
+            AlignmentDelay* align = &engineAlignDelay[2 * chan];
+            for (int i = 0; i < numSamples; i++){
+                inputData[chan][i] = align[0].process(inputData[chan][i]);
+                if (curLookahead > 0)
+                    detectorData[chan][i] = align[1].process(detectorData[chan][i]);
+                if (! *handleTransients)
+                    buffer.setSample(chan, i, outputData[chan][i]);
+            }
+        }
+    }
+    
+    //process input to get output, one stage at a time over the whole block
+    //decorrelate input channel by passing through allpass cascade
+    //or by convolving with VN sequence
+    if (activeEngine == timeDomainEngine){
+        STAGE_PROFILER_SCOPE(stageProfiler, decorrelation);
+        TRACE_SCOPE(*traceRecorder, traceInstance, "decorrelation");
+        const bool allpassDecorrelation = *hasAllpassDecorrelation;
+        if (*midDecorrelation && totalNumOutputChannels == 2){
+            //one decorrelator on the mid signal gives both channels' decorrelated signals,
+            //the side signal is added back so that panning and anti-phase content are kept
+            for (int i = 0; i < numSamples; i++){
+                const float mid = 0.5f * (inputData[0][i] + inputData[1][i]);
+                const float side = 0.5f * (inputData[0][i] - inputData[1][i]);
+                float left, right;
+                if (allpassDecorrelation){
+                    const float shared = midAllpassCascade->process(mid);
+                    left = midAllpassBranches[0].process(shared);
+                    right = midAllpassBranches[1].process(shared);
+                }
+                else
+                    midVelvetSequence->process_stereo(mid, left, right);
+                decorrData[0][i] = left + side;
+                decorrData[1][i] = right - side;
+            }
+        }
+        else{
+            for(int chan = 0; chan < totalNumOutputChannels; chan++){
+                if (allpassDecorrelation){
+                    for (int i = 0; i < numSamples; i++)
+                        decorrData[chan][i] = allpassCascade[chan].process(inputData[chan][i]);
+                }
+                else
+                    velvetSequence[chan].process_block(&inputData[chan][0], &decorrData[chan][0], numSamples, *simdKernels);
+            }
+        }
+    }
+    
+    //in multirate mode the low band is processed at the lower rate
+    if (multirateActive){
+        STAGE_PROFILER_SCOPE(stageProfiler, filterbank);
+        TRACE_SCOPE(*traceRecorder, traceInstance, "multirate");
+        const bool ampPreserve = *isAmpPreserve;
+        const int startPhase = multiratePhase;
+        for(int chan = 0; chan < totalNumOutputChannels; chan++){
+            float* queue = &multirateQueue[chan][0];
+            int phase = startPhase;
+            for (int i = 0; i < numSamples; i++){
+                multirateOutputData[chan][i] = queue[phase];
+                phase = (phase + 1 == multirateFactor) ? 0 : phase + 1;
+                
+                float decimated_input = 0.0f, decimated_decorr = 0.0f;
+                decorrDecimator[chan].process(decorrData[chan][i], decimated_decorr);
+                if (! inputDecimator[chan].process(inputData[chan][i], decimated_input))
+                    continue;
+                float filtered_input, filtered_decorr_output;
+                if (ampPreserve){
+                    filtered_input = lowRateAmpFilters[2 * chan].process(decimated_input);
+                    filtered_decorr_output = lowRateAmpFilters[2 * chan + 1].process(decimated_decorr);
                 }
                 else{
-                    filtered_input = energy_preserve_filters[k][chan].process(inputData[chan][i]);
-                    filtered_decorr_output = energy_preserve_filters[numFreqBands + k][chan].process(decorr_output);
+                    filtered_input = lowRateEnergyFilters[2 * chan].process(decimated_input);
+                    filtered_decorr_output = lowRateEnergyFilters[2 * chan + 1].process(decimated_decorr);
                 }
-
                 pannerInputs[0] = filtered_decorr_output;
                 pannerInputs[1] = filtered_input;
-                float panner_output = pan[count++].process(pannerInputs);
-                output += panner_output;
+                lowBandInterpolator[chan].process(pan[chan * numFreqBands].process(pannerInputs), queue);
+            }
+            
+            //delay the full rate signals by as much as the low band
+            AlignmentDelay* align = &multirateAlignDelay[3 * chan];
+            for (int i = 0; i < numSamples; i++){
+                inputData[chan][i] = align[0].process(inputData[chan][i]);
+                decorrData[chan][i] = align[1].process(decorrData[chan][i]);
+            }
+            if (curLookahead > 0)
+                for (int i = 0; i < numSamples; i++)
+                    detectorData[chan][i] = align[2].process(detectorData[chan][i]);
+        }
+        multiratePhase = (int) ((startPhase + numSamples) % multirateFactor);
+    }
+    
+    //pass input and decorrelation output through filterbank
+    if (activeEngine == timeDomainEngine){
+        STAGE_PROFILER_SCOPE(stageProfiler, filterbank);
+        TRACE_SCOPE(*traceRecorder, traceInstance, "filterbank");
+        const bool ampPreserve = *isAmpPreserve;
+        for(int chan = 0; chan < totalNumOutputChannels; chan++){
+            //the low band has been processed at the lower rate
+            for(int k = multirateActive ? 1 : 0; k < numFreqBands; k++){
+                float* filtered_input = &bandInputData[k * numChannels + chan][0];
+                float* filtered_decorr_output = &bandDecorrData[k * numChannels + chan][0];
+                for (int i = 0; i < numSamples; i++){
+                    if (ampPreserve){
+                        filtered_input[i] = amp_preserve_filters[k][chan].process(inputData[chan][i]);
+                        filtered_decorr_output[i] = amp_preserve_filters[numFreqBands + k][chan].process(decorrData[chan][i]);
+                    }
+                    else{
+                        filtered_input[i] = energy_preserve_filters[k][chan].process(inputData[chan][i]);
+                        filtered_decorr_output[i] = energy_preserve_filters[numFreqBands + k][chan].process(decorrData[chan][i]);
+                    }
+                }
+            }
+        }
+    }
+    
+    //pan between the filtered input and decorrelated signal in each band
+    if (activeEngine == timeDomainEngine){
+        STAGE_PROFILER_SCOPE(stageProfiler, panning);
+        TRACE_SCOPE(*traceRecorder, traceInstance, "panning");
+        //one band at a time over the whole block, the panner angles only change between blocks
+        for(int chan = 0; chan < totalNumOutputChannels; chan++){
+            float* output = &outputData[chan][0];
+            for(int k = 0; k < numFreqBands; k++){
+                const float* filtered_input = &bandInputData[k * numChannels + chan][0];
+                //the last band goes to its own buffer, the others pass through it
+                const float* panner_output = &highBandOutputData[chan][0];
+                if (multirateActive && k == 0)
+                    panner_output = &multirateOutputData[chan][0];
+                else{
+                    const float* panner_inputs[2] = {&bandDecorrData[k * numChannels + chan][0], filtered_input};
+                    pan[chan * numFreqBands + k].process_block(panner_inputs, &highBandOutputData[chan][0], numSamples, *simdKernels);
+                }
+                
+                //keep the band above the crossover separately for band-limited
+                //transient handling
+                if (k == numFreqBands - 1){
+                    juce::FloatVectorOperations::copy(&lowBandOutputData[chan][0], output, numSamples);
+                    juce::FloatVectorOperations::copy(&highBandInputData[chan][0], filtered_input, numSamples);
+                    if (panner_output != &highBandOutputData[chan][0])
+                        juce::FloatVectorOperations::copy(&highBandOutputData[chan][0], panner_output, numSamples);
+                }
+                if (k == 0)
+                    juce::FloatVectorOperations::copy(output, panner_output, numSamples);
+                else
+                    juce::FloatVectorOperations::add(output, panner_output, numSamples);
             }
-            outputData[chan][i] = output;
             if (! *handleTransients)
-                buffer.setSample(chan, i, output);
+                buffer.copyFrom(chan, 0, output, numSamples);
         }
     }
     
     // transient handling logic
     if (*handleTransients){
-        for(int chan = 0; chan < totalNumOutputChannels; chan++){
-            final_output[chan] = transient_handler[chan].process(&inputData[chan][0], &outputData[chan][0]);
+        STAGE_PROFILER_SCOPE(stageProfiler, transients);
+        TRACE_SCOPE(*traceRecorder, traceInstance, "transients");
+        const int linkMode = (int) *transientLinkMode;
+        //in band-limited mode only the band above the crossover reverts to the
+        //input on onsets, and the detector runs on that band of the filterbank
+        //output. The bands below the crossover keep their width.
+        const bool highBandOnly = usesBandLimitedTransients();
+        
+        auto getDetectorInput = [&] (int chan) -> float* {
+            if (highBandOnly)
+                return &highBandInputData[chan][0];
+            return (curLookahead > 0) ? &detectorData[chan][0] : &inputData[chan][0];
+        };
+        auto getDryInput = [&] (int chan) -> float* {
+            return highBandOnly ? &highBandInputData[chan][0] : &inputData[chan][0];
+        };
+        auto getWidenerOutput = [&] (int chan) -> float* {
+            return highBandOnly ? &highBandOutputData[chan][0] : &outputData[chan][0];
+        };
+        auto writeOutput = [&] (int chan){
             for (int i = 0; i < numSamples; i++){
-                buffer.setSample(chan, i, final_output[chan][i]);
+                float output = final_output[chan][i];
+                if (highBandOnly)
+                    output += lowBandOutputData[chan][i];
+                buffer.setSample(chan, i, output);
+            }
+        };
+        
+        if (usesOnsetMaps()){
+            //the maps were set per channel, or all handlers share the linked map
+            //the output of the multirate path or of the other engines belongs to an earlier position
+            const juce::int64 mapPosition = samplePosition - (curLatency - curLookahead);
+            for(int chan = 0; chan < totalNumOutputChannels; chan++){
+                transient_handler[chan].detect_from_map(mapPosition, numSamples);
+                final_output[chan] = transient_handler[chan].apply(getDryInput(chan), getWidenerOutput(chan), numSamples);
+                writeOutput(chan);
+            }
+        }
+        else if (linkMode == independentDetection){
+            for(int chan = 0; chan < totalNumOutputChannels; chan++){
+                final_output[chan] = transient_handler[chan].process(getDetectorInput(chan), getDryInput(chan), getWidenerOutput(chan), numSamples);
+                writeOutput(chan);
+            }
+        }
+        else{
+            //one envelope is calculated from the max or sum of all channels,
+            //and a single detection drives the cross-fades of all channels
+            for (int i = 0; i < numSamples; i++){
+                float linked = 0.0f;
+                for(int chan = 0; chan < totalNumOutputChannels; chan++){
+                    const float magnitude = std::abs(getDetectorInput(chan)[i]);
+                    linked = (linkMode == linkedMax) ? juce::jmax(linked, magnitude) : linked + magnitude;
+                }
+                linkedDetectorData[i] = linked;
+            }
+            //the gains are kept here, so that no channel depends on another's buffers
+            transient_handler[0].detect(&linkedDetectorData[0], numSamples);
+            std::copy(transient_handler[0].get_dry_gains(), transient_handler[0].get_dry_gains() + numSamples, linkedDryGains.begin());
+            
+            for(int chan = 0; chan < totalNumOutputChannels; chan++){
+                TransientHandler::crossfade(&linkedDryGains[0], getDryInput(chan), getWidenerOutput(chan), &linkedOutputData[chan][0], numSamples);
+                final_output[chan] = &linkedOutputData[chan][0];
+                writeOutput(chan);
             }
         }
     }
+    
+    //the dry input lines up with the output, the analyzer only copies them
+    if (numChannels == 2)
+        coherenceAnalyzer.push(&inputData[0][0], &inputData[1][0], buffer.getReadPointer(0), buffer.getReadPointer(1), numSamples);
+    samplePosition += numSamples;
 }
     
 
@@ -15,13 +15,24 @@
 #include "ButterworthFilter.h"
 #include "AllpassBiquadCascade.h"
 #include "TransientHandler.h"
+#include "PolyphaseResampler.h"
+#include "StftWidener.h"
+#include "HrtfWidener.h"
+#include "CoherenceAnalyzer.h"
+#include "StageProfiler.h"
+#include "TraceRecorder.h"
+#include "RealtimeGuard.h"
 //==============================================================================
 /**
 */
 class StereoWidenerAudioProcessor  : public juce::AudioProcessor
+                             , private juce::Timer
                             #if JucePlugin_Enable_ARA
                              , public juce::AudioProcessorARAExtension
                             #endif
+                            #if STEREOWIDENER_TRACING
+                             , private juce::AudioProcessorValueTreeState::Listener
+                            #endif
 {
 public:
     //==============================================================================
@@ -61,7 +72,31 @@ public:
     void getStateInformation (juce::MemoryBlock& destData) override;
     void setStateInformation (const void* data, int sizeInBytes) override;
     inline float onePoleFilter(float input, float previous_output);
-    juce::StringArray initialise_velvet_from_binary_file();
+    //the optimised VN filters of the sample rate nearest to this one
+    juce::StringArray initialise_velvet_from_binary_file(double sampleRate);
+    void resetParameterSmoothing();
+    //the onset detectors keep a running mean over the whole signal history, which a
+    //pre-roll cannot warm up. These let an offline render split into segments carry it over
+    std::vector<double> getTransientEnvelopeSums();
+    void setTransientEnvelopeSums(const std::vector<double>& envelopeSums, juce::int64 numSamples);
+    //the output only depends on the input, not on when processing started, if it starts
+    //a multiple of this many samples later (the hop of the STFT engine, which processes
+    //whole frames). Segments of an offline render start on it. Set by prepareToPlay
+    int getProcessingPeriod();
+    //offline two-pass rendering: onsets found in advance for the whole file (one map per
+    //channel, or a single map in linked mode) replace the causal onset detection, so the
+    //cross-fades end at the onsets without lookahead latency. Only used when rendering
+    //non-realtime and not in band-limited mode. startPosition is the file position of the
+    //next block, the maps have to be set again after prepareToPlay
+    void setOnsetMaps(const std::vector<std::vector<juce::int64>>& onsetMaps, juce::int64 startPosition);
+    void clearOnsetMaps();
+    bool usesOnsetMaps();
+    //interchannel coherence of the input and output, for the editor (stereo only)
+    CoherenceAnalyzer& getCoherenceAnalyzer() { return coherenceAnalyzer; }
+   #if STEREOWIDENER_PROFILING
+    //DSP load of each stage of processBlock, for the editor
+    const StageProfiler& getStageProfiler() const { return stageProfiler; }
+   #endif
 
 
     //Input parameters
@@ -72,7 +107,24 @@ public:
     std::atomic<float>* isAmpPreserve;      //calculations are amplitude or energy preserving
     std::atomic<float>* hasAllpassDecorrelation; //what decorrelator to use - VN or AP
     std::atomic<float>* handleTransients;        //whether to have transient handline block
+    std::atomic<float>* lookaheadSamples;        //delay of the audio path w.r.t. the transient detector
+    std::atomic<float>* transientLinkMode;       //detect transients per channel, or once for all channels
+    std::atomic<float>* transientHighBandOnly;   //only the bands above the crossover revert to dry on onsets
+    std::atomic<float>* multirateLowBand;        //process the band below the crossover at a lower sample rate
+    std::atomic<float>* midDecorrelation;        //decorrelate the mid signal once for both channels
+    std::atomic<float>* engine;                  //decorrelate and split into bands in the time domain or the STFT domain, or HRTF speakers
+    std::atomic<float>* speakerAngle;            //angle of the virtual speakers in the HRTF engine
     const int numFreqBands = 2;
+    enum LinkMode{
+        independentDetection = 0,
+        linkedMax,
+        linkedSum,
+    };
+    enum Engine{
+        timeDomainEngine = 0,
+        stftEngine,
+        hrtfEngine,
+    };
 
 private:
     //==============================================================================
@@ -82,21 +134,35 @@ private:
     
     VelvetNoise* velvetSequence;
     AllpassBiquadCascade* allpassCascade;
+    //shared mid decorrelation (stereo only): the two channels' decorrelated signals are
+    //the sum and difference of two halves of one VN sequence, or two short allpass
+    //cascades after a shared one, all fed by the mid signal. The side signal is added to
+    //them undecorrelated, so a panned source keeps its level difference at moderate widths
+    //but not at full width, where only per-channel decorrelation can keep it
+    VelvetNoise* midVelvetSequence;
+    AllpassBiquadCascade* midAllpassCascade;
+    AllpassBiquadCascade* midAllpassBranches;
     Panner* pan;
     LinkwitzCrossover** amp_preserve_filters;
     ButterworthFilter** energy_preserve_filters;
     TransientHandler* transient_handler;
+    std::vector<AlignmentDelay> lookaheadDelay;   //delays the audio path for transient lookahead
     
     int density = 1000;
     float targetDecaydB = 10.;
     bool logDistribution = true;              //whether to concentrate VN impulses at the beginning
-    bool useOptVelvetFilters = false;         //whether to use optimised VN filters
+    bool useOptVelvetFilters = false;         //whether to use optimised VN filters (Tools/VelvetOptimiser)
     float* pannerInputs;
     float* temp_output;
     float* gain_multiplier;
     float prevWidthLower, curWidthLower;
     float prevWidthHigher, curWidthHigher;
     float prevCutoffFreq, curCutoffFreq;
+    int curLookahead;                          //lookahead in samples
+    int curLatency;                            //latency of the audio path, lookahead and engine or multirate delay
+    std::atomic<int> pendingLatency { 0 };     //curLatency, for the message thread to report to the host
+    bool hasOnsetMaps = false;                 //see setOnsetMaps
+    juce::int64 samplePosition = 0;            //position of the next block in the onset maps
     float smooth_factor;                       //one pole filter for parameter update
     enum{
         vnLenMs = 15,
@@ -104,9 +170,68 @@ private:
         maxGroupDelayMs = 15,
         numBiquads = 200,
         prewarpFreqHz = 1000,
+        maxLookaheadSamples = 4096,
+        maxMultirateFactor = 8,
+        minLowBandSampleRate = 24000,           //the low band keeps the spectrum up to 0.4 of this
+        latencyUpdateHz = 20,
     };
+    //sets up the lookahead, engine and multirate paths from the parameters and
+    //updates curLatency, without telling the host
+    void updateLookahead();
+    //reports latency changes made on the audio thread to the host. An
+    //AsyncUpdater would post a message, which takes a lock on some platforms
+    void timerCallback() override;
+    //the engine parameter, the HRTF engine needs a stereo input
+    int getRequestedEngine();
+    int getEngineLatency();
+    //the STFT and HRTF engines have no band above the crossover to revert on its own
+    bool usesBandLimitedTransients();
+    
+    //multirate low band: the input and the decorrelated signal are decimated, then
+    //lowpass filtered and panned at the lower rate, and the result is interpolated
+    //back. The full rate signals are delayed to line up with it
+    int multirateFactor;                        //1 if the sample rate is too low
+    int multirateLatency;
+    int multiratePhase;                         //position in the interpolated samples
+    bool multirateActive = false;
+    std::vector<MultirateDecimator> inputDecimator;
+    std::vector<MultirateDecimator> decorrDecimator;
+    std::vector<MultirateInterpolator> lowBandInterpolator;
+    std::vector<LinkwitzCrossover> lowRateAmpFilters;       //per channel: input, then decorrelated signal
+    std::vector<ButterworthFilter> lowRateEnergyFilters;
+    std::vector<AlignmentDelay> multirateAlignDelay;        //per channel: input, decorrelated signal, detector
+    
+    //STFT and HRTF engines: they replace the decorrelators, the filterbank and
+    //the panners. The dry input is delayed to line up with their output
+    int activeEngine = timeDomainEngine;
+    std::unique_ptr<StftWidener> stftWidener;
+    std::unique_ptr<HrtfWidener> hrtfWidener;   //registered with the designer thread while it lives
+    std::vector<AlignmentDelay> engineAlignDelay;           //per channel: input, detector
+    std::vector<std::vector<float>> multirateQueue;        //interpolated samples still to be output
+    std::vector<std::vector<float>> multirateOutputData;   //low band at the full rate
     std::vector<std::vector<float>> inputData;
+    std::vector<std::vector<float>> detectorData;
+    std::vector<float> linkedDetectorData;      //combined detector input of all channels
+    std::vector<float> linkedDryGains;          //gains of the input from the linked detection
+    std::vector<std::vector<float>> linkedOutputData;    //cross-faded output of each channel in linked mode
+    std::vector<std::vector<float>> lowBandOutputData;   //widened bands below the crossover
+    std::vector<std::vector<float>> highBandInputData;   //input in the band above the crossover
+    std::vector<std::vector<float>> highBandOutputData;  //widened band above the crossover
+    std::vector<std::vector<float>> decorrData;          //decorrelator output
+    std::vector<std::vector<float>> bandInputData;       //input in each band, band-major
+    std::vector<std::vector<float>> bandDecorrData;      //decorrelator output in each band
     std::vector<std::vector<float>> outputData;
     float** final_output;
+    const SimdKernels* simdKernels = nullptr;  //chosen in prepareToPlay, see SimdKernels.h
+    CoherenceAnalyzer coherenceAnalyzer;       //lives as long as the processor, the editor holds on to it
+   #if STEREOWIDENER_PROFILING
+    StageProfiler stageProfiler;
+   #endif
+   #if STEREOWIDENER_TRACING
+    //shared by all instances, see TraceRecorder.h
+    juce::SharedResourcePointer<TraceRecorder> traceRecorder;
+    int traceInstance;
+    void parameterChanged(const juce::String& parameterID, float newValue) override;
+   #endif
 
 };
@@ -0,0 +1,146 @@
+/*
+  ==============================================================================
+
+    PolyphaseResampler.cpp
+
+  ==============================================================================
+*/
+
+#include "PolyphaseResampler.h"
+
+//zeroth order modified Bessel function of the first kind, for the Kaiser window
+static double bessel_i0(double x){
+    double sum = 1.0, term = 1.0;
+    for (int k = 1; k < 50; k++){
+        term *= (x / (2.0 * k)) * (x / (2.0 * k));
+        sum += term;
+        if (term < 1e-12 * sum)
+            break;
+    }
+    return sum;
+}
+
+HalfbandFilter::HalfbandFilter(){
+    //Kaiser windowed sinc with a cutoff at a quarter of the sample rate.
+    //beta = 9 gives about 90 dB stopband attenuation, the passband ends at
+    //about 0.4 of the lower sample rate
+    const double beta = 9.0;
+    const double PI = std::acos(-1.0);
+    double sum = 0.0;
+    for (int j = 0; j < num_pairs; j++){
+        const int offset = 2 * j + 1;
+        const double ratio = (double) offset / centre;
+        const double window = bessel_i0(beta * std::sqrt(1.0 - ratio * ratio)) / bessel_i0(beta);
+        const double sinc = ((j % 2 == 0) ? 1.0 : -1.0) / (PI * offset);
+        coeffs[j] = (float) (sinc * window);
+        sum += sinc * window;
+    }
+    //unity gain at DC: the centre tap is 0.5, both sides add up to the other half
+    for (int j = 0; j < num_pairs; j++)
+        coeffs[j] = (float) (coeffs[j] * 0.25 / sum);
+}
+
+HalfbandFilter::~HalfbandFilter(){}
+
+
+MultirateDecimator::MultirateDecimator(){}
+MultirateDecimator::~MultirateDecimator(){}
+
+void MultirateDecimator::prepare(int factor){
+    jassert(factor == 1 || factor == 2 || factor == 4 || factor == 8);
+    num_stages = 0;
+    while ((1 << num_stages) < factor)
+        num_stages++;
+    reset();
+}
+
+void MultirateDecimator::reset(){
+    for (auto& stage : stages){
+        std::fill(std::begin(stage.history), std::end(stage.history), 0.0f);
+        stage.write_pos = 0;
+        stage.is_odd = false;
+    }
+}
+
+inline bool MultirateDecimator::process_stage(Stage& stage, const float input, float& output){
+    const int N = HalfbandFilter::num_taps;
+    stage.history[stage.write_pos] = input;
+    stage.history[stage.write_pos + N] = input;
+    //x[t - k] is at history[write_pos + k]
+    const float* x = &stage.history[stage.write_pos];
+    stage.write_pos = (stage.write_pos == 0) ? N - 1 : stage.write_pos - 1;
+    
+    stage.is_odd = ! stage.is_odd;
+    if (stage.is_odd)
+        return false;
+    
+    const float* coeffs = halfband.get_coefficients();
+    const int c = HalfbandFilter::centre;
+    float sum = 0.5f * x[c];
+    for (int j = 0; j < HalfbandFilter::num_pairs; j++)
+        sum += coeffs[j] * (x[c - 2 * j - 1] + x[c + 2 * j + 1]);
+    output = sum;
+    return true;
+}
+
+bool MultirateDecimator::process(const float input, float& output){
+    float sample = input;
+    for (int s = 0; s < num_stages; s++)
+        if (! process_stage(stages[s], sample, sample))
+            return false;
+    output = sample;
+    return true;
+}
+
+
+MultirateInterpolator::MultirateInterpolator(){}
+MultirateInterpolator::~MultirateInterpolator(){}
+
+void MultirateInterpolator::prepare(int factor){
+    jassert(factor == 1 || factor == 2 || factor == 4 || factor == 8);
+    num_stages = 0;
+    while ((1 << num_stages) < factor)
+        num_stages++;
+    reset();
+}
+
+void MultirateInterpolator::reset(){
+    for (auto& stage : stages){
+        std::fill(std::begin(stage.history), std::end(stage.history), 0.0f);
+        stage.write_pos = 0;
+    }
+}
+
+inline void MultirateInterpolator::process_stage(Stage& stage, const float input, float* output){
+    //the zeros between the input samples are not stored, so the even outputs
+    //use the nonzero taps and the odd outputs are the centre tap, a delay
+    const int L = 2 * HalfbandFilter::num_pairs;
+    stage.history[stage.write_pos] = input;
+    stage.history[stage.write_pos + L] = input;
+    //x[p - k] is at history[write_pos + k]
+    const float* x = &stage.history[stage.write_pos];
+    stage.write_pos = (stage.write_pos == 0) ? L - 1 : stage.write_pos - 1;
+    
+    const float* coeffs = halfband.get_coefficients();
+    const int half = HalfbandFilter::num_pairs;
+    float sum = 0.0f;
+    for (int j = 0; j < half; j++)
+        sum += coeffs[j] * (x[half - 1 - j] + x[half + j]);
+    output[0] = 2.0f * sum;
+    output[1] = x[half - 1];
+}
+
+void MultirateInterpolator::process(const float input, float* output){
+    //each stage doubles the number of samples, the last stage writes to the output
+    output[0] = input;
+    int numSamples = 1;
+    for (int s = 0; s < num_stages; s++){
+        float* stageOutput = (s == num_stages - 1) ? output : stage_output[s % 2];
+        const float* stageInput = (s == 0) ? &stage_output[1][0] : stage_output[(s - 1) % 2];
+        if (s == 0)
+            stage_output[1][0] = input;
+        for (int i = 0; i < numSamples; i++)
+            process_stage(stages[s], stageInput[i], &stageOutput[2 * i]);
+        numSamples *= 2;
+    }
+}
@@ -0,0 +1,94 @@
+/*
+  ==============================================================================
+
+    PolyphaseResampler.h
+    Decimation and interpolation by 2, 4 or 8 with cascaded linear-phase
+    halfband FIR filters. In a halfband filter every other tap is zero except
+    the centre, so each stage only computes the nonzero taps at the lower of
+    its two rates, and uses the symmetry of the taps. Samples go in and out
+    one at a time, so blocks of any size can be processed.
+
+  ==============================================================================
+*/
+
+#pragma once
+#include "DspCore.h"
+
+class HalfbandFilter{
+public:
+    HalfbandFilter();
+    ~HalfbandFilter();
+
+    enum{
+        num_taps = 63,                          //the centre tap is at (num_taps - 1) / 2
+        centre = (num_taps - 1) / 2,
+        num_pairs = (num_taps + 1) / 4,         //nonzero taps on each side of the centre
+    };
+
+    //coefficients of the nonzero taps on one side, from the centre outwards
+    const float* get_coefficients() const { return coeffs; }
+
+private:
+    float coeffs[num_pairs];
+};
+
+
+class MultirateDecimator{
+public:
+    MultirateDecimator();
+    ~MultirateDecimator();
+
+    void prepare(int factor);
+    void reset();
+    //delay of decimating and then interpolating by factor, when the factor samples
+    //interpolated from a decimated sample are output over the next factor samples
+    static int get_round_trip_latency(int factor){
+        return 2 * HalfbandFilter::centre * (factor - 1) + 1;
+    }
+    //returns true when a decimated sample is ready (every factor samples)
+    bool process(const float input, float& output);
+
+private:
+    //one stage of decimation by 2
+    struct Stage{
+        float history[2 * HalfbandFilter::num_taps];    //doubled, so the taps never wrap
+        int write_pos = 0;
+        bool is_odd = false;
+    };
+    inline bool process_stage(Stage& stage, const float input, float& output);
+
+    enum{
+        max_stages = 3,
+    };
+    HalfbandFilter halfband;
+    Stage stages[max_stages];
+    int num_stages = 0;
+};
+
+
+class MultirateInterpolator{
+public:
+    MultirateInterpolator();
+    ~MultirateInterpolator();
+
+    void prepare(int factor);
+    void reset();
+    //writes factor samples at the higher rate for each input sample
+    void process(const float input, float* output);
+
+private:
+    //one stage of interpolation by 2
+    struct Stage{
+        float history[4 * HalfbandFilter::num_pairs];   //input of the stage, doubled
+        int write_pos = 0;
+    };
+    inline void process_stage(Stage& stage, const float input, float* output);
+
+    enum{
+        max_stages = 3,
+    };
+    HalfbandFilter halfband;
+    Stage stages[max_stages];
+    int num_stages = 0;
+    float stage_output[2][8];                           //ping-pong buffers between stages
+};
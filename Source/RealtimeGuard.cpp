@@ -0,0 +1,173 @@
+/*
+  ==============================================================================
+
+    RealtimeGuard.cpp
+
+  ==============================================================================
+*/
+
+#include "RealtimeGuard.h"
+
+#if STEREOWIDENER_REALTIME_GUARD
+
+#include <cstdlib>
+#include <cstdio>
+#include <new>
+#if JUCE_LINUX
+ #include <dlfcn.h>
+ #include <pthread.h>
+#endif
+#if JUCE_WINDOWS
+ #include <malloc.h>
+#endif
+
+namespace{
+    //plain globals, they are used from operator new before and after static initialisation
+    std::atomic<juce::int64> num_allocations { 0 };
+    std::atomic<juce::int64> num_deallocations { 0 };
+    std::atomic<juce::int64> num_locks { 0 };
+    std::atomic<bool> asserts_on_violation { true };
+    thread_local int realtime_depth = 0;
+    thread_local bool is_reporting = false;
+
+    enum ViolationType{
+        allocation,
+        deallocation,
+        lock,
+    };
+
+    void report_violation(ViolationType type){
+        if (realtime_depth == 0 || is_reporting)
+            return;
+        auto& counter = (type == allocation) ? num_allocations : (type == deallocation) ? num_deallocations : num_locks;
+        counter++;
+        if (! asserts_on_violation.load(std::memory_order_relaxed))
+            return;
+
+        //reporting must not count itself
+        is_reporting = true;
+        static const char* const messages[] = {"heap allocation", "heap deallocation", "mutex lock"};
+        std::fprintf(stderr, "RealtimeGuard: %s on the audio thread\n", messages[type]);
+       #if JUCE_DEBUG
+        jassertfalse;
+       #else
+        std::abort();
+       #endif
+        is_reporting = false;
+    }
+
+    void* allocate(std::size_t size){
+        report_violation(allocation);
+        if (void* ptr = std::malloc(size == 0 ? 1 : size))
+            return ptr;
+        throw std::bad_alloc();
+    }
+
+    void* allocate_aligned(std::size_t size, std::size_t alignment){
+        report_violation(allocation);
+        size = size == 0 ? 1 : size;
+       #if JUCE_WINDOWS
+        if (void* ptr = _aligned_malloc(size, alignment))
+            return ptr;
+       #else
+        void* ptr = nullptr;
+        if (posix_memalign(&ptr, juce::jmax(alignment, sizeof(void*)), size) == 0)
+            return ptr;
+       #endif
+        throw std::bad_alloc();
+    }
+
+    void deallocate(void* ptr){
+        if (ptr == nullptr)
+            return;
+        report_violation(deallocation);
+        std::free(ptr);
+    }
+
+    void deallocate_aligned(void* ptr){
+        if (ptr == nullptr)
+            return;
+        report_violation(deallocation);
+       #if JUCE_WINDOWS
+        _aligned_free(ptr);
+       #else
+        std::free(ptr);
+       #endif
+    }
+}
+
+RealtimeGuard::Violations RealtimeGuard::get_violations(){
+    Violations violations;
+    violations.allocations = num_allocations.load();
+    violations.deallocations = num_deallocations.load();
+    violations.locks = num_locks.load();
+    return violations;
+}
+
+void RealtimeGuard::reset_violations(){
+    num_allocations = 0;
+    num_deallocations = 0;
+    num_locks = 0;
+}
+
+void RealtimeGuard::set_asserts_on_violation(bool shouldAssert){
+    asserts_on_violation = shouldAssert;
+}
+
+bool RealtimeGuard::is_active(){
+    return true;
+}
+
+RealtimeGuard::Scope::Scope(){
+    realtime_depth++;
+}
+
+RealtimeGuard::Scope::~Scope(){
+    realtime_depth--;
+}
+
+//replacements of the global allocation functions
+void* operator new(std::size_t size){ return allocate(size); }
+void* operator new[](std::size_t size){ return allocate(size); }
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept{
+    try { return allocate(size); } catch (...) { return nullptr; }
+}
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept{
+    try { return allocate(size); } catch (...) { return nullptr; }
+}
+void* operator new(std::size_t size, std::align_val_t alignment){ return allocate_aligned(size, (std::size_t) alignment); }
+void* operator new[](std::size_t size, std::align_val_t alignment){ return allocate_aligned(size, (std::size_t) alignment); }
+
+void operator delete(void* ptr) noexcept{ deallocate(ptr); }
+void operator delete[](void* ptr) noexcept{ deallocate(ptr); }
+void operator delete(void* ptr, std::size_t) noexcept{ deallocate(ptr); }
+void operator delete[](void* ptr, std::size_t) noexcept{ deallocate(ptr); }
+void operator delete(void* ptr, const std::nothrow_t&) noexcept{ deallocate(ptr); }
+void operator delete[](void* ptr, const std::nothrow_t&) noexcept{ deallocate(ptr); }
+void operator delete(void* ptr, std::align_val_t) noexcept{ deallocate_aligned(ptr); }
+void operator delete[](void* ptr, std::align_val_t) noexcept{ deallocate_aligned(ptr); }
+void operator delete(void* ptr, std::size_t, std::align_val_t) noexcept{ deallocate_aligned(ptr); }
+void operator delete[](void* ptr, std::size_t, std::align_val_t) noexcept{ deallocate_aligned(ptr); }
+
+#if JUCE_LINUX
+//locks are intercepted by interposing pthread_mutex_lock, which the executable
+//(the benchmark and test tools) defines before libc. std::mutex and
+//juce::CriticalSection both end up here
+extern "C" int pthread_mutex_lock(pthread_mutex_t* mutex){
+    using LockFunction = int (*)(pthread_mutex_t*);
+    static const LockFunction real_lock = (LockFunction) dlsym(RTLD_NEXT, "pthread_mutex_lock");
+    report_violation(lock);
+    return real_lock(mutex);
+}
+#endif
+
+#else
+
+RealtimeGuard::Violations RealtimeGuard::get_violations(){ return {}; }
+void RealtimeGuard::reset_violations(){}
+void RealtimeGuard::set_asserts_on_violation(bool){}
+bool RealtimeGuard::is_active(){ return false; }
+RealtimeGuard::Scope::Scope(){}
+RealtimeGuard::Scope::~Scope(){}
+
+#endif
@@ -0,0 +1,51 @@
+/*
+  ==============================================================================
+
+    RealtimeGuard.h
+    Catches heap allocations and mutex locks on the audio thread. When
+    STEREOWIDENER_REALTIME_GUARD is 1 (Debug builds and the test tools),
+    the global operator new/delete are replaced, and on Linux so is
+    pthread_mutex_lock. While a thread is inside a REALTIME_GUARD_SCOPE
+    (processBlock), each call is counted as a violation and, unless
+    disabled, asserts.
+
+  ==============================================================================
+*/
+
+#pragma once
+#include "JuceHeader.h"
+
+#ifndef STEREOWIDENER_REALTIME_GUARD
+ #define STEREOWIDENER_REALTIME_GUARD 0
+#endif
+
+class RealtimeGuard{
+public:
+    struct Violations{
+        juce::int64 allocations = 0;
+        juce::int64 deallocations = 0;
+        juce::int64 locks = 0;
+        juce::int64 get_total() const { return allocations + deallocations + locks; }
+    };
+
+    //counts since the start, or since the last reset, over all threads
+    static Violations get_violations();
+    static void reset_violations();
+    //assert (jassert in debug builds, abort otherwise) on each violation, or only count them
+    static void set_asserts_on_violation(bool shouldAssert);
+    //whether allocations and locks are intercepted in this build
+    static bool is_active();
+
+    //marks the calling thread as a realtime thread while in scope, scopes can nest
+    class Scope{
+    public:
+        Scope();
+        ~Scope();
+    };
+};
+
+#if STEREOWIDENER_REALTIME_GUARD
+ #define REALTIME_GUARD_SCOPE RealtimeGuard::Scope realtimeGuardScope
+#else
+ #define REALTIME_GUARD_SCOPE
+#endif
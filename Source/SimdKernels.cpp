@@ -0,0 +1,181 @@
+/*
+  ==============================================================================
+
+    SimdKernels.cpp
+
+  ==============================================================================
+*/
+
+#include "SimdKernels.h"
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+
+//GCC fuses a multiply and an add into an FMA where the target has it (AVX-512),
+//even when they are separate intrinsics
+#if defined(__GNUC__) && ! defined(__clang__)
+ #pragma GCC optimize ("fp-contract=off")
+#endif
+
+//==============================================================================
+static void multiply_add_scalar(float* output, const float* input, float gain, int numSamples){
+    for (int i = 0; i < numSamples; i++)
+        output[i] += gain * input[i];
+}
+
+static void weighted_sum_scalar(float* output, const float* a, float gainA, const float* b, float gainB, int numSamples){
+    for (int i = 0; i < numSamples; i++)
+        output[i] = gainA * a[i] + gainB * b[i];
+}
+
+#if STEREOWIDENER_X86
+//==============================================================================
+STEREOWIDENER_TARGET("sse4.2")
+static void multiply_add_sse42(float* output, const float* input, float gain, int numSamples){
+    const __m128 g = _mm_set1_ps(gain);
+    int i = 0;
+    for (; i + 4 <= numSamples; i += 4)
+        _mm_storeu_ps(output + i, _mm_add_ps(_mm_loadu_ps(output + i), _mm_mul_ps(g, _mm_loadu_ps(input + i))));
+    multiply_add_scalar(output + i, input + i, gain, numSamples - i);
+}
+
+STEREOWIDENER_TARGET("sse4.2")
+static void weighted_sum_sse42(float* output, const float* a, float gainA, const float* b, float gainB, int numSamples){
+    const __m128 ga = _mm_set1_ps(gainA), gb = _mm_set1_ps(gainB);
+    int i = 0;
+    for (; i + 4 <= numSamples; i += 4)
+        _mm_storeu_ps(output + i, _mm_add_ps(_mm_mul_ps(ga, _mm_loadu_ps(a + i)), _mm_mul_ps(gb, _mm_loadu_ps(b + i))));
+    weighted_sum_scalar(output + i, a + i, gainA, b + i, gainB, numSamples - i);
+}
+
+//==============================================================================
+STEREOWIDENER_TARGET("avx2")
+static void multiply_add_avx2(float* output, const float* input, float gain, int numSamples){
+    const __m256 g = _mm256_set1_ps(gain);
+    int i = 0;
+    for (; i + 8 <= numSamples; i += 8)
+        _mm256_storeu_ps(output + i, _mm256_add_ps(_mm256_loadu_ps(output + i), _mm256_mul_ps(g, _mm256_loadu_ps(input + i))));
+    multiply_add_sse42(output + i, input + i, gain, numSamples - i);
+}
+
+STEREOWIDENER_TARGET("avx2")
+static void weighted_sum_avx2(float* output, const float* a, float gainA, const float* b, float gainB, int numSamples){
+    const __m256 ga = _mm256_set1_ps(gainA), gb = _mm256_set1_ps(gainB);
+    int i = 0;
+    for (; i + 8 <= numSamples; i += 8)
+        _mm256_storeu_ps(output + i, _mm256_add_ps(_mm256_mul_ps(ga, _mm256_loadu_ps(a + i)), _mm256_mul_ps(gb, _mm256_loadu_ps(b + i))));
+    weighted_sum_sse42(output + i, a + i, gainA, b + i, gainB, numSamples - i);
+}
+
+//==============================================================================
+STEREOWIDENER_TARGET("avx512f")
+static void multiply_add_avx512(float* output, const float* input, float gain, int numSamples){
+    const __m512 g = _mm512_set1_ps(gain);
+    int i = 0;
+    for (; i + 16 <= numSamples; i += 16)
+        _mm512_storeu_ps(output + i, _mm512_add_ps(_mm512_loadu_ps(output + i), _mm512_mul_ps(g, _mm512_loadu_ps(input + i))));
+    multiply_add_avx2(output + i, input + i, gain, numSamples - i);
+}
+
+STEREOWIDENER_TARGET("avx512f")
+static void weighted_sum_avx512(float* output, const float* a, float gainA, const float* b, float gainB, int numSamples){
+    const __m512 ga = _mm512_set1_ps(gainA), gb = _mm512_set1_ps(gainB);
+    int i = 0;
+    for (; i + 16 <= numSamples; i += 16)
+        _mm512_storeu_ps(output + i, _mm512_add_ps(_mm512_mul_ps(ga, _mm512_loadu_ps(a + i)), _mm512_mul_ps(gb, _mm512_loadu_ps(b + i))));
+    weighted_sum_avx2(output + i, a + i, gainA, b + i, gainB, numSamples - i);
+}
+#endif
+
+//==============================================================================
+SimdKernels::Tier SimdKernels::get_supported_tier(){
+   #if STEREOWIDENER_X86 && defined(_MSC_VER) && ! defined(__clang__)
+    //leaf 1 ECX: SSE4.2 (bit 20), OSXSAVE (bit 27). Leaf 7 EBX: AVX2 (bit 5), AVX-512F (bit 16).
+    //XCR0 tells whether the OS saves the YMM (bits 1, 2) and ZMM (bits 5 - 7) registers
+    int info[4];
+    __cpuid(info, 0);
+    const int maxLeaf = info[0];
+    __cpuid(info, 1);
+    if ((info[2] & (1 << 20)) == 0)
+        return scalarTier;
+    if (maxLeaf < 7 || (info[2] & (1 << 27)) == 0)
+        return sse42Tier;
+    const unsigned long long xcr0 = _xgetbv(0);
+    __cpuidex(info, 7, 0);
+    if ((info[1] & (1 << 16)) != 0 && (xcr0 & 0xe6) == 0xe6)
+        return avx512Tier;
+    if ((info[1] & (1 << 5)) != 0 && (xcr0 & 0x6) == 0x6)
+        return avx2Tier;
+    return sse42Tier;
+   #elif STEREOWIDENER_X86
+    //reads CPUID and checks that the OS saves the registers
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f"))
+        return avx512Tier;
+    if (__builtin_cpu_supports("avx2"))
+        return avx2Tier;
+    if (__builtin_cpu_supports("sse4.2"))
+        return sse42Tier;
+    return scalarTier;
+   #else
+    return scalarTier;
+   #endif
+}
+
+SimdKernels::Tier SimdKernels::get_requested_tier(){
+    const Tier supported = get_supported_tier();
+    const char* variable = std::getenv("STEREOWIDENER_SIMD_TIER");
+    std::string requested;
+    for (const char* c = variable; c != nullptr && *c != 0; c++)
+        if (! std::isspace((unsigned char) *c))
+            requested += (char) std::tolower((unsigned char) *c);
+    if (requested.empty())
+        return supported;
+    for (int tier = 0; tier < numTiers; tier++){
+        if (requested == get_tier_name((Tier) tier)){
+           #ifndef NDEBUG
+            if (tier > supported)
+                std::fprintf(stderr, "STEREOWIDENER_SIMD_TIER %s is not supported by this CPU, using %s\n",
+                             requested.c_str(), get_tier_name(supported));
+           #endif
+            return (Tier) std::min(tier, (int) supported);
+        }
+    }
+   #ifndef NDEBUG
+    std::fprintf(stderr, "Unknown STEREOWIDENER_SIMD_TIER %s, using %s\n", requested.c_str(), get_tier_name(supported));
+   #endif
+    return supported;
+}
+
+const SimdKernels& SimdKernels::get(Tier tier){
+   #if STEREOWIDENER_X86
+    static const SimdKernels tables[numTiers] = {
+        { multiply_add_scalar, weighted_sum_scalar, scalarTier },
+        { multiply_add_sse42, weighted_sum_sse42, sse42Tier },
+        { multiply_add_avx2, weighted_sum_avx2, avx2Tier },
+        { multiply_add_avx512, weighted_sum_avx512, avx512Tier },
+    };
+    return tables[std::clamp((int) tier, 0, (int) numTiers - 1)];
+   #else
+    (void) tier;
+    static const SimdKernels scalar { multiply_add_scalar, weighted_sum_scalar, scalarTier };
+    return scalar;
+   #endif
+}
+
+const char* SimdKernels::get_tier_name(Tier tier){
+    switch (tier){
+        case sse42Tier: return "sse4.2";
+        case avx2Tier: return "avx2";
+        case avx512Tier: return "avx512";
+        default: return "scalar";
+    }
+}
+
+int SimdKernels::get_lane_width(Tier tier){
+    switch (tier){
+        case avx2Tier: return 8;
+        case avx512Tier: return 16;
+        default: return 4;
+    }
+}
@@ -0,0 +1,99 @@
+/*
+  ==============================================================================
+
+    SimdKernels.h
+    Block kernels compiled for several x86 instruction set tiers in one
+    binary, and a table of them for each tier. The processor picks the table
+    in prepareToPlay from the CPU features (CPUID), or from the
+    STEREOWIDENER_SIMD_TIER environment variable (scalar, sse4.2, avx2 or
+    avx512) when it is set, for benchmarks and regression tests. A tier the
+    CPU does not support falls back to the best one it does. Other
+    architectures only have the scalar tier, which the compiler vectorises
+    for the baseline instruction set.
+
+    The kernels do not use FMA and keep the order of the operations, so
+    every tier gives the same output, bit for bit. Each tier also has a lane
+    width, the number of floats in one of its registers, for the kernels
+    that run independent signals side by side (see BatchWidener).
+
+  ==============================================================================
+*/
+
+#pragma once
+#include "DspCore.h"
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+ #define STEREOWIDENER_X86 1
+ #include <immintrin.h>
+ #if defined(_MSC_VER) && ! defined(__clang__)
+  #include <intrin.h>
+  //MSVC allows the intrinsics of any tier in any function
+  #define STEREOWIDENER_TARGET(isa)
+ #else
+  #define STEREOWIDENER_TARGET(isa) __attribute__((target(isa)))
+ #endif
+#else
+ #define STEREOWIDENER_X86 0
+#endif
+
+#if defined(_MSC_VER)
+ #define STEREOWIDENER_INLINE __forceinline
+#else
+ #define STEREOWIDENER_INLINE inline __attribute__((always_inline))
+#endif
+
+class SimdKernels{
+public:
+    enum Tier{
+        scalarTier = 0,
+        sse42Tier,
+        avx2Tier,
+        avx512Tier,
+        numTiers,
+    };
+
+    //output[i] += gain * input[i]
+    void (*multiply_add)(float* output, const float* input, float gain, int numSamples);
+    //output[i] = gainA * a[i] + gainB * b[i], output can be a or b
+    void (*weighted_sum)(float* output, const float* a, float gainA, const float* b, float gainB, int numSamples);
+    Tier tier;
+
+    //the best tier of this CPU
+    static Tier get_supported_tier();
+    //the supported tier, or the one in STEREOWIDENER_SIMD_TIER if the CPU has it
+    static Tier get_requested_tier();
+    static const SimdKernels& get(Tier tier);
+    static const char* get_tier_name(Tier tier);
+    //floats per register: 4 for scalar and SSE4.2, 8 for AVX2, 16 for AVX-512
+    static int get_lane_width(Tier tier);
+};
+
+//flushes denormals to zero in its scope, as juce::ScopedNoDenormals, for code
+//that runs outside the plugin
+class ScopedFlushToZero{
+public:
+    ScopedFlushToZero(){
+       #if STEREOWIDENER_X86
+        //flush to zero (bit 15) and denormals are zero (bit 6)
+        previous = _mm_getcsr();
+        _mm_setcsr(previous | 0x8040);
+       #elif defined(__aarch64__) && defined(__GNUC__)
+        //flush to zero (bit 24)
+        __asm__ __volatile__("mrs %0, fpcr" : "=r"(previous));
+        __asm__ __volatile__("msr fpcr, %0" : : "r"(previous | (1ull << 24)));
+       #endif
+    }
+    ~ScopedFlushToZero(){
+       #if STEREOWIDENER_X86
+        _mm_setcsr((unsigned int) previous);
+       #elif defined(__aarch64__) && defined(__GNUC__)
+        __asm__ __volatile__("msr fpcr, %0" : : "r"(previous));
+       #endif
+    }
+
+private:
+    unsigned long long previous = 0;
+
+    ScopedFlushToZero (const ScopedFlushToZero&) = delete;
+    ScopedFlushToZero& operator= (const ScopedFlushToZero&) = delete;
+};
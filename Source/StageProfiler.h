@@ -0,0 +1,159 @@
+/*
+  ==============================================================================
+
+    StageProfiler.h
+    Times the stages of processBlock on the audio thread and publishes the
+    DSP load of each stage (time spent / duration of the block) as min/avg/max
+    over a short window, for the editor to read without locks. The probes
+    compile out unless STEREOWIDENER_PROFILING is 1 (set in the Debug and
+    ReleaseProfiling configurations).
+
+  ==============================================================================
+*/
+
+#pragma once
+#include "JuceHeader.h"
+
+#ifndef STEREOWIDENER_PROFILING
+ #define STEREOWIDENER_PROFILING 0
+#endif
+
+class StageProfiler{
+public:
+    enum Stage{
+        decorrelation = 0,
+        filterbank,
+        panning,
+        transients,
+        stft,           //the STFT engine, instead of the three stages before transients
+        hrtf,           //the HRTF engine, as well
+        total,          //the whole processBlock
+        numStages,
+    };
+
+    struct Load{
+        float min = 0.0f, avg = 0.0f, max = 0.0f;   //fraction of the block duration
+    };
+
+    StageProfiler(){};
+    ~StageProfiler(){};
+
+    static const char* get_stage_name(int stage){
+        static const char* names[numStages] = {"Decorrelation", "Filterbank", "Panning", "Transients", "STFT", "HRTF", "Total"};
+        return names[stage];
+    }
+
+    void prepare(double sampleRate){
+        sample_rate = sampleRate;
+        ticks_per_second = (double) juce::Time::getHighResolutionTicksPerSecond();
+        reset_window();
+        for (int stage = 0; stage < numStages; stage++){
+            published[stage].min.store(0.0f, std::memory_order_relaxed);
+            published[stage].avg.store(0.0f, std::memory_order_relaxed);
+            published[stage].max.store(0.0f, std::memory_order_relaxed);
+        }
+    }
+
+    //audio thread: start and end of a block
+    inline void begin_block(int numSamples){
+        block_start = juce::Time::getHighResolutionTicks();
+        block_samples = numSamples;
+        block_ticks = ticks_per_second * numSamples / sample_rate;
+        for (int stage = 0; stage < numStages; stage++)
+            stage_ticks[stage] = 0;
+    }
+
+    void end_block(){
+        if (block_samples == 0)
+            return;
+        stage_ticks[total] = juce::Time::getHighResolutionTicks() - block_start;
+        for (int stage = 0; stage < numStages; stage++){
+            const float load = (float) (stage_ticks[stage] / block_ticks);
+            window[stage].min = juce::jmin(window[stage].min, load);
+            window[stage].max = juce::jmax(window[stage].max, load);
+            window[stage].sum += load;
+        }
+        window_samples += block_samples;
+        num_blocks++;
+
+        //the window results are stored with relaxed atomics, the audio thread
+        //is the only writer and the editor only reads them
+        if (window_samples >= window_ms * 1e-3 * sample_rate){
+            for (int stage = 0; stage < numStages; stage++){
+                published[stage].min.store(window[stage].min, std::memory_order_relaxed);
+                published[stage].avg.store(window[stage].sum / num_blocks, std::memory_order_relaxed);
+                published[stage].max.store(window[stage].max, std::memory_order_relaxed);
+            }
+            reset_window();
+        }
+    }
+
+    //audio thread: time spent in a stage, stages can be entered several times a block
+    inline void add_stage_ticks(Stage stage, juce::int64 ticks){
+        stage_ticks[stage] += ticks;
+    }
+
+    //any thread: load of a stage over the last window
+    Load get_load(int stage) const{
+        Load load;
+        load.min = published[stage].min.load(std::memory_order_relaxed);
+        load.avg = published[stage].avg.load(std::memory_order_relaxed);
+        load.max = published[stage].max.load(std::memory_order_relaxed);
+        return load;
+    }
+
+    class BlockScope{
+    public:
+        BlockScope(StageProfiler& p, int numSamples) : profiler(p){ profiler.begin_block(numSamples); }
+        ~BlockScope(){ profiler.end_block(); }
+    private:
+        StageProfiler& profiler;
+    };
+
+    class StageScope{
+    public:
+        StageScope(StageProfiler& p, Stage s) : profiler(p), stage(s), start(juce::Time::getHighResolutionTicks()){}
+        ~StageScope(){ profiler.add_stage_ticks(stage, juce::Time::getHighResolutionTicks() - start); }
+    private:
+        StageProfiler& profiler;
+        Stage stage;
+        juce::int64 start;
+    };
+
+private:
+    enum{
+        window_ms = 250,
+    };
+    struct WindowStats{
+        float min, max, sum;
+    };
+    struct PublishedLoad{
+        std::atomic<float> min { 0.0f }, avg { 0.0f }, max { 0.0f };
+    };
+
+    void reset_window(){
+        for (int stage = 0; stage < numStages; stage++)
+            window[stage] = { std::numeric_limits<float>::max(), 0.0f, 0.0f };
+        window_samples = 0;
+        num_blocks = 0;
+    }
+
+    double sample_rate = 44100.0;
+    double ticks_per_second = 1.0;
+    double block_ticks = 1.0;           //duration of the current block in ticks
+    int block_samples = 0;
+    juce::int64 block_start = 0;
+    juce::int64 stage_ticks[numStages] = {};
+    WindowStats window[numStages];
+    juce::int64 window_samples = 0;
+    int num_blocks = 0;
+    PublishedLoad published[numStages];
+};
+
+#if STEREOWIDENER_PROFILING
+ #define STAGE_PROFILER_BLOCK(profiler, numSamples) StageProfiler::BlockScope stageProfilerBlock (profiler, numSamples)
+ #define STAGE_PROFILER_SCOPE(profiler, stage) StageProfiler::StageScope stageProfilerScope (profiler, StageProfiler::stage)
+#else
+ #define STAGE_PROFILER_BLOCK(profiler, numSamples)
+ #define STAGE_PROFILER_SCOPE(profiler, stage)
+#endif
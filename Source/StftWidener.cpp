@@ -0,0 +1,194 @@
+/*
+  ==============================================================================
+
+    StftWidener.cpp
+
+  ==============================================================================
+*/
+
+#include "StftWidener.h"
+#include <random>
+
+StftWidener::StftWidener(){}
+StftWidener::~StftWidener(){}
+
+void StftWidener::prepare(int numChannels, double sampleRate){
+    num_channels = numChannels;
+    sample_rate = sampleRate;
+    frame_size = juce::nextPowerOfTwo((int) std::ceil(sampleRate * frameLengthMs * 0.001));
+    hop_size = frame_size / hopDivisor;
+    num_bins = frame_size / 2 + 1;
+    fft = std::make_unique<juce::dsp::FFT>(juce::findHighestSetBit((juce::uint32) frame_size));
+
+    //periodic Hann window, scaled so that the analysis and synthesis windows
+    //overlap-add to 1 (the squared Hann windows add to 1.5 at 75% overlap)
+    window.resize((size_t) frame_size);
+    const float scale = std::sqrt(2.0f / 3.0f);
+    for (int n = 0; n < frame_size; n++)
+        window[n] = scale * 0.5f * (1.0f - std::cos(2.0f * PI * n / frame_size));
+
+    fft_data.assign(2 * (size_t) frame_size, 0.0f);
+    lower_weights.assign((size_t) num_bins, 0.0f);
+    higher_weights.assign((size_t) num_bins, 0.0f);
+    dry_gains.assign((size_t) num_bins, 1.0f);
+    wet_gains.assign((size_t) num_bins, 0.0f);
+
+    phase_cos.assign(num_channels, std::vector<float>(num_bins, 1.0f));
+    phase_sin.assign(num_channels, std::vector<float>(num_bins, 0.0f));
+    bin_gains.assign(num_channels, std::vector<float>(2 * num_bins, 0.0f));
+    analysis.assign(num_channels, std::vector<float>(frame_size, 0.0f));
+    overlap_add.assign(num_channels, std::vector<float>(frame_size, 0.0f));
+    output_fifo.assign(num_channels, std::vector<float>(hop_size, 0.0f));
+    hop_position.assign(num_channels, 0);
+    for (int chan = 0; chan < num_channels; chan++)
+        initialise_phases(chan);
+
+    width_lower = width_higher = cutoff = -1.0f;
+    weights_changed = gains_changed = true;
+}
+
+void StftWidener::reset(){
+    for (int chan = 0; chan < num_channels; chan++){
+        std::fill(analysis[chan].begin(), analysis[chan].end(), 0.0f);
+        std::fill(overlap_add[chan].begin(), overlap_add[chan].end(), 0.0f);
+        std::fill(output_fifo[chan].begin(), output_fifo[chan].end(), 0.0f);
+        hop_position[chan] = 0;
+    }
+}
+
+void StftWidener::initialise_phases(int channel){
+    //random phases at points spaced by a fraction of an ERB, but at least a few
+    //bins apart, linearly interpolated in between. The phase changes by at most
+    //2 pi over minBinsPerPhasePoint bins, which bounds the group delay of the
+    //decorrelating filter and so the time aliasing of the circular convolution.
+    //DC and Nyquist are real bins and keep a phase of 0. The first outputs of
+    //std::default_random_engine are nearly the same for nearby seeds, so the
+    //channels would start with the same phases
+    std::mt19937 generator((unsigned int) channel + 1);
+    std::uniform_real_distribution<float> distribution(-PI, PI);
+    auto erb_number = [this] (int bin){
+        return 21.4 * std::log10(1.0 + 0.00437 * bin * sample_rate / frame_size);
+    };
+
+    std::vector<float>& cosines = phase_cos[channel];
+    std::vector<float>& sines = phase_sin[channel];
+    int start = 0;
+    float start_phase = 0.0f;
+    while (start < num_bins - 1){
+        int end = start + minBinsPerPhasePoint;
+        while (end < num_bins - 1 && erb_number(end) - erb_number(start) < 1.0 / phasePointsPerErb)
+            end++;
+        //the last segment is never shorter than the others
+        if (num_bins - 1 - end < minBinsPerPhasePoint)
+            end = num_bins - 1;
+        const float end_phase = (end == num_bins - 1) ? 0.0f : distribution(generator);
+        for (int k = start; k <= end; k++){
+            const float phase = start_phase + (end_phase - start_phase) * (k - start) / (end - start);
+            cosines[k] = std::cos(phase);
+            sines[k] = std::sin(phase);
+        }
+        start = end;
+        start_phase = end_phase;
+    }
+}
+
+void StftWidener::update_parameters(float widthLower, float widthHigher, float cutoffFrequency, bool isAmpPreserve){
+    if (cutoffFrequency != cutoff || isAmpPreserve != amp_preserve){
+        cutoff = cutoffFrequency;
+        amp_preserve = isAmpPreserve;
+        weights_changed = gains_changed = true;
+    }
+    if (widthLower != width_lower || widthHigher != width_higher){
+        width_lower = widthLower;
+        width_higher = widthHigher;
+        gains_changed = true;
+    }
+}
+
+void StftWidener::update_crossover_weights(){
+    //magnitude responses of the filterbank, without its phase. The Linkwitz-Riley
+    //bands add up in amplitude, the Butterworth bands in energy
+    for (int k = 0; k < num_bins; k++){
+        const double ratio = (k * sample_rate / frame_size) / cutoff;
+        if (amp_preserve){
+            lower_weights[k] = (float) (1.0 / (1.0 + std::pow(ratio, (double) lrOrder)));
+            higher_weights[k] = 1.0f - lower_weights[k];
+        }
+        else{
+            const double power = std::pow(ratio, 2.0 * butterworthOrder);
+            lower_weights[k] = (float) std::sqrt(1.0 / (1.0 + power));
+            higher_weights[k] = (float) std::sqrt(power / (1.0 + power));
+        }
+    }
+    weights_changed = false;
+}
+
+void StftWidener::update_gains(){
+    if (weights_changed)
+        update_crossover_weights();
+
+    //panner gains of each band, as in Panner
+    const float angle_lower = juce::jmap(width_lower, 0.f, 1.0f, 0.f, PI/2.0f);
+    const float angle_higher = juce::jmap(width_higher, 0.f, 1.0f, 0.f, PI/2.0f);
+    for (int k = 0; k < num_bins; k++){
+        dry_gains[k] = lower_weights[k] * std::cos(angle_lower) + higher_weights[k] * std::cos(angle_higher);
+        wet_gains[k] = lower_weights[k] * std::sin(angle_lower) + higher_weights[k] * std::sin(angle_higher);
+    }
+
+    //dry + wet * exp(j phase)
+    for (int chan = 0; chan < num_channels; chan++){
+        float* gains = bin_gains[chan].data();
+        const float* cosines = phase_cos[chan].data();
+        const float* sines = phase_sin[chan].data();
+        for (int k = 0; k < num_bins; k++){
+            gains[2 * k] = dry_gains[k] + wet_gains[k] * cosines[k];
+            gains[2 * k + 1] = wet_gains[k] * sines[k];
+        }
+    }
+    gains_changed = false;
+}
+
+void StftWidener::process(int channel, const float* input, float* output, int numSamples){
+    jassert(channel < num_channels);
+    if (gains_changed)
+        update_gains();
+
+    float* frame = analysis[channel].data();
+    const float* fifo = output_fifo[channel].data();
+    int position = hop_position[channel];
+    for (int i = 0; i < numSamples; i++){
+        const float x = input[i];
+        output[i] = fifo[position];
+        frame[frame_size - hop_size + position] = x;
+        if (++position == hop_size){
+            process_frame(channel);
+            position = 0;
+        }
+    }
+    hop_position[channel] = position;
+}
+
+void StftWidener::process_frame(int channel){
+    float* frame = analysis[channel].data();
+    float* data = fft_data.data();
+    juce::FloatVectorOperations::multiply(data, frame, window.data(), frame_size);
+    std::memmove(frame, frame + hop_size, sizeof(float) * (size_t) (frame_size - hop_size));
+
+    //bins 0 to frame_size / 2, interleaved re/im
+    fft->performRealOnlyForwardTransform(data, true);
+    const float* gains = bin_gains[channel].data();
+    for (int k = 0; k < num_bins; k++){
+        const float re = data[2 * k], im = data[2 * k + 1];
+        data[2 * k] = re * gains[2 * k] - im * gains[2 * k + 1];
+        data[2 * k + 1] = re * gains[2 * k + 1] + im * gains[2 * k];
+    }
+    //the inverse transform is scaled by 1 / frame_size
+    fft->performRealOnlyInverseTransform(data);
+
+    //the first hop of the overlap-add buffer is complete
+    float* accumulator = overlap_add[channel].data();
+    juce::FloatVectorOperations::addWithMultiply(accumulator, data, window.data(), frame_size);
+    juce::FloatVectorOperations::copy(output_fifo[channel].data(), accumulator, hop_size);
+    std::memmove(accumulator, accumulator + hop_size, sizeof(float) * (size_t) (frame_size - hop_size));
+    juce::FloatVectorOperations::clear(accumulator + frame_size - hop_size, hop_size);
+}
@@ -0,0 +1,81 @@
+/*
+  ==============================================================================
+
+    StftWidener.h
+    Decorrelation and frequency dependent width in the STFT domain, as an
+    alternative to the time domain decorrelators and filterbank. Each
+    channel's decorrelated spectrum is its own spectrum with a fixed random
+    phase per bin, where the phase is interpolated between random values
+    about one ERB apart so that the decorrelating filter stays short. The
+    panner gains of the two bands are applied per bin, weighted by the
+    magnitude responses of the crossover filters. Dry and decorrelated
+    spectra then combine into one complex gain per bin, so a channel costs
+    one forward and one inverse real FFT per hop, whatever the widths.
+    Frames are Hann windowed on analysis and synthesis with 75% overlap.
+    The FFT is juce::dsp::FFT, which is scalar unless JUCE has vDSP, IPP or
+    FFTW. The class takes any channel count, the plugin gives it one or two.
+
+  ==============================================================================
+*/
+
+#pragma once
+#include "JuceHeader.h"
+
+class StftWidener{
+public:
+    StftWidener();
+    ~StftWidener();
+
+    void prepare(int numChannels, double sampleRate);
+    void reset();
+    //delay from input to output in samples
+    int get_latency() const { return frame_size; }
+    int get_frame_size() const { return frame_size; }
+    //the output is periodic in the hop, counted from prepare or reset
+    int get_hop_size() const { return hop_size; }
+
+    //widths between 0 and 1, the crossover as in the time domain filterbank.
+    //The gains are recalculated on the next frame when any of these change
+    void update_parameters(float widthLower, float widthHigher, float cutoffFrequency, bool isAmpPreserve);
+    //input and output can be the same buffer
+    void process(int channel, const float* input, float* output, int numSamples);
+
+private:
+    void process_frame(int channel);
+    void update_gains();
+    void initialise_phases(int channel);
+    void update_crossover_weights();
+
+    enum{
+        frameLengthMs = 20,                     //rounded up to a power of 2
+        hopDivisor = 4,
+        phasePointsPerErb = 2,
+        minBinsPerPhasePoint = 4,               //limits the group delay to a quarter of a frame
+        lrOrder = 4,                            //Linkwitz-Riley crossover, see LinkwitzCrossover
+        butterworthOrder = 8,                   //see ButterworthFilter
+    };
+    const float PI = std::acos(-1);
+
+    std::unique_ptr<juce::dsp::FFT> fft;
+    int num_channels = 0;
+    int frame_size = 0;
+    int hop_size = 0;
+    int num_bins = 0;
+    double sample_rate = 44100.0;
+    std::vector<float> window;
+    std::vector<float> fft_data;                //2 * frame_size, shared by all channels
+    std::vector<float> lower_weights, higher_weights;   //crossover magnitude at each bin
+    std::vector<float> dry_gains, wet_gains;    //per bin, shared by all channels
+
+    //per channel
+    std::vector<std::vector<float>> phase_cos, phase_sin;
+    std::vector<std::vector<float>> bin_gains;  //complex gain per bin, interleaved re/im
+    std::vector<std::vector<float>> analysis;   //the last frame_size input samples
+    std::vector<std::vector<float>> overlap_add;
+    std::vector<std::vector<float>> output_fifo;
+    std::vector<int> hop_position;
+
+    float width_lower = -1.0f, width_higher = -1.0f, cutoff = -1.0f;
+    bool amp_preserve = false;
+    bool weights_changed = true, gains_changed = true;
+};
@@ -0,0 +1,135 @@
+/*
+  ==============================================================================
+
+    TraceRecorder.cpp
+
+  ==============================================================================
+*/
+
+#include "TraceRecorder.h"
+
+#if STEREOWIDENER_TRACING
+
+static std::atomic<int> next_generation { 0 };
+
+TraceRecorder::TraceRecorder() : juce::Thread("StereoWidener trace"), generation(next_generation++){
+    ticks_to_us = 1e6 / (double) juce::Time::getHighResolutionTicksPerSecond();
+
+    const juce::String path = juce::SystemStats::getEnvironmentVariable("STEREOWIDENER_TRACE_FILE", {});
+    const juce::File file = juce::File::isAbsolutePath(path) ? juce::File(path)
+                            : juce::File::getSpecialLocation(juce::File::tempDirectory)
+                                  .getChildFile("StereoWidener_" + juce::Time::getCurrentTime().formatted("%Y%m%d_%H%M%S") + ".json");
+    file.deleteFile();
+    stream = std::make_unique<juce::FileOutputStream>(file);
+    if (stream->failedToOpen())
+        stream.reset();
+    else{
+        *stream << "[\n";
+        DBG("StereoWidener trace: " + file.getFullPathName());
+    }
+    startThread();
+}
+
+TraceRecorder::~TraceRecorder(){
+    stopThread(1000);
+    flush();
+    if (stream != nullptr){
+        if (num_dropped > 0)
+            *stream << (first_event ? "" : ",\n") << "{\"name\":\"dropped events\",\"ph\":\"i\",\"s\":\"g\",\"ts\":0,\"pid\":1,\"tid\":0,"
+                    << "\"args\":{\"count\":" << juce::String(num_dropped.load()) << "}}";
+        *stream << "\n]\n";
+        stream->flush();
+    }
+}
+
+int TraceRecorder::register_instance(){
+    //the rings are allocated here, so that no audio thread allocates
+    const int instance = ++num_instances;
+    if (stream != nullptr){
+        const int numRings = juce::jmin((int) max_threads, instance * (int) rings_per_instance);
+        for (int i = num_rings; i < numRings; i++)
+            rings[i] = std::make_unique<ThreadRing>();
+        num_rings = juce::jmax(num_rings.load(), numRings);
+    }
+    return instance;
+}
+
+void TraceRecorder::begin(int instance, const char* name){
+    push(instance, name, 'B', 0.0f);
+}
+
+void TraceRecorder::end(int instance, const char* name){
+    push(instance, name, 'E', 0.0f);
+}
+
+void TraceRecorder::instant(int instance, const char* name, float value){
+    push(instance, name, 'i', value);
+}
+
+TraceRecorder::ThreadRing* TraceRecorder::get_thread_ring(){
+    //each thread claims a ring the first time it records an event. Its events are
+    //dropped while there are fewer rings than threads
+    thread_local int owner_generation = -1;
+    thread_local int index = -1;
+    if (owner_generation != generation){
+        owner_generation = generation;
+        index = num_threads.fetch_add(1);
+    }
+    return (index < num_rings.load()) ? rings[index].get() : nullptr;
+}
+
+void TraceRecorder::push(int instance, const char* name, char phase, float value){
+    const juce::int64 ticks = juce::Time::getHighResolutionTicks();
+    ThreadRing* ring = get_thread_ring();
+    if (ring == nullptr || ring->fifo.getFreeSpace() == 0){
+        num_dropped++;
+        return;
+    }
+    const auto scope = ring->fifo.write(1);
+    ring->events[(size_t) scope.startIndex1] = { ticks, name, value, instance, phase };
+}
+
+void TraceRecorder::run(){
+    while (! threadShouldExit()){
+        wait(flush_interval_ms);
+        flush();
+    }
+}
+
+void TraceRecorder::flush(){
+    if (stream == nullptr)
+        return;
+    const int numThreads = juce::jmin(num_threads.load(), num_rings.load());
+    for (int tid = 0; tid < numThreads; tid++){
+        ThreadRing& ring = *rings[tid];
+        const int numReady = ring.fifo.getNumReady();
+        if (numReady == 0)
+            continue;
+
+        if (! ring.named){
+            *stream << (first_event ? "" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << tid
+                    << ",\"args\":{\"name\":\"thread " << tid << "\"}}";
+            first_event = false;
+            ring.named = true;
+        }
+
+        const auto scope = ring.fifo.read(numReady);
+        auto writeEvents = [&] (int start, int size){
+            for (int i = start; i < start + size; i++){
+                const Event& event = ring.events[(size_t) i];
+                *stream << (first_event ? "" : ",\n") << "{\"name\":\"" << event.name << "\",\"ph\":\"" << juce::String::charToString(event.phase)
+                        << "\",\"ts\":" << juce::String(event.ticks * ticks_to_us, 3) << ",\"pid\":1,\"tid\":" << tid;
+                if (event.phase == 'i')
+                    *stream << ",\"s\":\"t\",\"args\":{\"instance\":" << event.instance << ",\"value\":" << juce::String(event.value) << "}}";
+                else
+                    *stream << ",\"args\":{\"instance\":" << event.instance << "}}";
+                first_event = false;
+            }
+        };
+        writeEvents(scope.startIndex1, scope.blockSize1);
+        writeEvents(scope.startIndex2, scope.blockSize2);
+    }
+    stream->flush();
+}
+
+#endif
@@ -0,0 +1,97 @@
+/*
+  ==============================================================================
+
+    TraceRecorder.h
+    Records timestamped begin/end and instant events from the audio threads
+    of all plugin instances and writes them as a Chrome trace (JSON array
+    format) that opens in Perfetto or chrome://tracing. Each thread writes to
+    its own lock-free ring, and a background thread flushes the rings to the
+    file. The rings are allocated as instances register, a few per instance,
+    and only if the file could be opened. Compiled in when STEREOWIDENER_TRACING is 1; the file
+    is STEREOWIDENER_TRACE_FILE, or StereoWidener_<time>.json in the temp
+    directory. All instances share one recorder through a
+    SharedResourcePointer, so their events end up in the same file.
+
+  ==============================================================================
+*/
+
+#pragma once
+#include "JuceHeader.h"
+
+#ifndef STEREOWIDENER_TRACING
+ #define STEREOWIDENER_TRACING 0
+#endif
+
+class TraceRecorder : private juce::Thread{
+public:
+    TraceRecorder();
+    ~TraceRecorder() override;
+
+    //message thread: a number that identifies an instance in the trace
+    int register_instance();
+
+    //audio thread: names must be string literals, they are written out later.
+    //Events are dropped when the thread's ring is full
+    void begin(int instance, const char* name);
+    void end(int instance, const char* name);
+    void instant(int instance, const char* name, float value);
+
+    class Scope{
+    public:
+        Scope(TraceRecorder& r, int i, const char* n) : recorder(r), instance(i), name(n){ recorder.begin(instance, name); }
+        ~Scope(){ recorder.end(instance, name); }
+    private:
+        TraceRecorder& recorder;
+        int instance;
+        const char* name;
+    };
+
+private:
+    struct Event{
+        juce::int64 ticks;
+        const char* name;
+        float value;
+        int instance;
+        char phase;                         //'B'egin, 'E'nd or 'i'nstant
+    };
+    //single producer (the thread it belongs to), single consumer (the flush thread)
+    struct ThreadRing{
+        ThreadRing() : fifo(ring_size), events(ring_size){}
+        juce::AbstractFifo fifo;
+        std::vector<Event> events;
+        bool named = false;                 //thread name written to the file
+    };
+    enum{
+        max_threads = 64,
+        rings_per_instance = 4,             //audio threads an instance is expected to run on
+        ring_size = 1 << 14,
+        flush_interval_ms = 100,
+    };
+
+    void push(int instance, const char* name, char phase, float value);
+    ThreadRing* get_thread_ring();
+    void run() override;
+    void flush();
+
+    std::unique_ptr<juce::FileOutputStream> stream;
+    std::unique_ptr<ThreadRing> rings[max_threads];
+    std::atomic<int> num_rings { 0 };       //allocated, rings[0 ... num_rings - 1]
+    std::atomic<int> num_threads { 0 };     //threads that claimed a ring, or tried to
+    //threads remember the ring they claimed by this number, not by the address of the
+    //recorder, which a new recorder can have once this one is deleted
+    const int generation;
+    std::atomic<int> num_instances { 0 };
+    std::atomic<juce::int64> num_dropped { 0 };
+    double ticks_to_us;
+    bool first_event = true;
+
+    JUCE_DECLARE_NON_COPYABLE (TraceRecorder)
+};
+
+#if STEREOWIDENER_TRACING
+ #define TRACE_SCOPE(recorder, instance, name) TraceRecorder::Scope traceScope (recorder, instance, name)
+ #define TRACE_INSTANT(recorder, instance, name, value) (recorder).instant(instance, name, value)
+#else
+ #define TRACE_SCOPE(recorder, instance, name)
+ #define TRACE_INSTANT(recorder, instance, name, value)
+#endif
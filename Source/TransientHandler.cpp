@@ -14,23 +14,25 @@ TransientHandler::TransientHandler(){}
 TransientHandler::~TransientHandler(){
     delete [] xfade_in_win;
     delete [] xfade_out_win;
-    delete [] xfade_buffer;
+    delete [] dry_gain;
     delete [] output_buffer;
 }
 
 
 void TransientHandler::prepare_xfade_windows(){
-    xfade_in_win = new float[buffer_size];
-    xfade_out_win = new float[buffer_size];
-    xfade_buffer = new float[buffer_size];
+    xfade_in_win = new float[xfade_samps];
+    xfade_out_win = new float[xfade_samps];
+    dry_gain = new float[buffer_size];
     output_buffer = new float[buffer_size];
     
-    for(int i = 0; i < buffer_size; i++){
+    for(int i = 0; i < xfade_samps; i++){
         //half hann windows
-        float phase = static_cast<float>(i) / (buffer_size - 1);
+        float phase = static_cast<float>(i) / (xfade_samps - 1);
         xfade_in_win[i] = 0.5f * (1.0f - std::cos(PI * phase));
         xfade_out_win[i] = 1.0f - xfade_in_win[i];
-        xfade_buffer[i] = 0.0f;
+    }
+    for(int i = 0; i < buffer_size; i++){
+        dry_gain[i] = 0.0f;
         output_buffer[i] = 0.0f;
     }
 }
@@ -38,74 +40,160 @@ void TransientHandler::prepare_xfade_windows(){
 void TransientHandler::prepare(int bufferSize, float sampleRate){
     buffer_size = bufferSize;
     sample_rate = sampleRate;
-    hold_counter = 0;
-    inhibit_counter = 0;
-    min_frames_hold = ms_to_frames(min_ms_hold);
-    min_frames_inhibit = ms_to_frames(min_ms_inhibit);
-    //std::cout << min_frames_hold << ", " << min_frames_inhibit << std::endl;
+    state = widened;
+    state_counter = 0;
+    xfade_samps = std::max(2, ms_to_samps(xfade_ms));
+    lookahead_samps = 0;
+    min_samps_hold = std::max(xfade_samps, ms_to_samps(min_ms_hold));
+    min_samps_inhibit = std::max(xfade_samps, ms_to_samps(min_ms_inhibit));
     onset.prepare(buffer_size, sample_rate);
     this->prepare_xfade_windows();
 }
 
 
-float* TransientHandler::copy_buffer(float* input, float *output){
-    for(int i = 0;i < buffer_size;i++)
-        output[i] = input[i];
-    return output;
+void TransientHandler::set_lookahead(int lookahead_samples){
+    jassert(lookahead_samples >= 0);
+    min_samps_hold += lookahead_samples - lookahead_samps;
+    lookahead_samps = lookahead_samples;
 }
 
-void TransientHandler::apply_xfade(float* input1, float* input2){
-    //cross-fades between two inputs by applying a fade-in to input1
-    //and fade-out to input2.
-    for(int i = 0; i < buffer_size; i++)
-        xfade_buffer[i] = xfade_in_win[i] * input1[i] + xfade_out_win[i]*input2[i];
+
+float* TransientHandler::process(float* input_buffer, float* widener_output_buffer, int num_samples){
+    return this->process(input_buffer, input_buffer, widener_output_buffer, num_samples);
 }
 
 
-float* TransientHandler::process(float* input_buffer, float* widener_output_buffer){
+float* TransientHandler::process(float* detector_buffer, float* input_buffer, float* widener_output_buffer, int num_samples){
     //cross-fade between the input buffer and stereo widener's output buffer
     //when a transient is detected.
-    //Also keep tabs on when the onset and offset flags can change with the
-    //hold and inhibit counter
-    onset.process(input_buffer);
-    bool cur_onset_flag = onset.onset_flag;
+    //The detector buffer may run ahead of the input and widener output
+    //(lookahead), so that the cross-fade is done before the transient arrives
+    this->detect(detector_buffer, num_samples);
+    return this->apply(input_buffer, widener_output_buffer, num_samples);
+}
+
 
+void TransientHandler::detect(const float* detector_buffer, int num_samples){
+    //The onset detector reports the sample index of each onset, and the hold,
+    //inhibit and cross-fade times are counted in samples. The resulting gain
+    //of the input signal is stored for every sample in the buffer
+    jassert(num_samples <= buffer_size);
+    onset.process(detector_buffer, num_samples);
+    int next_onset = 0;
     
-    if (0 < hold_counter && hold_counter < min_frames_hold){
-        output_buffer = this->copy_buffer(input_buffer, output_buffer);
-        hold_counter++;
+    for (int i = 0; i < num_samples; i++){
+        bool is_onset = false;
+        if (state == widened){
+            //skip onsets that arrived while we were not listening
+            while (next_onset < onset.num_onsets && onset.onset_indices[next_onset] < i)
+                next_onset++;
+            is_onset = (next_onset < onset.num_onsets && onset.onset_indices[next_onset] == i);
+        }
+        dry_gain[i] = next_gain(state, state_counter, is_onset);
     }
+}
+
+
+inline float TransientHandler::next_gain(State& current_state, int& counter, bool is_onset){
+    float gain = 0.0f;
     
-    else if (0 < inhibit_counter && inhibit_counter < min_frames_inhibit){
-        output_buffer = this->copy_buffer(widener_output_buffer, output_buffer);
-        inhibit_counter++;
+    switch (current_state){
+        case widened:
+            if (is_onset){
+                //onset fade-in
+                current_state = dry;
+                counter = 0;
+                gain = xfade_in_win[0];
+            }
+            break;
+            
+        case dry:
+            if (counter < xfade_samps)
+                gain = xfade_in_win[counter];
+            else if (counter < min_samps_hold)
+                gain = 1.0f;
+            else{
+                //switch from input to widener output after holding
+                current_state = inhibit;
+                counter = 0;
+                gain = xfade_out_win[0];
+            }
+            break;
+            
+        case inhibit:
+            if (counter < xfade_samps)
+                gain = xfade_out_win[counter];
+            else if (counter >= min_samps_inhibit)
+                current_state = widened;
+            break;
     }
+    //the counter is only read while fading or holding, in the widened state
+    //it would overflow after a few hours
+    if (current_state != widened)
+        counter++;
+    return gain;
+}
+
+
+std::vector<float> TransientHandler::get_gain_table(){
+    //runs the state machine from an onset until it is back in the widened state
+    State table_state = widened;
+    int counter = 0;
+    std::vector<float> gains { next_gain(table_state, counter, true) };
+    while (table_state != widened)
+        gains.push_back(next_gain(table_state, counter, false));
+    gains.push_back(next_gain(table_state, counter, false));
+    return gains;
+}
+
+
+void TransientHandler::set_onset_map(const std::vector<long long>& onset_positions){
+    //keep only the onsets the state machine in detect() would react to: an onset
+    //is ignored until the hold and inhibit times of the previous one are over
+    onset_map.clear();
+    next_mapped_onset = 0;
+    for (auto position : onset_positions)
+        if (onset_map.empty() || position > onset_map.back() + min_samps_hold + min_samps_inhibit)
+            onset_map.push_back(position);
+}
+
+
+void TransientHandler::detect_from_map(long long position, int num_samples){
+    //same gains as detect(), but each cross-fade starts xfade_samps before its onset.
+    //The onsets are at least hold + inhibit samples apart, so cross-fades never overlap
+    jassert(num_samples <= buffer_size);
+    if (next_mapped_onset > 0 && onset_map[next_mapped_onset - 1] - xfade_samps > position)
+        next_mapped_onset = 0;      //rendering went back in time
     
-    else{
-        if (cur_onset_flag){
-            //onset fade-in
-            this->apply_xfade(input_buffer, widener_output_buffer);
-            output_buffer = this->copy_buffer(xfade_buffer, output_buffer);
-            inhibit_counter = 0;
-            hold_counter = 1;
-            //std::cout << "Onset detected" << std::endl;
-        }
-        else if((prev_onset_flag && onset.offset_flag) || hold_counter == min_frames_hold){
-            //offset fade-out, or switch from input to widener output after holding
-            this->apply_xfade(widener_output_buffer, input_buffer);
-            output_buffer = this->copy_buffer(xfade_buffer, output_buffer);
-            hold_counter = 0;
-            inhibit_counter = 1;
-            //std::cout << "Offset detected" << std::endl;
-        }
-        else{
-            //otherwise
-            output_buffer = this->copy_buffer(widener_output_buffer, output_buffer);
-            hold_counter = 0;
-            inhibit_counter = 0;
+    for (int i = 0; i < num_samples; i++){
+        const long long sample = position + i;
+        while (next_mapped_onset < onset_map.size() && onset_map[next_mapped_onset] - xfade_samps <= sample)
+            next_mapped_onset++;
+        
+        float gain = 0.0f;
+        if (next_mapped_onset > 0){
+            //samples since the start of the last cross-fade
+            const long long n = sample - (onset_map[next_mapped_onset - 1] - xfade_samps);
+            if (n < xfade_samps)
+                gain = xfade_in_win[n];
+            else if (n < min_samps_hold)
+                gain = 1.0f;
+            else if (n < min_samps_hold + xfade_samps)
+                gain = xfade_out_win[n - min_samps_hold];
         }
+        dry_gain[i] = gain;
     }
-    prev_onset_flag = cur_onset_flag;
+}
+
+
+float* TransientHandler::apply(const float* input_buffer, const float* widener_output_buffer, int num_samples){
+    //cross-fade with the gains calculated by the last call to detect()
+    crossfade(dry_gain, input_buffer, widener_output_buffer, output_buffer, num_samples);
     return output_buffer;
+}
 
+void TransientHandler::crossfade(const float* dry_gains, const float* input_buffer, const float* widener_output_buffer,
+                                 float* output, int num_samples){
+    for (int i = 0; i < num_samples; i++)
+        output[i] = dry_gains[i] * input_buffer[i] + (1.0f - dry_gains[i]) * widener_output_buffer[i];
 }
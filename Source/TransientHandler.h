@@ -9,7 +9,7 @@
 */
 
 #pragma once
-#include "JuceHeader.h"
+#include "DspCore.h"
 #include "OnsetDetector.h"
 
 class TransientHandler{
@@ -17,37 +17,71 @@ public:
     TransientHandler();
     ~TransientHandler();
     
-    inline int ms_to_frames(float time_ms){
-        return int(std::ceil(time_ms * 1e-3 * sample_rate / buffer_size));
+    inline int ms_to_samps(float time_ms){
+        return int(std::ceil(time_ms * 1e-3 * sample_rate));
     }
     void prepare_xfade_windows();
     void prepare(int bufferSize, float sampleRate);
-    void apply_xfade(float* input1, float* input2);
-    float* copy_buffer(float* input, float* output);
-    float* process(float* input_buffer, float* widener_output_buffer);
+    float* process(float* input_buffer, float* widener_output_buffer, int num_samples);
+    float* process(float* detector_buffer, float* input_buffer, float* widener_output_buffer, int num_samples);
+    //detection and cross-fading can also be called separately, so that a single
+    //detection can drive the cross-fades of several channels
+    void detect(const float* detector_buffer, int num_samples);
+    float* apply(const float* input_buffer, const float* widener_output_buffer, int num_samples);
+    //the gains of the input found by the last detection, and the cross-fade apply() does with them
+    const float* get_dry_gains() const { return dry_gain; }
+    static void crossfade(const float* dry_gains, const float* input_buffer, const float* widener_output_buffer,
+                          float* output, int num_samples);
+    OnsetDetector& get_onset_detector() { return onset; }
+    //the gains of the input detect() gives from an onset on: the fade in, the hold,
+    //the fade out and the inhibit time. The last two entries are the first sample
+    //of the widened state and the widened state, where onsets are detected again
+    std::vector<float> get_gain_table();
+    //offline rendering can find the onsets of the whole file in advance. The onsets in
+    //the map (sample positions from the start of the file, sorted) replace the onset
+    //detector, and the cross-fade to the input ends at the onset instead of starting there
+    void set_onset_map(const std::vector<long long>& onset_positions);
+    void clear_onset_map() { onset_map.clear(); }
+    void detect_from_map(long long position, int num_samples);
+    //the detector runs this many samples ahead of the audio path. The input is
+    //held for that much longer, so that the transient is still dry when it
+    //comes out of the lookahead delay
+    void set_lookahead(int lookahead_samples);
 
 private:
     const float PI = std::acos(-1);
-    int buffer_size;
+    int buffer_size;        //maximum buffer size
     float sample_rate;
     //cross-fading parameters when onset is detected
     float* xfade_in_win;
     float* xfade_out_win;
-    float* xfade_buffer;
+    float* dry_gain;        //gain of the input signal for each sample in the buffer
     float* output_buffer;
     
-    bool prev_onset_flag = false;   //was there an onset previously?
     //onset detector object
     OnsetDetector onset;
-    //
-    int hold_counter;       //if an onset is detected, the flag will be true for a
-                            //minimum number of frames to prevent false offset detection
-    int min_frames_hold;
-    int inhibit_counter;    // if an offset is detected, we will wait a
-                            // minimum number of frames to prevent false onset detection
-    int min_frames_inhibit;
-    //calculated with a buffer size of 256 samples
+    
+    //the handler is a state machine that runs sample by sample, so its
+    //behaviour does not depend on the buffer size
+    enum State{
+        widened,            //widener output, onsets are detected
+        dry,                //fade to the input and hold it for a minimum time to
+                            //prevent false offset detection
+        inhibit,            //fade back to the widener output and wait a minimum time
+                            //to prevent false onset detection
+    };
+    State state = widened;
+    //one sample of the state machine, returns the gain of the input
+    inline float next_gain(State& current_state, int& counter, bool is_onset);
+    std::vector<long long> onset_map;     //onsets that start a cross-fade, see set_onset_map
+    size_t next_mapped_onset = 0;
+    int state_counter = 0;  //number of samples spent in the current state
+    int xfade_samps;
+    int min_samps_hold;     //includes the lookahead
+    int lookahead_samps = 0;
+    int min_samps_inhibit;
     enum{
+        xfade_ms = 5,
         min_ms_hold = 80,
         min_ms_inhibit = 50,
     };
@@ -9,6 +9,8 @@
 */
 
 #include "VelvetNoise.h"
+#include <locale>
+#include <sstream>
 
 VelvetNoise::VelvetNoise(){};
 VelvetNoise::~VelvetNoise(){
@@ -16,21 +18,32 @@ VelvetNoise::~VelvetNoise(){
     delete [] impulseValues;
 }
 
-void VelvetNoise::initialize_from_string(juce::String opt_vn_filter){
+void VelvetNoise::initialize_from_string(const std::string& opt_vn_filter){
     //since we don't know the size of these, we make them vectors
     std::vector<int> tempImpulsePositions;
     std::vector<float> tempImpulseValues;
-    std::string nextNumber;
     
-    //separate all characters in string by space
-    juce::StringArray tokens;
-    tokens.addTokens (opt_vn_filter, " ");
+    //separate all characters in string by whitespace. Every separator ends a
+    //token, so that the index of a token is the sample it is at, as it was with
+    //juce::StringArray::addTokens. Numbers are read in the C locale
+    std::vector<std::string> tokens(1);
+    for (const char c : opt_vn_filter){
+        if (c == ' ' || c == '\n' || c == '\r' || c == '\t')
+            tokens.emplace_back();
+        else
+            tokens.back() += c;
+    }
 
-    for (int i=0; i<tokens.size(); i++)
+    for (int i=0; i<(int) tokens.size(); i++)
     {
-        if (tokens[i].getFloatValue() != 0.0f){
+        std::istringstream stream(tokens[i]);
+        stream.imbue(std::locale::classic());
+        double value = 0.0;
+        if (! (stream >> value))
+            value = 0.0;
+        if ((float) value != 0.0f){
             tempImpulsePositions.push_back(i);
-            tempImpulseValues.push_back(tokens[i].getFloatValue());
+            tempImpulseValues.push_back((float) value);
         }
     }
     
@@ -44,7 +57,11 @@ void VelvetNoise::initialize_from_string(juce::String opt_vn_filter){
         impulseValues[k] = tempImpulseValues.at(k);
         //std::cout << impulsePositions[k] <<", " << impulseValues[k] << std::endl;
     }
-    
+    //the impulse positions are the delays. The delay line was never prepared
+    //here, its length and contents were undefined
+    length = 0;
+    delayLine.prepare(length, 0.0f);
+    prepare_block_history();
 }
 
 void VelvetNoise::initialize(float SR, float L, int gS, float targetDecaydB, bool logDistribution){
@@ -93,7 +110,7 @@ void VelvetNoise::setImpulseLocationValues(){
         //std :: cout << "Impulse location " << impulsePositions[i] << std::endl;
         //std :: cout << "Impulse gain " << impulseValues[i] << std::endl;
     }
-    
+    prepare_block_history();
 }
 
 void VelvetNoise::update(int newGridSize){
@@ -109,6 +126,77 @@ float VelvetNoise::process(const float input){
     return output;
 }
 
+void VelvetNoise::split_taps_for_stereo(){
+    //greedy split: the largest impulses first, each to the group with less energy
+    std::vector<int> order (seqLength);
+    for (int i = 0; i < seqLength; i++)
+        order[i] = i;
+    std::sort(order.begin(), order.end(), [this] (int a, int b){
+        return std::abs(impulseValues[a]) > std::abs(impulseValues[b]);
+    });
+    std::vector<int> first, second;
+    float firstEnergy = 0.0f, secondEnergy = 0.0f;
+    for (int i : order){
+        const float energy = impulseValues[i] * impulseValues[i];
+        if (firstEnergy <= secondEnergy){
+            first.push_back(i);
+            firstEnergy += energy;
+        }
+        else{
+            second.push_back(i);
+            secondEnergy += energy;
+        }
+    }
+    
+    //reorder the impulses, first group first
+    std::vector<int> positions (impulsePositions, impulsePositions + seqLength);
+    std::vector<float> values (impulseValues, impulseValues + seqLength);
+    int k = 0;
+    for (int i : first){
+        impulsePositions[k] = positions[i];
+        impulseValues[k++] = values[i];
+    }
+    for (int i : second){
+        impulsePositions[k] = positions[i];
+        impulseValues[k++] = values[i];
+    }
+    numFirstGroup = (int) first.size();
+}
+
+void VelvetNoise::process_stereo(const float input, float& left, float& right){
+    delayLine.update();
+    delayLine.write(input);
+    const float first = delayLine.velvetConvolver(impulsePositions, impulseValues, numFirstGroup);
+    const float second = delayLine.velvetConvolver(impulsePositions + numFirstGroup, impulseValues + numFirstGroup,
+                                                   seqLength - numFirstGroup);
+    left = first + second;
+    right = first - second;
+}
+
+void VelvetNoise::prepare_block_history(){
+    //process reads the delay line length plus the impulse position
+    maxBlockDelay = 0;
+    for (int i = 0; i < seqLength; i++)
+        maxBlockDelay = std::max(maxBlockDelay, length + impulsePositions[i]);
+    blockHistory.assign((size_t) (maxBlockDelay + blockChunkSize), 0.0f);
+}
+
+void VelvetNoise::process_block(const float* input, float* output, int numSamples, const SimdKernels& kernels){
+    float* history = blockHistory.data();
+    for (int start = 0; start < numSamples; start += blockChunkSize){
+        const int chunk = std::min((int) blockChunkSize, numSamples - start);
+        std::copy(input + start, input + start + chunk, history + maxBlockDelay);
+        
+        //the impulses are added in the same order as in velvetConvolver
+        float* out = output + start;
+        std::fill(out, out + chunk, 0.0f);
+        for (int k = 0; k < seqLength; k++)
+            kernels.multiply_add(out, history + maxBlockDelay - length - impulsePositions[k], impulseValues[k], chunk);
+        
+        std::memmove(history, history + chunk, sizeof(float) * (size_t) maxBlockDelay);
+    }
+}
+
 float VelvetNoise::convertdBtoDecayRate(){
     return -std::log(std::pow(10, -decaydB/20))/ seqLength;
 }
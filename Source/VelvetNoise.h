@@ -9,8 +9,9 @@
 */
 
 #pragma once
-#include "JuceHeader.h"
+#include "DspCore.h"
 #include "DelayLine.h"
+#include "SimdKernels.h"
 #include <random>
 
 
@@ -20,9 +21,23 @@ public:
     ~VelvetNoise();
     
     void initialize(float sR, float L, int gS, float targetDecaydB, bool logDistribution);
-    void initialize_from_string(juce::String opt_vn_filter);
+    void initialize_from_string(const std::string& opt_vn_filter);
     float process(const float input);
+    //splits the impulses into two groups of equal energy, so that the sum and the
+    //difference of the groups are two orthogonal sequences with the same energy
+    //as the whole sequence. process_stereo then returns both from one delay line
+    void split_taps_for_stereo();
+    void process_stereo(const float input, float& left, float& right);
+    //same output as process, one impulse at a time over the block with the
+    //multiply-add kernel. It keeps its own input history, so one instance
+    //uses either process or process_block. input and output can be the same
+    void process_block(const float* input, float* output, int numSamples, const SimdKernels& kernels);
     void update(int newGridSize);
+    //the output of process is the sum of the impulse values times the input
+    //delayed by the impulse delays
+    int get_num_impulses() const { return seqLength; }
+    int get_impulse_delay(int impulse) const { return length + impulsePositions[impulse]; }
+    float get_impulse_value(int impulse) const { return impulseValues[impulse]; }
     void setImpulseLocationValues();
     float convertdBtoDecayRate();
     
@@ -35,7 +50,16 @@ private:
     float* impulseValues;   //value at impulse positions
     float decaydB;          //decay in dB of the sequence
     float sampleRate;       //sampling rate in Hz
-    bool logDistribution;   // are the impulses concentrated at the start?
+    bool logDistribution = false;   // are the impulses concentrated at the start? (only set after the first sequence)
+    int numFirstGroup = 0;  //impulses in the first group after split_taps_for_stereo
     DelayLine delayLine;    //Delay line to do convolution with velvet sequence
+    
+    //process_block: the input of the longest delay, then the current chunk
+    void prepare_block_history();
+    enum{
+        blockChunkSize = 1024,
+    };
+    std::vector<float> blockHistory;
+    int maxBlockDelay = 0;
 
 };
@@ -0,0 +1,134 @@
+/*
+  ==============================================================================
+
+    AccuracyMetrics.cpp
+
+  ==============================================================================
+*/
+
+#include "AccuracyMetrics.h"
+#include "../../../Source/OnsetDetector.h"
+
+namespace AccuracyMetrics{
+
+enum{
+    fftOrder = 12,                  //frames of 4096 samples
+    fftSize = 1 << fftOrder,
+    lowestBandHz = 63,
+};
+
+float getMaxErrorDb(const juce::AudioBuffer<float>& reference, const juce::AudioBuffer<float>& output){
+    float peak = 0.0f, maxError = 0.0f;
+    const int numChannels = juce::jmin(reference.getNumChannels(), output.getNumChannels());
+    for (int chan = 0; chan < numChannels; chan++){
+        peak = juce::jmax(peak, reference.getMagnitude(chan, 0, reference.getNumSamples()));
+        const float* a = reference.getReadPointer(chan);
+        const float* b = output.getReadPointer(chan);
+        for (int i = 0; i < juce::jmin(reference.getNumSamples(), output.getNumSamples()); i++)
+            maxError = juce::jmax(maxError, std::abs(a[i] - b[i]));
+    }
+    if (reference.getNumSamples() != output.getNumSamples())
+        return 0.0f;
+    if (maxError == 0.0f)
+        return -std::numeric_limits<float>::infinity();
+    return juce::Decibels::gainToDecibels(maxError / juce::jmax(peak, 1e-20f), -400.0f);
+}
+
+float getLevelDifferenceDb(const juce::AudioBuffer<float>& audio){
+    //a silent channel is at -400 dB, so that two silent channels have no difference
+    double energy[2] = { 0.0, 0.0 };
+    for (int chan = 0; chan < juce::jmin(2, audio.getNumChannels()); chan++){
+        const float* x = audio.getReadPointer(chan);
+        for (int i = 0; i < audio.getNumSamples(); i++)
+            energy[chan] += (double) x[i] * x[i];
+    }
+    return (float) (juce::Decibels::gainToDecibels(energy[0], -800.0) - juce::Decibels::gainToDecibels(energy[1], -800.0)) / 2.0f;
+}
+
+
+std::vector<float> getBandCentreFrequencies(double sampleRate){
+    std::vector<float> centres;
+    for (float centre = lowestBandHz; centre * std::sqrt(2.0f) < 0.5f * sampleRate; centre *= 2.0f)
+        centres.push_back(centre);
+    return centres;
+}
+
+
+std::vector<float> getBandCoherence(const juce::AudioBuffer<float>& audio, double sampleRate){
+    //the correlation of each band is summed over the spectra of Hann windowed
+    //frames that overlap by half, which sum to a constant weight over time
+    const auto centres = getBandCentreFrequencies(sampleRate);
+    std::vector<double> cross (centres.size(), 0.0), leftEnergy (centres.size(), 0.0), rightEnergy (centres.size(), 0.0);
+    juce::dsp::FFT fft (fftOrder);
+    juce::dsp::WindowingFunction<float> window ((size_t) fftSize, juce::dsp::WindowingFunction<float>::hann, false);
+    std::vector<float> left ((size_t) (2 * fftSize)), right ((size_t) (2 * fftSize));
+    
+    //the band of each FFT bin, -1 if it is in none
+    std::vector<int> bandOfBin ((size_t) fftSize / 2 + 1, -1);
+    for (int bin = 1; bin <= fftSize / 2; bin++){
+        const float frequency = (float) (bin * sampleRate / fftSize);
+        for (size_t band = 0; band < centres.size(); band++)
+            if (frequency >= centres[band] / std::sqrt(2.0f) && frequency < centres[band] * std::sqrt(2.0f))
+                bandOfBin[(size_t) bin] = (int) band;
+    }
+    
+    for (int start = -fftSize / 2; start < audio.getNumSamples(); start += fftSize / 2){
+        std::fill(left.begin(), left.end(), 0.0f);
+        std::fill(right.begin(), right.end(), 0.0f);
+        for (int i = 0; i < fftSize; i++)
+            if (start + i >= 0 && start + i < audio.getNumSamples()){
+                left[(size_t) i] = audio.getSample(0, start + i);
+                right[(size_t) i] = audio.getSample(1, start + i);
+            }
+        window.multiplyWithWindowingTable(left.data(), (size_t) fftSize);
+        window.multiplyWithWindowingTable(right.data(), (size_t) fftSize);
+        fft.performRealOnlyForwardTransform(left.data(), true);
+        fft.performRealOnlyForwardTransform(right.data(), true);
+        
+        for (int bin = 1; bin <= fftSize / 2; bin++){
+            const int band = bandOfBin[(size_t) bin];
+            if (band < 0)
+                continue;
+            const std::complex<double> x (left[(size_t) (2 * bin)], left[(size_t) (2 * bin + 1)]);
+            const std::complex<double> y (right[(size_t) (2 * bin)], right[(size_t) (2 * bin + 1)]);
+            cross[(size_t) band] += std::real(x * std::conj(y));
+            leftEnergy[(size_t) band] += std::norm(x);
+            rightEnergy[(size_t) band] += std::norm(y);
+        }
+    }
+    
+    std::vector<float> coherence (centres.size(), 1.0f);
+    for (size_t band = 0; band < centres.size(); band++){
+        const double energy = std::sqrt(leftEnergy[band] * rightEnergy[band]);
+        if (energy > 1e-12)
+            coherence[band] = (float) (std::abs(cross[band]) / energy);
+    }
+    return coherence;
+}
+
+
+std::vector<juce::int64> getOnsets(const juce::AudioBuffer<float>& audio, int channel, double sampleRate){
+    const int blockSize = 512;
+    OnsetDetector detector;
+    detector.prepare(blockSize, (float) sampleRate);
+    std::vector<juce::int64> onsets;
+    for (int pos = 0; pos < audio.getNumSamples(); pos += blockSize){
+        const int numSamples = juce::jmin(blockSize, audio.getNumSamples() - pos);
+        detector.process(audio.getReadPointer(channel, pos), numSamples);
+        for (int k = 0; k < detector.num_onsets; k++)
+            onsets.push_back(pos + detector.onset_indices[k]);
+    }
+    return onsets;
+}
+
+
+float getMaxOnsetShiftMs(const std::vector<juce::int64>& reference, const std::vector<juce::int64>& output, double sampleRate){
+    if (reference.size() != output.size())
+        return std::numeric_limits<float>::infinity();
+    juce::int64 maxShift = 0;
+    for (size_t i = 0; i < reference.size(); i++)
+        maxShift = juce::jmax(maxShift, std::abs(reference[i] - output[i]));
+    return (float) (1e3 * maxShift / sampleRate);
+}
+
+}
@@ -0,0 +1,32 @@
+/*
+  ==============================================================================
+
+    AccuracyMetrics.h
+    Measures that compare a rendered stereo signal to a reference rendering.
+
+  ==============================================================================
+*/
+
+#pragma once
+#include <JuceHeader.h>
+
+namespace AccuracyMetrics{
+    //largest sample difference relative to the peak of the reference, in dB
+    //(-infinity if the signals are identical)
+    float getMaxErrorDb(const juce::AudioBuffer<float>& reference, const juce::AudioBuffer<float>& output);
+    
+    //level of the left channel relative to the right one over the whole signal, in dB
+    float getLevelDifferenceDb(const juce::AudioBuffer<float>& audio);
+    
+    //interchannel coherence (normalised cross-correlation at lag 0) in octave bands,
+    //as calculate_interchannel_coherence in Python/src/utils.py. Bands without
+    //energy have a coherence of 1
+    std::vector<float> getBandCoherence(const juce::AudioBuffer<float>& audio, double sampleRate);
+    std::vector<float> getBandCentreFrequencies(double sampleRate);
+    
+    //onset positions (in samples) of a channel, found with the plugin's onset detector
+    std::vector<juce::int64> getOnsets(const juce::AudioBuffer<float>& audio, int channel, double sampleRate);
+    //largest distance from an onset of the reference to the nearest onset of the output,
+    //in ms. Infinite if the number of onsets differs
+    float getMaxOnsetShiftMs(const std::vector<juce::int64>& reference, const std::vector<juce::int64>& output, double sampleRate);
+}
@@ -0,0 +1,302 @@
+/*
+  ==============================================================================
+
+    Comparisons.cpp
+
+  ==============================================================================
+*/
+
+#include "Comparisons.h"
+#include "../../../Source/PluginProcessor.h"
+#include "../../../Source/SimdKernels.h"
+#include "../../../Source/BatchWidener.h"
+#include "../../../Library/include/stereowidener.h"
+#include <cstdlib>
+
+static const double prerollSeconds = 0.5;      //before each segment, longer than the memory of the STFT engine
+
+RenderConfig getDefaultConfig(){
+    //the same settings as Python/src/render_reference.py
+    RenderConfig config;
+    config.parameters.set("widthLower", 50.0f);
+    config.parameters.set("widthHigher", 100.0f);
+    config.parameters.set("cutoffFrequency", 500.0f);
+    config.parameters.set("isAmpPreserve", 1.0f);
+    config.parameters.set("hasAllpassDecorrelation", 0.0f);
+    config.parameters.set("handleTransients", 0.0f);
+    return config;
+}
+
+static RenderConfig withParameter(RenderConfig config, const char* parameterID, float value){
+    config.parameters.set(parameterID, value);
+    return config;
+}
+
+static RenderConfig withBlockSize(RenderConfig config, int blockSize){
+    config.blockSize = blockSize;
+    return config;
+}
+
+static RenderConfig withSegments(RenderConfig config, int numSegments){
+    config.numSegments = numSegments;
+    return config;
+}
+
+static RenderConfig withSimdTier(RenderConfig config, SimdKernels::Tier tier){
+    config.simdTier = SimdKernels::get_tier_name(tier);
+    return config;
+}
+
+static RenderConfig withRenderer(RenderConfig config, RenderConfig::Renderer renderer){
+    config.renderer = renderer;
+    return config;
+}
+
+static void setEnvironmentVariable(const char* name, const juce::String& value){
+   #if JUCE_WINDOWS
+    _putenv_s(name, value.toRawUTF8());
+   #else
+    if (value.isEmpty())
+        unsetenv(name);
+    else
+        setenv(name, value.toRawUTF8(), 1);
+   #endif
+}
+
+//the kernels are picked from STEREOWIDENER_SIMD_TIER when the processor is prepared
+struct ScopedSimdTier{
+    explicit ScopedSimdTier(const juce::String& tier) : previous(juce::SystemStats::getEnvironmentVariable(name, {})),
+                                                        isSet(tier.isNotEmpty()){
+        if (isSet)
+            setEnvironmentVariable(name, tier);
+    }
+    ~ScopedSimdTier(){
+        if (isSet)
+            setEnvironmentVariable(name, previous);
+    }
+    static constexpr const char* name = "STEREOWIDENER_SIMD_TIER";
+    const juce::String previous;
+    const bool isSet;
+};
+
+
+std::vector<Comparison> getComparisons(){
+    const auto velvet = getDefaultConfig();
+    const auto allpass = withParameter(velvet, "hasAllpassDecorrelation", 1.0f);
+    const auto butterworth = withParameter(velvet, "isAmpPreserve", 0.0f);
+    const auto transients = withParameter(velvet, "handleTransients", 1.0f);
+    
+    std::vector<Comparison> comparisons;
+    
+    //the processing is sample by sample, so the block size must not change the output
+    comparisons.push_back({ "velvet, block size 1", velvet, withBlockSize(velvet, 1) });
+    comparisons.push_back({ "allpass, block size 4096", allpass, withBlockSize(allpass, 4096) });
+    comparisons.push_back({ "butterworth, block size 17", butterworth, withBlockSize(butterworth, 17) });
+    comparisons.push_back({ "transients, block size 64", transients, withBlockSize(transients, 64) });
+    
+    //the kernels of every instruction set tier give the scalar output, bit for bit. A tier
+    //this CPU does not have would run the best one it has, which is compared already
+    for (int tier = SimdKernels::sse42Tier; tier <= SimdKernels::get_supported_tier(); tier++){
+        const juce::String tierName = SimdKernels::get_tier_name((SimdKernels::Tier) tier);
+        comparisons.push_back({ "velvet, " + tierName + " kernels", withSimdTier(velvet, SimdKernels::scalarTier),
+                                withSimdTier(velvet, (SimdKernels::Tier) tier) });
+        comparisons.push_back({ "allpass, " + tierName + " kernels", withSimdTier(allpass, SimdKernels::scalarTier),
+                                withSimdTier(allpass, (SimdKernels::Tier) tier) });
+    }
+    
+    //BatchWidener runs every channel in a lane of its own, with the plugin's
+    //filters and transient detector, so each stream is the plugin's output
+    comparisons.push_back({ "velvet, BatchWidener", velvet, withRenderer(velvet, RenderConfig::batchRenderer) });
+    comparisons.push_back({ "allpass, BatchWidener", allpass, withRenderer(allpass, RenderConfig::batchRenderer) });
+    comparisons.push_back({ "butterworth, BatchWidener", butterworth, withRenderer(butterworth, RenderConfig::batchRenderer) });
+    comparisons.push_back({ "transients, BatchWidener, block size 17", transients,
+                            withBlockSize(withRenderer(transients, RenderConfig::batchRenderer), 17) });
+    //and the C interface must not lose anything on the way
+    comparisons.push_back({ "velvet, C interface", velvet, withRenderer(velvet, RenderConfig::libraryRenderer) });
+    comparisons.push_back({ "allpass, C interface", allpass, withRenderer(allpass, RenderConfig::libraryRenderer) });
+    comparisons.push_back({ "transients, C interface", transients, withRenderer(transients, RenderConfig::libraryRenderer) });
+    
+    //two-pass offline rendering moves the cross-fades by the cross-fade length,
+    //exactly as a causal render with that much lookahead does
+    RenderConfig lookahead = transients, onsetMaps = transients;
+    lookahead.lookaheadIsCrossfade = true;
+    onsetMaps.useOnsetMaps = true;
+    comparisons.push_back({ "transients, onset maps", lookahead, onsetMaps });
+    
+    //the multirate low band loses what is above 0.4 of the lower rate, and its
+    //filters are designed at that rate. Below 44.1 kHz it is never used
+    comparisons.push_back({ "velvet, multirate low band", velvet, withParameter(velvet, "multirateLowBand", 1.0f), -60.0f });
+    comparisons.push_back({ "allpass, multirate low band", allpass, withParameter(allpass, "multirateLowBand", 1.0f), -60.0f });
+    comparisons.push_back({ "butterworth, multirate low band", butterworth, withParameter(butterworth, "multirateLowBand", 1.0f), -60.0f });
+    comparisons.push_back({ "transients, multirate low band", transients, withParameter(transients, "multirateLowBand", 1.0f), -60.0f });
+    
+    //the STFT engine processes whole frames, but its hops must not depend on the block size
+    const auto stft = withParameter(velvet, "engine", 1.0f);
+    comparisons.push_back({ "STFT, block size 1", stft, withBlockSize(stft, 1) });
+    comparisons.push_back({ "STFT, block size 4096", stft, withBlockSize(stft, 4096) });
+    comparisons.push_back({ "STFT transients, block size 64", withParameter(stft, "handleTransients", 1.0f),
+                            withBlockSize(withParameter(stft, "handleTransients", 1.0f), 64) });
+    //nor on where the render started, if its pre-roll starts on the hops of the serial render
+    comparisons.push_back({ "STFT, 4 segments", stft, withSegments(stft, 4) });
+    
+    //offline renders design the HRTF filters on the audio thread, so the output is exact
+    const auto hrtf = withParameter(velvet, "engine", 2.0f);
+    comparisons.push_back({ "HRTF, block size 1", hrtf, withBlockSize(hrtf, 1) });
+    comparisons.push_back({ "HRTF, block size 4096", hrtf, withBlockSize(hrtf, 4096) });
+    
+    //shared mid decorrelation has other decorrelators than the per-channel path, so only
+    //the level difference of a panned source is compared. It keeps it at moderate widths
+    const float any = std::numeric_limits<float>::infinity();
+    const auto velvetHalfWidth = withParameter(velvet, "widthHigher", 50.0f);
+    const auto allpassHalfWidth = withParameter(allpass, "widthHigher", 50.0f);
+    comparisons.push_back({ "velvet, mid decorrelation", velvetHalfWidth, withParameter(velvetHalfWidth, "midDecorrelation", 1.0f),
+                            any, any, any, 1.5f });
+    comparisons.push_back({ "allpass, mid decorrelation", allpassHalfWidth, withParameter(allpassHalfWidth, "midDecorrelation", 1.0f),
+                            any, any, any, 1.5f });
+    
+    return comparisons;
+}
+
+
+//renders the output samples from start to end into output. The processor starts
+//before start by the pre-roll, rounded down to a multiple of its processing period
+static void renderSegment(const RenderConfig& config, const juce::AudioBuffer<float>& input, double sampleRate,
+                          int start, int end, juce::AudioBuffer<float>& output){
+    const ScopedSimdTier simdTier (config.simdTier);
+    StereoWidenerAudioProcessor processor;
+    const int numChannels = processor.getTotalNumInputChannels();
+    const int blockSize = config.blockSize;
+    if (output.getNumChannels() != numChannels)
+        output.setSize(numChannels, input.getNumSamples());
+    
+    processor.setNonRealtime(true);
+    processor.prepareToPlay(sampleRate, blockSize);
+    auto parameters = config.parameters;
+    if (config.lookaheadIsCrossfade)
+        parameters.set("lookaheadSamples", juce::jmax(2, (int) std::ceil(5.0 * 1e-3 * (float) sampleRate)));
+    for (auto& param : parameters)
+        if (auto* p = processor.parameters.getParameter(param.name.toString()))
+            p->setValueNotifyingHost(p->convertTo0to1((float) param.value));
+    processor.resetParameterSmoothing();
+    
+    const int period = processor.getProcessingPeriod();
+    const int prerollStart = juce::jmax(0, start - (int) std::ceil(prerollSeconds * sampleRate)) / period * period;
+    
+    if (config.useOnsetMaps){
+        //the onsets of the whole signal, found the same way as the causal detector does
+        std::vector<std::vector<juce::int64>> onsetMaps ((size_t) numChannels);
+        for (int chan = 0; chan < numChannels; chan++){
+            OnsetDetector detector;
+            detector.prepare(blockSize, (float) sampleRate);
+            for (int pos = 0; pos < input.getNumSamples(); pos += blockSize){
+                const int numSamples = juce::jmin(blockSize, input.getNumSamples() - pos);
+                detector.process(input.getReadPointer(juce::jmin(chan, input.getNumChannels() - 1), pos), numSamples);
+                for (int k = 0; k < detector.num_onsets; k++)
+                    onsetMaps[(size_t) chan].push_back(pos + detector.onset_indices[k]);
+            }
+        }
+        processor.setOnsetMaps(onsetMaps, prerollStart);
+    }
+    
+    //the processor is fed with silence after the end of the signal to flush out its latency
+    const int latency = processor.getLatencySamples();
+    const int numSamples = input.getNumSamples();
+    juce::AudioBuffer<float> block (numChannels, blockSize);
+    juce::MidiBuffer midiMessages;
+    for (int inputPos = prerollStart; inputPos < end + latency; inputPos += blockSize){
+        const int blockLength = juce::jmin(blockSize, end + latency - inputPos);
+        block.clear();
+        for (int chan = 0; chan < numChannels; chan++)
+            for (int i = 0; i < blockLength && inputPos + i < numSamples; i++)
+                block.setSample(chan, i, input.getSample(juce::jmin(chan, input.getNumChannels() - 1), inputPos + i));
+        
+        juce::AudioBuffer<float> samples (block.getArrayOfWritePointers(), numChannels, blockLength);
+        processor.processBlock(samples, midiMessages);
+        for (int i = 0; i < blockLength; i++){
+            const int outputPos = inputPos + i - latency;
+            if (outputPos >= start && outputPos < end)
+                for (int chan = 0; chan < numChannels; chan++)
+                    output.setSample(chan, outputPos, samples.getSample(chan, i));
+        }
+    }
+    processor.releaseResources();
+}
+
+
+static const int numBatchStreams = 3;
+
+//renders the signal as the last of a few identical streams, so that it is in a group
+//of lanes that is not full. processStreams widens all streams in place, a block at a
+//time. There is no latency and no pre-roll
+template <typename ProcessStreams>
+static juce::AudioBuffer<float> renderStreams(const RenderConfig& config, const juce::AudioBuffer<float>& input,
+                                              ProcessStreams&& processStreams){
+    jassert(! config.lookaheadIsCrossfade && ! config.useOnsetMaps && config.numSegments == 1);
+    const int numSamples = input.getNumSamples();
+    juce::AudioBuffer<float> streams (2 * numBatchStreams, numSamples);
+    for (int chan = 0; chan < 2 * numBatchStreams; chan++)
+        streams.copyFrom(chan, 0, input, juce::jmin(chan % 2, input.getNumChannels() - 1), 0, numSamples);
+    std::vector<float*> channels ((size_t) (2 * numBatchStreams));
+    for (int pos = 0; pos < numSamples; pos += config.blockSize){
+        for (int chan = 0; chan < 2 * numBatchStreams; chan++)
+            channels[(size_t) chan] = streams.getWritePointer(chan, pos);
+        processStreams(channels.data(), juce::jmin(config.blockSize, numSamples - pos));
+    }
+    
+    juce::AudioBuffer<float> output (2, numSamples);
+    for (int chan = 0; chan < 2; chan++)
+        output.copyFrom(chan, 0, streams, 2 * (numBatchStreams - 1) + chan, 0, numSamples);
+    return output;
+}
+
+static float getParameter(const RenderConfig& config, const char* parameterID){
+    return (float) config.parameters[parameterID];
+}
+
+static juce::AudioBuffer<float> renderBatch(const RenderConfig& config, const juce::AudioBuffer<float>& input, double sampleRate){
+    const ScopedSimdTier simdTier (config.simdTier);
+    BatchWidener widener;
+    widener.prepare(numBatchStreams, sampleRate, config.blockSize);
+    widener.set_parameters(getParameter(config, "widthLower"), getParameter(config, "widthHigher"),
+                           getParameter(config, "cutoffFrequency"), getParameter(config, "isAmpPreserve") > 0.5f,
+                           getParameter(config, "hasAllpassDecorrelation") > 0.5f, getParameter(config, "handleTransients") > 0.5f);
+    widener.reset_parameter_smoothing();
+    return renderStreams(config, input, [&widener] (float* const* channels, int numSamples){
+        widener.process(channels, channels, numSamples);
+    });
+}
+
+static juce::AudioBuffer<float> renderLibrary(const RenderConfig& config, const juce::AudioBuffer<float>& input, double sampleRate){
+    const ScopedSimdTier simdTier (config.simdTier);
+    std::unique_ptr<stereowidener, decltype(&stereowidener_destroy)> widener (stereowidener_create(), stereowidener_destroy);
+    const bool isPrepared = widener != nullptr
+        && stereowidener_prepare(widener.get(), numBatchStreams, sampleRate, config.blockSize) == STEREOWIDENER_OK
+        && stereowidener_set_parameters(widener.get(), getParameter(config, "widthLower"), getParameter(config, "widthHigher"),
+                                        getParameter(config, "cutoffFrequency"), getParameter(config, "isAmpPreserve") > 0.5f,
+                                        getParameter(config, "hasAllpassDecorrelation") > 0.5f,
+                                        getParameter(config, "handleTransients") > 0.5f) == STEREOWIDENER_OK
+        && stereowidener_reset_parameter_smoothing(widener.get()) == STEREOWIDENER_OK;
+    //if it failed, the input comes out unchanged and the comparison fails
+    jassert(isPrepared);
+    juce::ignoreUnused(isPrepared);
+    return renderStreams(config, input, [&widener] (float* const* channels, int numSamples){
+        stereowidener_process(widener.get(), channels, channels, numSamples);
+    });
+}
+
+
+juce::AudioBuffer<float> renderWidener(const RenderConfig& config, const juce::AudioBuffer<float>& input, double sampleRate){
+    if (config.renderer == RenderConfig::batchRenderer)
+        return renderBatch(config, input, sampleRate);
+    if (config.renderer == RenderConfig::libraryRenderer)
+        return renderLibrary(config, input, sampleRate);
+    
+    //the onset detectors' running means are not carried over, so segments are only
+    //exact without transient handling
+    const int numSamples = input.getNumSamples();
+    const int segmentLength = (numSamples + config.numSegments - 1) / config.numSegments;
+    juce::AudioBuffer<float> output;
+    for (int start = 0; start < numSamples; start += segmentLength)
+        renderSegment(config, input, sampleRate, start, juce::jmin(numSamples, start + segmentLength), output);
+    return output;
+}
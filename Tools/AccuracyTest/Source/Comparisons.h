@@ -0,0 +1,45 @@
+/*
+  ==============================================================================
+
+    Comparisons.h
+    Every optimised or restructured way of rendering the widener is compared
+    to the plain scalar path it replaces. A comparison renders the corpus with
+    a reference configuration and a variant configuration and checks the
+    difference against its tolerances. New kernels add their comparisons here.
+
+  ==============================================================================
+*/
+
+#pragma once
+#include <JuceHeader.h>
+
+struct RenderConfig{
+    enum Renderer{
+        pluginRenderer,                 //processBlock of the plugin
+        batchRenderer,                  //BatchWidener, in the plugin's default modes only
+        libraryRenderer,                //the C interface of Library, which wraps BatchWidener
+    };
+    Renderer renderer = pluginRenderer;
+    juce::NamedValueSet parameters;     //plugin parameter ID -> value (not normalised)
+    int blockSize = 512;
+    bool lookaheadIsCrossfade = false;  //set the lookahead to the length of the transient cross-fade
+    bool useOnsetMaps = false;          //find the onsets in advance, as in a two-pass offline render
+    int numSegments = 1;                //render in pre-rolled segments, as the offline renderer's --segments
+    juce::String simdTier;              //STEREOWIDENER_SIMD_TIER while rendering, empty to leave it as it is
+};
+
+struct Comparison{
+    juce::String name;
+    RenderConfig reference, variant;
+    float maxErrorDb = -120.0f;             //largest sample error relative to the peak
+    float coherenceTolerance = 0.01f;       //largest difference of the band coherence
+    float onsetToleranceMs = 0.0f;          //largest shift of an onset in the output
+    float levelDifferenceToleranceDb = 0.1f;    //largest change of the interchannel level difference
+};
+
+std::vector<Comparison> getComparisons();
+//the configuration used for the golden files and the Python reference
+RenderConfig getDefaultConfig();
+
+//renders a stereo signal through the plugin, the output is aligned with the input
+juce::AudioBuffer<float> renderWidener(const RenderConfig& config, const juce::AudioBuffer<float>& input, double sampleRate);
@@ -0,0 +1,242 @@
+/*
+  ==============================================================================
+
+    Main.cpp
+    Accuracy regression tests: renders a corpus of test signals through the
+    reference scalar path and through every optimised variant, and checks the
+    sample error, the band coherence, the transient timing and the interchannel
+    level difference. Optionally the reference path itself is checked against
+    golden renders, and its coherence against renders of the Python reference
+    in Python/src. Every render also has to be free of allocations and locks
+    in processBlock (see RealtimeGuard.h). Returns 1 if any check fails.
+
+  ==============================================================================
+*/
+
+#include <JuceHeader.h>
+#include "TestSignals.h"
+#include "Comparisons.h"
+#include "AccuracyMetrics.h"
+#include "RealtimeGuard.h"
+#include <iostream>
+
+struct TestSettings{
+    juce::Array<int> sampleRates { 48000 };
+    juce::File corpusDir;               //extra test signals
+    juce::String filter;                //only run comparisons whose name contains this
+    juce::File writeGoldenDir, goldenDir, writeCorpusDir, pythonDir;
+    float goldenToleranceDb = -120.0f;
+    float pythonCoherenceTolerance = 0.15f;
+};
+
+static juce::String getUsage(){
+    return "Usage: StereoWidenerAccuracyTest [options]\n"
+           "  --sample-rates <list>       comma separated sample rates (default: 48000)\n"
+           "  --corpus <dir>              add the audio files in this directory to the test signals\n"
+           "  --filter <text>             only run the comparisons whose name contains the text\n"
+           "  --write-golden <dir>        write the renders of the default configuration as golden files\n"
+           "  --golden <dir>              check the default configuration against the golden files\n"
+           "  --golden-tolerance <dB>     largest error against the golden files (default: -120)\n"
+           "  --write-corpus <dir>        write the test signals, e.g. for Python/src/render_reference.py\n"
+           "  --python <dir>              check the band coherence against the Python renders in this directory\n"
+           "  --python-tolerance <value>  largest coherence difference to the Python renders (default: 0.15)\n";
+}
+
+
+class TestReport{
+public:
+    void check(bool passed, const juce::String& name, const juce::String& details){
+        std::cout << (passed ? "PASS  " : "FAIL  ") << name << ": " << details << std::endl;
+        numChecks++;
+        numFailed += passed ? 0 : 1;
+    }
+    int getNumFailed() const { return numFailed; }
+    int getNumChecks() const { return numChecks; }
+private:
+    int numChecks = 0, numFailed = 0;
+};
+
+static juce::String formatDb(float db){
+    return std::isinf(db) ? juce::String("-inf dB") : juce::String(db, 1) + " dB";
+}
+
+static float getMaxDifference(const std::vector<float>& a, const std::vector<float>& b){
+    float maxDifference = 0.0f;
+    for (size_t i = 0; i < juce::jmin(a.size(), b.size()); i++)
+        maxDifference = juce::jmax(maxDifference, std::abs(a[i] - b[i]));
+    return maxDifference;
+}
+
+
+static void runComparison(const Comparison& comparison, const TestSignal& signal, double sampleRate, TestReport& report){
+    RealtimeGuard::reset_violations();
+    const auto reference = renderWidener(comparison.reference, signal.audio, sampleRate);
+    const auto output = renderWidener(comparison.variant, signal.audio, sampleRate);
+    
+    //every configuration has to be allocation and lock free in processBlock
+    const auto violations = RealtimeGuard::get_violations();
+    if (RealtimeGuard::is_active())
+        report.check(violations.get_total() == 0, comparison.name + " / " + signal.name + " @ " + juce::String(sampleRate) + " realtime safety",
+                     juce::String(violations.allocations) + " allocations, " + juce::String(violations.deallocations)
+                     + " deallocations, " + juce::String(violations.locks) + " locks in processBlock");
+    
+    const float errorDb = AccuracyMetrics::getMaxErrorDb(reference, output);
+    const float coherenceError = getMaxDifference(AccuracyMetrics::getBandCoherence(reference, sampleRate),
+                                                  AccuracyMetrics::getBandCoherence(output, sampleRate));
+    float onsetShiftMs = 0.0f;
+    size_t numOnsets = 0;
+    for (int chan = 0; chan < reference.getNumChannels(); chan++){
+        const auto referenceOnsets = AccuracyMetrics::getOnsets(reference, chan, sampleRate);
+        numOnsets += referenceOnsets.size();
+        onsetShiftMs = juce::jmax(onsetShiftMs, AccuracyMetrics::getMaxOnsetShiftMs(referenceOnsets,
+                                                                                      AccuracyMetrics::getOnsets(output, chan, sampleRate),
+                                                                                      sampleRate));
+    }
+    
+    const float levelDifferenceError = std::abs(AccuracyMetrics::getLevelDifferenceDb(output)
+                                                - AccuracyMetrics::getLevelDifferenceDb(reference));
+    
+    const bool passed = errorDb <= comparison.maxErrorDb && coherenceError <= comparison.coherenceTolerance
+                        && onsetShiftMs <= comparison.onsetToleranceMs
+                        && levelDifferenceError <= comparison.levelDifferenceToleranceDb;
+    report.check(passed, comparison.name + " / " + signal.name + " @ " + juce::String(sampleRate),
+                 "max error " + formatDb(errorDb) + " (limit " + formatDb(comparison.maxErrorDb) + "), coherence "
+                 + juce::String(coherenceError, 4) + " (limit " + juce::String(comparison.coherenceTolerance, 4) + "), "
+                 + juce::String((int) numOnsets) + " onsets shifted by " + juce::String(onsetShiftMs, 3)
+                 + " ms (limit " + juce::String(comparison.onsetToleranceMs, 3) + " ms), level difference changed by "
+                 + juce::String(levelDifferenceError, 2) + " dB (limit " + juce::String(comparison.levelDifferenceToleranceDb, 2) + " dB)");
+}
+
+
+static bool writeWav(const juce::File& file, const juce::AudioBuffer<float>& audio, double sampleRate){
+    file.getParentDirectory().createDirectory();
+    file.deleteFile();
+    juce::WavAudioFormat wav;
+    std::unique_ptr<juce::AudioFormatWriter> writer (wav.createWriterFor(new juce::FileOutputStream(file), sampleRate,
+                                                                          (unsigned int) audio.getNumChannels(), 32, {}, 0));
+    return writer != nullptr && writer->writeFromAudioSampleBuffer(audio, 0, audio.getNumSamples());
+}
+
+static bool readWav(const juce::File& file, juce::AudioBuffer<float>& audio){
+    juce::WavAudioFormat wav;
+    std::unique_ptr<juce::AudioFormatReader> reader (wav.createReaderFor(new juce::FileInputStream(file), true));
+    if (reader == nullptr)
+        return false;
+    audio.setSize((int) reader->numChannels, (int) reader->lengthInSamples);
+    return reader->read(&audio, 0, (int) reader->lengthInSamples, 0, true, true);
+}
+
+static juce::String getFileName(const TestSignal& signal, double sampleRate, const juce::String& suffix = {}){
+    return signal.name + "_" + juce::String((int) sampleRate) + suffix + ".wav";
+}
+
+
+int main (int argc, char* argv[])
+{
+    juce::ScopedJuceInitialiser_GUI juceInitialiser;
+    
+    RealtimeGuard::set_asserts_on_violation(false);
+    TestSettings settings;
+    const auto cwd = juce::File::getCurrentWorkingDirectory();
+    for (int i = 1; i < argc; i++){
+        const juce::String arg (juce::CharPointer_UTF8(argv[i]));
+        const juce::String value = (i + 1 < argc) ? juce::String(juce::CharPointer_UTF8(argv[i + 1])) : juce::String();
+        if (arg == "--help" || arg == "-h"){
+            std::cout << getUsage();
+            return 0;
+        }
+        if (value.isEmpty()){
+            std::cerr << "Missing value for option " << arg << std::endl << std::endl << getUsage();
+            return 1;
+        }
+        
+        if (arg == "--sample-rates"){
+            settings.sampleRates.clear();
+            for (auto& rate : juce::StringArray::fromTokens(value, ",", ""))
+                settings.sampleRates.add(rate.getIntValue());
+        }
+        else if (arg == "--corpus")
+            settings.corpusDir = cwd.getChildFile(value);
+        else if (arg == "--filter")
+            settings.filter = value;
+        else if (arg == "--write-golden")
+            settings.writeGoldenDir = cwd.getChildFile(value);
+        else if (arg == "--golden")
+            settings.goldenDir = cwd.getChildFile(value);
+        else if (arg == "--golden-tolerance")
+            settings.goldenToleranceDb = value.getFloatValue();
+        else if (arg == "--write-corpus")
+            settings.writeCorpusDir = cwd.getChildFile(value);
+        else if (arg == "--python")
+            settings.pythonDir = cwd.getChildFile(value);
+        else if (arg == "--python-tolerance")
+            settings.pythonCoherenceTolerance = value.getFloatValue();
+        else{
+            std::cerr << "Unknown option " << arg << std::endl << std::endl << getUsage();
+            return 1;
+        }
+        i++;
+    }
+    
+    TestReport report;
+    for (int sampleRate : settings.sampleRates){
+        auto signals = createTestSignals(sampleRate);
+        if (settings.corpusDir != juce::File())
+            addTestSignalsFromDirectory(signals, settings.corpusDir, sampleRate);
+        
+        for (auto& comparison : getComparisons())
+            if (comparison.name.contains(settings.filter))
+                for (auto& signal : signals)
+                    runComparison(comparison, signal, sampleRate, report);
+        
+        for (auto& signal : signals){
+            if (settings.writeCorpusDir != juce::File() && ! writeWav(settings.writeCorpusDir.getChildFile(getFileName(signal, sampleRate)),
+                                                                      signal.audio, sampleRate))
+                report.check(false, "write corpus / " + signal.name, "could not write to " + settings.writeCorpusDir.getFullPathName());
+            
+            const bool needsDefaultRender = settings.writeGoldenDir != juce::File() || settings.goldenDir != juce::File()
+                                            || settings.pythonDir != juce::File();
+            if (! needsDefaultRender)
+                continue;
+            const auto output = renderWidener(getDefaultConfig(), signal.audio, sampleRate);
+            
+            if (settings.writeGoldenDir != juce::File()
+                && ! writeWav(settings.writeGoldenDir.getChildFile(getFileName(signal, sampleRate)), output, sampleRate))
+                report.check(false, "write golden / " + signal.name, "could not write to " + settings.writeGoldenDir.getFullPathName());
+            
+            //the scalar path itself must not change
+            juce::AudioBuffer<float> golden;
+            if (settings.goldenDir != juce::File()){
+                const auto goldenFile = settings.goldenDir.getChildFile(getFileName(signal, sampleRate));
+                if (readWav(goldenFile, golden)){
+                    const float errorDb = AccuracyMetrics::getMaxErrorDb(golden, output);
+                    report.check(errorDb <= settings.goldenToleranceDb, "golden / " + signal.name + " @ " + juce::String(sampleRate),
+                                 "max error " + formatDb(errorDb) + " (limit " + formatDb(settings.goldenToleranceDb) + ")");
+                }
+                else
+                    report.check(false, "golden / " + signal.name, "could not read " + goldenFile.getFullPathName());
+            }
+            
+            //the Python reference uses other velvet noise sequences and filter designs,
+            //so only the coherence per band can be compared
+            juce::AudioBuffer<float> python;
+            const auto pythonFile = settings.pythonDir.getChildFile(getFileName(signal, sampleRate, "_python"));
+            if (settings.pythonDir != juce::File() && readWav(pythonFile, python)){
+                const auto centres = AccuracyMetrics::getBandCentreFrequencies(sampleRate);
+                const auto coherence = AccuracyMetrics::getBandCoherence(output, sampleRate);
+                const auto pythonCoherence = AccuracyMetrics::getBandCoherence(python, sampleRate);
+                const float coherenceError = getMaxDifference(coherence, pythonCoherence);
+                juce::String bands;
+                for (size_t band = 0; band < centres.size(); band++)
+                    bands << " " << juce::String(centres[band], 0) << " Hz: " << juce::String(coherence[band], 2)
+                          << "/" << juce::String(pythonCoherence[band], 2);
+                report.check(coherenceError <= settings.pythonCoherenceTolerance, "python / " + signal.name + " @ " + juce::String(sampleRate),
+                             "coherence difference " + juce::String(coherenceError, 3) + " (limit "
+                             + juce::String(settings.pythonCoherenceTolerance, 3) + "), C++/Python:" + bands);
+            }
+        }
+    }
+    
+    std::cout << report.getNumChecks() - report.getNumFailed() << " of " << report.getNumChecks() << " checks passed" << std::endl;
+    return report.getNumFailed() > 0 ? 1 : 0;
+}
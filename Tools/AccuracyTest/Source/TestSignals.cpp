@@ -0,0 +1,134 @@
+/*
+  ==============================================================================
+
+    TestSignals.cpp
+
+  ==============================================================================
+*/
+
+#include "TestSignals.h"
+
+static const float twoPi = juce::MathConstants<float>::twoPi;
+
+static juce::AudioBuffer<float> impulses(double sampleRate){
+    //one impulse in both channels, then one in each channel
+    juce::AudioBuffer<float> audio (2, (int) (2.0 * sampleRate));
+    audio.clear();
+    audio.setSample(0, (int) (0.1 * sampleRate), 1.0f);
+    audio.setSample(1, (int) (0.1 * sampleRate), 1.0f);
+    audio.setSample(0, (int) (0.8 * sampleRate), 1.0f);
+    audio.setSample(1, (int) (1.5 * sampleRate), 1.0f);
+    return audio;
+}
+
+static juce::AudioBuffer<float> sweep(double sampleRate){
+    //exponential sine sweep from 20 Hz to 20 kHz (or just below Nyquist)
+    const int length = (int) (3.0 * sampleRate);
+    const double f0 = 20.0, f1 = juce::jmin(20000.0, 0.45 * sampleRate);
+    const double rate = std::log(f1 / f0) / length;
+    juce::AudioBuffer<float> audio (2, length + (int) (0.5 * sampleRate));
+    audio.clear();
+    for (int i = 0; i < length; i++){
+        const double phase = 2.0 * juce::MathConstants<double>::pi * f0 / (rate * sampleRate) * (std::exp(rate * i) - 1.0);
+        const float fade = (float) juce::jmin(1.0, juce::jmin(i, length - i) / (0.01 * sampleRate));
+        audio.setSample(0, i, 0.5f * fade * (float) std::sin(phase));
+        audio.setSample(1, i, 0.5f * fade * (float) std::sin(phase));
+    }
+    return audio;
+}
+
+static juce::AudioBuffer<float> drums(double sampleRate){
+    //kick, snare and hi-hat at 120 bpm, the snare slightly to the left and the hats to the right
+    const int beat = (int) (0.5 * sampleRate);
+    juce::AudioBuffer<float> audio (2, 16 * beat);
+    audio.clear();
+    juce::Random random (3);
+    
+    auto addHit = [&] (int start, float left, float right, int length, std::function<float(int, float)> hit){
+        for (int i = 0; i < length && start + i < audio.getNumSamples(); i++){
+            const float x = hit(i, (float) (i / sampleRate));
+            audio.addSample(0, start + i, left * x);
+            audio.addSample(1, start + i, right * x);
+        }
+    };
+    auto kick = [] (int, float t){
+        const float phase = twoPi * (50.0f * t + 60.0f * (1.0f - std::exp(-t * 30.0f)) / 30.0f);
+        return 0.8f * std::exp(-t * 12.0f) * std::sin(phase);
+    };
+    auto snare = [&] (int, float t){
+        return std::exp(-t * 25.0f) * (0.4f * std::sin(twoPi * 180.0f * t) + 0.5f * (2.0f * random.nextFloat() - 1.0f));
+    };
+    float previous = 0.0f;
+    auto hat = [&] (int, float t){
+        const float noise = 2.0f * random.nextFloat() - 1.0f;
+        const float highpassed = noise - previous;
+        previous = noise;
+        return 0.25f * std::exp(-t * 80.0f) * highpassed;
+    };
+    
+    for (int n = 0; n < 16; n++){
+        if (n % 2 == 0)
+            addHit(n * beat, 1.0f, 1.0f, beat, kick);
+        else
+            addHit(n * beat, 1.0f, 0.7f, beat, snare);
+        addHit(n * beat + beat / 2, 0.6f, 1.0f, beat / 2, hat);
+    }
+    return audio;
+}
+
+static juce::AudioBuffer<float> noise(double sampleRate, bool pink){
+    //the same noise in both channels, like a mono source panned to the centre
+    juce::AudioBuffer<float> audio (2, (int) (3.0 * sampleRate));
+    juce::Random random (pink ? 5 : 4);
+    float b0 = 0.0f, b1 = 0.0f, b2 = 0.0f;
+    for (int i = 0; i < audio.getNumSamples(); i++){
+        float x = 2.0f * random.nextFloat() - 1.0f;
+        if (pink){
+            //Paul Kellet's economy pinking filter
+            b0 = 0.99765f * b0 + x * 0.0990460f;
+            b1 = 0.96300f * b1 + x * 0.2965164f;
+            b2 = 0.57000f * b2 + x * 1.0526913f;
+            x = 0.25f * (b0 + b1 + b2 + x * 0.1848f);
+        }
+        else
+            x *= 0.5f;
+        audio.setSample(0, i, x);
+        audio.setSample(1, i, x);
+    }
+    return audio;
+}
+
+static juce::AudioBuffer<float> pannedNoise(double sampleRate){
+    //pink noise panned to the left, the right channel 6 dB lower
+    auto audio = noise(sampleRate, true);
+    audio.applyGain(1, 0, audio.getNumSamples(), 0.5f);
+    return audio;
+}
+
+
+std::vector<TestSignal> createTestSignals(double sampleRate){
+    std::vector<TestSignal> signals;
+    signals.push_back({ "impulses", impulses(sampleRate) });
+    signals.push_back({ "sweep", sweep(sampleRate) });
+    signals.push_back({ "drums", drums(sampleRate) });
+    signals.push_back({ "white_noise", noise(sampleRate, false) });
+    signals.push_back({ "pink_noise", noise(sampleRate, true) });
+    signals.push_back({ "panned_noise", pannedNoise(sampleRate) });
+    return signals;
+}
+
+
+void addTestSignalsFromDirectory(std::vector<TestSignal>& signals, const juce::File& directory, double sampleRate){
+    juce::AudioFormatManager formatManager;
+    formatManager.registerBasicFormats();
+    for (auto& file : directory.findChildFiles(juce::File::findFiles, false, "*.wav;*.aif;*.aiff;*.flac")){
+        std::unique_ptr<juce::AudioFormatReader> reader (formatManager.createReaderFor(file));
+        if (reader == nullptr || reader->numChannels > 2 || reader->sampleRate != sampleRate)
+            continue;
+        TestSignal signal { file.getFileNameWithoutExtension(), juce::AudioBuffer<float>(2, (int) reader->lengthInSamples) };
+        reader->read(&signal.audio, 0, (int) reader->lengthInSamples, 0, true, true);
+        if (reader->numChannels == 1)
+            signal.audio.copyFrom(1, 0, signal.audio, 0, 0, signal.audio.getNumSamples());
+        signals.push_back(std::move(signal));
+    }
+}
@@ -0,0 +1,21 @@
+/*
+  ==============================================================================
+
+    TestSignals.h
+    The stereo test corpus of the accuracy tests: impulses, a sweep, synthetic
+    drums and noise. The signals are deterministic.
+
+  ==============================================================================
+*/
+
+#pragma once
+#include <JuceHeader.h>
+
+struct TestSignal{
+    juce::String name;
+    juce::AudioBuffer<float> audio;
+};
+
+std::vector<TestSignal> createTestSignals(double sampleRate);
+//WAV, AIFF or FLAC files in a directory, e.g. recorded drums, are added to the corpus
+void addTestSignalsFromDirectory(std::vector<TestSignal>& signals, const juce::File& directory, double sampleRate);
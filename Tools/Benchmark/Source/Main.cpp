@@ -0,0 +1,244 @@
+/*
+  ==============================================================================
+
+    Main.cpp
+    Microbenchmarks of every DSP stage and of the whole processBlock across
+    block sizes, sample rates and channel counts. The results are written as
+    JSON, so that runs on different commits can be compared. The benchmark
+    fails if a measured stage allocates or locks (see RealtimeGuard.h).
+
+  ==============================================================================
+*/
+
+#include <JuceHeader.h>
+#include "StageBenchmarks.h"
+#include "RealtimeGuard.h"
+#include "SimdKernels.h"
+#include <iostream>
+
+struct BenchmarkSettings{
+    juce::Array<int> blockSizes { 16, 32, 64, 128, 256, 512, 1024, 2048, 4096 };
+    juce::Array<int> sampleRates { 44100, 48000, 88200, 96000, 176400, 192000 };
+    juce::Array<int> channelCounts { 1, 2 };
+    juce::StringArray stages;           //all stages if empty
+    double secondsPerRun = 0.02;        //minimum time of one measurement
+    int numRuns = 5;                    //the median of the runs is reported
+    juce::String label;                 //e.g. the commit, stored with the results
+    juce::File outputFile;              //results go to stdout if not set
+};
+
+static juce::String getUsage(){
+    return "Usage: StereoWidenerBenchmark [options]\n"
+           "  --block-sizes <list>    comma separated block sizes (default: 16,32,...,4096)\n"
+           "  --sample-rates <list>   comma separated sample rates (default: 44100,...,192000)\n"
+           "  --channels <list>       comma separated channel counts (default: 1,2)\n"
+           "  --stages <list>         comma separated stage names (default: all)\n"
+           "  --seconds <s>           minimum duration of one measurement (default: 0.02)\n"
+           "  --runs <n>              measurements per configuration, the median is reported (default: 5)\n"
+           "  --label <text>          label stored with the results, e.g. the commit hash\n"
+           "  --output <file.json>    where to write the results (default: stdout)\n"
+           "  --list                  list the stages\n";
+}
+
+static juce::Array<int> parseList(const juce::String& list){
+    juce::Array<int> values;
+    for (auto& value : juce::StringArray::fromTokens(list, ",", ""))
+        values.add(value.trim().getIntValue());
+    return values;
+}
+
+
+//test signal: noise bursts with decaying envelopes, so that the transient handler
+//sees onsets. It is longer than the largest block, and processed block by block
+static juce::AudioBuffer<float> createTestSignal(int numChannels, int numSamples){
+    juce::AudioBuffer<float> signal (numChannels, numSamples);
+    juce::Random random (1);
+    for (int chan = 0; chan < numChannels; chan++)
+        for (int i = 0; i < numSamples; i++){
+            const int burstPos = i % 8192;
+            const float envelope = burstPos < 2048 ? std::exp(-burstPos / 400.0f) : 0.01f;
+            signal.setSample(chan, i, envelope * (2.0f * random.nextFloat() - 1.0f));
+        }
+    return signal;
+}
+
+
+//returns the median time per sample and channel in ns
+static double measure(BenchmarkStage& stage, const juce::AudioBuffer<float>& signal, int blockSize, int numChannels,
+                      const BenchmarkSettings& settings, double& minNsPerSample){
+    juce::ScopedNoDenormals noDenormals;
+    juce::AudioBuffer<float> output (numChannels, blockSize);
+    std::vector<float*> inputChannels ((size_t) numChannels);
+    int signalPos = 0;
+    
+    auto processNextBlock = [&] {
+        for (int chan = 0; chan < numChannels; chan++)
+            inputChannels[(size_t) chan] = const_cast<float*>(signal.getReadPointer(chan, signalPos));
+        const juce::AudioBuffer<float> input (inputChannels.data(), numChannels, blockSize);
+        RealtimeGuard::Scope realtimeGuard;
+        stage.process(input, output);
+        //the block sizes need not divide the signal length, a block never runs past its end
+        signalPos += blockSize;
+        if (signalPos + blockSize > signal.getNumSamples())
+            signalPos = 0;
+    };
+    
+    //warm up the caches and the branch predictors
+    for (int n = 0; n < 16; n++)
+        processNextBlock();
+    
+    std::vector<double> nsPerSample;
+    const auto minTicks = (juce::int64) (settings.secondsPerRun * juce::Time::getHighResolutionTicksPerSecond());
+    for (int run = 0; run < settings.numRuns; run++){
+        juce::int64 numBlocks = 0;
+        const auto start = juce::Time::getHighResolutionTicks();
+        auto elapsed = (juce::int64) 0;
+        do{
+            processNextBlock();
+            numBlocks++;
+            elapsed = juce::Time::getHighResolutionTicks() - start;
+        } while (elapsed < minTicks);
+        const double seconds = juce::Time::highResolutionTicksToSeconds(elapsed);
+        nsPerSample.push_back(seconds * 1e9 / ((double) numBlocks * blockSize * numChannels));
+    }
+    
+    std::sort(nsPerSample.begin(), nsPerSample.end());
+    minNsPerSample = nsPerSample.front();
+    return nsPerSample[nsPerSample.size() / 2];
+}
+
+
+int main (int argc, char* argv[])
+{
+    juce::ScopedJuceInitialiser_GUI juceInitialiser;
+    
+    BenchmarkSettings settings;
+    const auto stages = getBenchmarkStages();
+    for (int i = 1; i < argc; i++){
+        const juce::String arg (juce::CharPointer_UTF8(argv[i]));
+        const juce::String value = (i + 1 < argc) ? juce::String(juce::CharPointer_UTF8(argv[i + 1])) : juce::String();
+        if (arg == "--help" || arg == "-h"){
+            std::cout << getUsage();
+            return 0;
+        }
+        if (arg == "--list"){
+            for (auto& stage : stages)
+                std::cout << stage.name << std::endl;
+            return 0;
+        }
+        if (value.isEmpty()){
+            std::cerr << "Missing value for option " << arg << std::endl << std::endl << getUsage();
+            return 1;
+        }
+        
+        if (arg == "--block-sizes")
+            settings.blockSizes = parseList(value);
+        else if (arg == "--sample-rates")
+            settings.sampleRates = parseList(value);
+        else if (arg == "--channels")
+            settings.channelCounts = parseList(value);
+        else if (arg == "--stages"){
+            settings.stages = juce::StringArray::fromTokens(value, ",", "\"");
+            settings.stages.trim();
+        }
+        else if (arg == "--seconds")
+            settings.secondsPerRun = value.getDoubleValue();
+        else if (arg == "--runs")
+            settings.numRuns = juce::jmax(1, value.getIntValue());
+        else if (arg == "--label")
+            settings.label = value;
+        else if (arg == "--output")
+            settings.outputFile = juce::File::getCurrentWorkingDirectory().getChildFile(value);
+        else{
+            std::cerr << "Unknown option " << arg << std::endl << std::endl << getUsage();
+            return 1;
+        }
+        i++;
+    }
+    for (auto& stageName : settings.stages)
+        if (std::none_of(stages.begin(), stages.end(), [&] (const StageInfo& stage){ return stage.name == stageName; })){
+            std::cerr << "Unknown stage " << stageName << ", use --list to see all stages" << std::endl;
+            return 1;
+        }
+    
+    int maxChannels = 0, maxBlockSize = 0;
+    for (int numChannels : settings.channelCounts)
+        maxChannels = juce::jmax(maxChannels, numChannels);
+    for (int blockSize : settings.blockSizes)
+        maxBlockSize = juce::jmax(maxBlockSize, blockSize);
+    const bool allPositive = std::all_of(settings.channelCounts.begin(), settings.channelCounts.end(), [] (int n){ return n >= 1; })
+                             && std::all_of(settings.blockSizes.begin(), settings.blockSizes.end(), [] (int n){ return n >= 1; });
+    if (! allPositive || maxChannels < 1 || maxBlockSize < 1){
+        std::cerr << "Channel counts and block sizes must be at least 1" << std::endl;
+        return 1;
+    }
+    const auto signal = createTestSignal(maxChannels, 16 * juce::jmax(maxBlockSize, 8192));
+    
+    //allocations and locks in the measured stages are counted, see RealtimeGuard.h
+    RealtimeGuard::set_asserts_on_violation(false);
+    juce::int64 totalViolations = 0;
+    
+    juce::Array<juce::var> results;
+    for (auto& info : stages){
+        if (! settings.stages.isEmpty() && ! settings.stages.contains(info.name))
+            continue;
+        auto stage = info.create();
+        
+        for (int numChannels : settings.channelCounts){
+            if (info.numChannels != 0 && numChannels != info.numChannels)
+                continue;
+            for (int sampleRate : settings.sampleRates)
+                for (int blockSize : settings.blockSizes){
+                    stage->prepare(sampleRate, blockSize, numChannels);
+                    RealtimeGuard::reset_violations();
+                    double minNsPerSample = 0.0;
+                    const double nsPerSample = measure(*stage, signal, blockSize, numChannels, settings, minNsPerSample);
+                    const auto violations = RealtimeGuard::get_violations();
+                    totalViolations += violations.get_total();
+                    //realtime factor of one instance: seconds of audio processed per second
+                    const double realtimeFactor = 1e9 / (nsPerSample * numChannels * sampleRate);
+                    
+                    auto* result = new juce::DynamicObject();
+                    result->setProperty("stage", info.name);
+                    result->setProperty("sampleRate", sampleRate);
+                    result->setProperty("blockSize", blockSize);
+                    result->setProperty("channels", numChannels);
+                    result->setProperty("nsPerSample", nsPerSample);
+                    result->setProperty("nsPerSampleMin", minNsPerSample);
+                    result->setProperty("samplesPerSecond", 1e9 / nsPerSample);
+                    result->setProperty("realtimeFactor", realtimeFactor);
+                    if (RealtimeGuard::is_active()){
+                        result->setProperty("allocations", violations.allocations + violations.deallocations);
+                        result->setProperty("locks", violations.locks);
+                    }
+                    results.add(juce::var(result));
+                    
+                    std::cerr << info.name << ", " << sampleRate << " Hz, block " << blockSize << ", "
+                              << numChannels << " ch: " << juce::String(nsPerSample, 2) << " ns/sample, "
+                              << juce::String(realtimeFactor, 1) << "x realtime" << std::endl;
+                    if (violations.get_total() > 0)
+                        std::cerr << "  " << violations.allocations << " allocations, " << violations.deallocations
+                                  << " deallocations and " << violations.locks << " locks on the audio thread" << std::endl;
+                }
+        }
+    }
+    
+    auto* report = new juce::DynamicObject();
+    report->setProperty("label", settings.label);
+    report->setProperty("date", juce::Time::getCurrentTime().toISO8601(true));
+    report->setProperty("cpu", juce::SystemStats::getCpuModel());
+    report->setProperty("numCpus", juce::SystemStats::getNumCpus());
+    report->setProperty("realtimeGuard", RealtimeGuard::is_active());
+    report->setProperty("simdTier", SimdKernels::get_tier_name(SimdKernels::get_requested_tier()));
+    report->setProperty("results", results);
+    const auto json = juce::JSON::toString(juce::var(report));
+    
+    if (settings.outputFile == juce::File()){
+        std::cout << json << std::endl;
+    }
+    else if (! settings.outputFile.replaceWithText(json)){
+        std::cerr << "Could not write " << settings.outputFile.getFullPathName() << std::endl;
+        return 1;
+    }
+    return totalViolations > 0 ? 1 : 0;
+}
@@ -0,0 +1,325 @@
+/*
+  ==============================================================================
+
+    StageBenchmarks.cpp
+
+  ==============================================================================
+*/
+
+#include "StageBenchmarks.h"
+#include "../../../Source/PluginProcessor.h"
+#include "../../../Source/BatchWidener.h"
+
+//stages that process one sample at a time. The lambdas are inlined, so the loop
+//costs the same as in the processor
+template <typename DSP, typename Init, typename Process>
+class PerSampleStage : public BenchmarkStage{
+public:
+    PerSampleStage(Init initFunction, Process processFunction) : init(initFunction), processSample(processFunction){}
+    
+    void prepare(double sampleRate, int, int numChannels) override{
+        dsp.clear();
+        for (int chan = 0; chan < numChannels; chan++){
+            dsp.push_back(std::make_unique<DSP>());
+            init(*dsp.back(), (float) sampleRate);
+        }
+    }
+    
+    void process(const juce::AudioBuffer<float>& input, juce::AudioBuffer<float>& output) override{
+        for (int chan = 0; chan < input.getNumChannels(); chan++){
+            auto& channelDsp = *dsp[(size_t) chan];
+            const float* in = input.getReadPointer(chan);
+            float* out = output.getWritePointer(chan);
+            for (int i = 0; i < input.getNumSamples(); i++)
+                out[i] = processSample(channelDsp, in[i]);
+        }
+    }
+    
+private:
+    Init init;
+    Process processSample;
+    std::vector<std::unique_ptr<DSP>> dsp;
+};
+
+template <typename DSP, typename Init, typename Process>
+static StageInfo perSampleStage(const juce::String& name, Init init, Process processSample){
+    return { name, [=] { return std::unique_ptr<BenchmarkStage>(new PerSampleStage<DSP, Init, Process>(init, processSample)); } };
+}
+
+
+class TransientStage : public BenchmarkStage{
+public:
+    void prepare(double sampleRate, int blockSize, int numChannels) override{
+        handlers.clear();
+        for (int chan = 0; chan < numChannels; chan++){
+            handlers.push_back(std::make_unique<TransientHandler>());
+            handlers.back()->prepare(blockSize, (float) sampleRate);
+        }
+        wet.setSize(numChannels, blockSize);
+        wet.clear();
+    }
+    
+    void process(const juce::AudioBuffer<float>& input, juce::AudioBuffer<float>& output) override{
+        //the input is also used as the widener output
+        for (int chan = 0; chan < input.getNumChannels(); chan++){
+            const int numSamples = input.getNumSamples();
+            wet.copyFrom(chan, 0, input, chan, 0, numSamples);
+            float* in = wet.getWritePointer(chan);
+            output.copyFrom(chan, 0, handlers[(size_t) chan]->process(in, in, numSamples), numSamples);
+        }
+    }
+    
+private:
+    std::vector<std::unique_ptr<TransientHandler>> handlers;
+    juce::AudioBuffer<float> wet;
+};
+
+
+//the block kernels of the tier chosen as in prepareToPlay, so STEREOWIDENER_SIMD_TIER
+//selects the tier measured
+class VelvetBlockStage : public BenchmarkStage{
+public:
+    VelvetBlockStage(std::function<void(VelvetNoise&, float)> initFunction) : init(initFunction){}
+    
+    void prepare(double sampleRate, int, int numChannels) override{
+        kernels = &SimdKernels::get(SimdKernels::get_requested_tier());
+        sequences.clear();
+        for (int chan = 0; chan < numChannels; chan++){
+            sequences.push_back(std::make_unique<VelvetNoise>());
+            init(*sequences.back(), (float) sampleRate);
+        }
+    }
+    
+    void process(const juce::AudioBuffer<float>& input, juce::AudioBuffer<float>& output) override{
+        for (int chan = 0; chan < input.getNumChannels(); chan++)
+            sequences[chan]->process_block(input.getReadPointer(chan), output.getWritePointer(chan), input.getNumSamples(), *kernels);
+    }
+    
+private:
+    std::function<void(VelvetNoise&, float)> init;
+    const SimdKernels* kernels = nullptr;
+    std::vector<std::unique_ptr<VelvetNoise>> sequences;
+};
+
+
+class PannerBlockStage : public BenchmarkStage{
+public:
+    void prepare(double, int blockSize, int numChannels) override{
+        kernels = &SimdKernels::get(SimdKernels::get_requested_tier());
+        pans.clear();
+        for (int chan = 0; chan < numChannels; chan++){
+            pans.push_back(std::make_unique<Panner>());
+            pans.back()->initialize();
+            pans.back()->updateWidth(1.0f);
+        }
+        negated.assign((size_t) blockSize, 0.0f);
+    }
+    
+    void process(const juce::AudioBuffer<float>& input, juce::AudioBuffer<float>& output) override{
+        //the same inputs as the per-sample stage
+        for (int chan = 0; chan < input.getNumChannels(); chan++){
+            juce::FloatVectorOperations::negate(negated.data(), input.getReadPointer(chan), input.getNumSamples());
+            const float* inputs[2] = { input.getReadPointer(chan), negated.data() };
+            pans[chan]->process_block(inputs, output.getWritePointer(chan), input.getNumSamples(), *kernels);
+        }
+    }
+    
+private:
+    const SimdKernels* kernels = nullptr;
+    std::vector<std::unique_ptr<Panner>> pans;
+    std::vector<float> negated;
+};
+
+
+//the STFT engine processes blocks of any number of channels
+class StftStage : public BenchmarkStage{
+public:
+    void prepare(double sampleRate, int, int numChannels) override{
+        widener = std::make_unique<StftWidener>();
+        widener->prepare(numChannels, sampleRate);
+        widener->update_parameters(0.5f, 1.0f, 800.0f, false);
+    }
+    
+    void process(const juce::AudioBuffer<float>& input, juce::AudioBuffer<float>& output) override{
+        for (int chan = 0; chan < input.getNumChannels(); chan++)
+            widener->process(chan, input.getReadPointer(chan), output.getWritePointer(chan), input.getNumSamples());
+    }
+    
+private:
+    std::unique_ptr<StftWidener> widener;
+};
+
+
+//the HRTF engine is stereo only
+class HrtfStage : public BenchmarkStage{
+public:
+    void prepare(double sampleRate, int, int) override{
+        widener = std::make_unique<HrtfWidener>();
+        widener->prepare(sampleRate, 30.0f, false);
+    }
+    
+    void process(const juce::AudioBuffer<float>& input, juce::AudioBuffer<float>& output) override{
+        widener->process(input.getReadPointer(0), input.getReadPointer(1), output.getWritePointer(0), output.getWritePointer(1), input.getNumSamples());
+    }
+    
+private:
+    std::unique_ptr<HrtfWidener> widener;
+};
+
+
+//the audio thread side of the coherence analysis, the analysis runs on its
+//own thread meanwhile. The input stands in for the output
+class CoherenceStage : public BenchmarkStage{
+public:
+    void prepare(double sampleRate, int, int) override{
+        analyzer = std::make_unique<CoherenceAnalyzer>();
+        analyzer->prepare(sampleRate);
+        analyzer->set_enabled(true);
+    }
+    
+    void process(const juce::AudioBuffer<float>& input, juce::AudioBuffer<float>& output) override{
+        analyzer->push(input.getReadPointer(0), input.getReadPointer(1), input.getReadPointer(0), input.getReadPointer(1), input.getNumSamples());
+        for (int chan = 0; chan < input.getNumChannels(); chan++)
+            output.copyFrom(chan, 0, input, chan, 0, input.getNumSamples());
+    }
+    
+private:
+    std::unique_ptr<CoherenceAnalyzer> analyzer;
+};
+
+
+//many stereo streams in SIMD lanes. Every stream gets the stereo input and the
+//first one goes to the output, so the time compares with processBlock times numStreams
+class BatchStage : public BenchmarkStage{
+public:
+    BatchStage(int streams, bool allpass) : numStreams(streams), allpassDecorrelation(allpass){}
+    
+    void prepare(double sampleRate, int blockSize, int) override{
+        widener = std::make_unique<BatchWidener>();
+        widener->prepare(numStreams, sampleRate, blockSize);
+        widener->set_parameters(50.0f, 100.0f, 500.0f, false, allpassDecorrelation, false);
+        widener->reset_parameter_smoothing();
+        outputs.setSize(2 * numStreams, blockSize);
+        inputPointers.resize(2 * (size_t) numStreams);
+    }
+    
+    void process(const juce::AudioBuffer<float>& input, juce::AudioBuffer<float>& output) override{
+        for (int chan = 0; chan < 2 * numStreams; chan++)
+            inputPointers[(size_t) chan] = input.getReadPointer(chan % 2);
+        widener->process(inputPointers.data(), outputs.getArrayOfWritePointers(), input.getNumSamples());
+        for (int chan = 0; chan < output.getNumChannels(); chan++)
+            output.copyFrom(chan, 0, outputs, chan, 0, input.getNumSamples());
+    }
+    
+private:
+    const int numStreams;
+    const bool allpassDecorrelation;
+    std::unique_ptr<BatchWidener> widener;
+    juce::AudioBuffer<float> outputs;
+    std::vector<const float*> inputPointers;
+};
+
+
+//the whole plugin, with the given parameters
+class ProcessorStage : public BenchmarkStage{
+public:
+    ProcessorStage(juce::NamedValueSet parameterValues) : parameters(std::move(parameterValues)){}
+    
+    void prepare(double sampleRate, int blockSize, int) override{
+        processor = std::make_unique<StereoWidenerAudioProcessor>();
+        for (auto& param : parameters)
+            if (auto* p = processor->parameters.getParameter(param.name.toString()))
+                p->setValueNotifyingHost(p->convertTo0to1((float) param.value));
+        processor->prepareToPlay(sampleRate, blockSize);
+        processor->resetParameterSmoothing();
+    }
+    
+    void process(const juce::AudioBuffer<float>& input, juce::AudioBuffer<float>& output) override{
+        //processBlock works in place, so the copy of the input is measured as well
+        for (int chan = 0; chan < input.getNumChannels(); chan++)
+            output.copyFrom(chan, 0, input, chan, 0, input.getNumSamples());
+        processor->processBlock(output, midiMessages);
+    }
+    
+private:
+    juce::NamedValueSet parameters;
+    std::unique_ptr<StereoWidenerAudioProcessor> processor;
+    juce::MidiBuffer midiMessages;
+};
+
+static StageInfo processorStage(const juce::String& name, std::initializer_list<std::pair<const char*, float>> values){
+    juce::NamedValueSet parameters;
+    parameters.set("widthLower", 50.0f);
+    parameters.set("widthHigher", 100.0f);
+    parameters.set("cutoffFrequency", 800.0f);
+    for (auto& value : values)
+        parameters.set(value.first, value.second);
+    //the processor is always stereo
+    return { name, [=] { return std::unique_ptr<BenchmarkStage>(new ProcessorStage(parameters)); }, 2 };
+}
+
+
+std::vector<StageInfo> getBenchmarkStages(){
+    //the stages are set up the same way as in StereoWidenerAudioProcessor::prepareToPlay
+    enum{
+        vnLenMs = 15,
+        density = 1000,
+        targetDecaydB = 10,
+        numBiquads = 200,
+        maxGroupDelayMs = 15,
+        prewarpFreqHz = 1000,
+        cutoffFrequency = 800,
+    };
+    
+    std::vector<StageInfo> stages;
+    const auto initVelvet = [] (VelvetNoise& vn, float sampleRate){ vn.initialize(sampleRate, vnLenMs, density, targetDecaydB, true); };
+    stages.push_back(perSampleStage<VelvetNoise>("VelvetNoise", initVelvet,
+        [] (VelvetNoise& vn, float x){ return vn.process(x); }));
+    stages.push_back(perSampleStage<AllpassBiquadCascade>("AllpassBiquadCascade",
+        [] (AllpassBiquadCascade& ap, float sampleRate){ ap.initialize(numBiquads, sampleRate, maxGroupDelayMs); },
+        [] (AllpassBiquadCascade& ap, float x){ return ap.process(x); }));
+    stages.push_back(perSampleStage<ButterworthFilter>("ButterworthFilter",
+        [] (ButterworthFilter& filter, float sampleRate){
+            filter.initialize(sampleRate, prewarpFreqHz, "lowpass");
+            filter.update(cutoffFrequency);
+        },
+        [] (ButterworthFilter& filter, float x){ return filter.process(x); }));
+    stages.push_back(perSampleStage<LinkwitzCrossover>("LinkwitzCrossover",
+        [] (LinkwitzCrossover& filter, float sampleRate){
+            filter.initialize(sampleRate, "lowpass");
+            filter.update(cutoffFrequency);
+        },
+        [] (LinkwitzCrossover& filter, float x){ return filter.process(x); }));
+    stages.push_back(perSampleStage<Panner>("Panner",
+        [] (Panner& pan, float){
+            pan.initialize();
+            pan.updateWidth(1.0f);
+        },
+        [] (Panner& pan, float x){
+            const float inputs[2] = { x, -x };
+            return pan.process(inputs);
+        }));
+    stages.push_back({ "VelvetNoise (block)", [=] { return std::unique_ptr<BenchmarkStage>(new VelvetBlockStage(initVelvet)); } });
+    stages.push_back({ "Panner (block)", [] { return std::unique_ptr<BenchmarkStage>(new PannerBlockStage()); } });
+    stages.push_back({ "TransientHandler", [] { return std::unique_ptr<BenchmarkStage>(new TransientStage()); } });
+    stages.push_back({ "StftWidener", [] { return std::unique_ptr<BenchmarkStage>(new StftStage()); } });
+    stages.push_back({ "HrtfWidener", [] { return std::unique_ptr<BenchmarkStage>(new HrtfStage()); }, 2 });
+    stages.push_back({ "CoherenceAnalyzer (push)", [] { return std::unique_ptr<BenchmarkStage>(new CoherenceStage()); }, 2 });
+    stages.push_back({ "BatchWidener (velvet, 32 streams)", [] { return std::unique_ptr<BenchmarkStage>(new BatchStage(32, false)); }, 2 });
+    stages.push_back({ "BatchWidener (allpass, 32 streams)", [] { return std::unique_ptr<BenchmarkStage>(new BatchStage(32, true)); }, 2 });
+    stages.push_back(processorStage("processBlock (velvet)", { { "hasAllpassDecorrelation", 0.0f } }));
+    stages.push_back(processorStage("processBlock (allpass)", { { "hasAllpassDecorrelation", 1.0f } }));
+    stages.push_back(processorStage("processBlock (velvet, transients)", { { "hasAllpassDecorrelation", 0.0f },
+                                                                           { "handleTransients", 1.0f } }));
+    stages.push_back(processorStage("processBlock (velvet, mid)", { { "hasAllpassDecorrelation", 0.0f },
+                                                                    { "midDecorrelation", 1.0f } }));
+    stages.push_back(processorStage("processBlock (allpass, mid)", { { "hasAllpassDecorrelation", 1.0f },
+                                                                     { "midDecorrelation", 1.0f } }));
+    stages.push_back(processorStage("processBlock (STFT)", { { "engine", 1.0f } }));
+    stages.push_back(processorStage("processBlock (HRTF)", { { "engine", 2.0f } }));
+    stages.push_back(processorStage("processBlock (velvet, multirate)", { { "hasAllpassDecorrelation", 0.0f },
+                                                                          { "multirateLowBand", 1.0f } }));
+    stages.push_back(processorStage("processBlock (velvet, amplitude preserve, multirate)", { { "isAmpPreserve", 1.0f },
+                                                                                             { "multirateLowBand", 1.0f } }));
+    return stages;
+}
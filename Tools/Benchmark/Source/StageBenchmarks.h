@@ -0,0 +1,28 @@
+/*
+  ==============================================================================
+
+    StageBenchmarks.h
+    The DSP stages measured by the benchmark. Every stage processes a block of
+    input into a block of output, with one instance of the DSP class per channel.
+
+  ==============================================================================
+*/
+
+#pragma once
+#include <JuceHeader.h>
+
+class BenchmarkStage{
+public:
+    virtual ~BenchmarkStage() = default;
+    virtual void prepare(double sampleRate, int blockSize, int numChannels) = 0;
+    virtual void process(const juce::AudioBuffer<float>& input, juce::AudioBuffer<float>& output) = 0;
+};
+
+
+struct StageInfo{
+    juce::String name;
+    std::function<std::unique_ptr<BenchmarkStage>()> create;
+    int numChannels = 0;        //if not 0, the stage only runs with this channel count
+};
+
+std::vector<StageInfo> getBenchmarkStages();
@@ -0,0 +1,162 @@
+/*
+  ==============================================================================
+
+    BlockPipeline.cpp
+
+  ==============================================================================
+*/
+
+#include "BlockPipeline.h"
+
+class BlockPipeline::StageThread : public juce::Thread{
+public:
+    StageThread(const juce::String& name, std::function<void()> stage) : juce::Thread(name), runStage(std::move(stage)){
+        startThread();
+    }
+    ~StageThread() override{
+        waitForThreadToExit(-1);
+    }
+    void run() override{
+        runStage();
+    }
+private:
+    std::function<void()> runStage;
+};
+
+
+void BlockPipeline::BlockQueue::push(int blockIndex){
+    {
+        const auto scope = fifo.write(1);
+        jassert(scope.blockSize1 == 1);     //there are never more blocks than the queue can hold
+        indices[scope.startIndex1] = blockIndex;
+    }
+    blockReady.signal();
+}
+
+bool BlockPipeline::BlockQueue::pop(int& blockIndex, const std::atomic<bool>& abort){
+    while (fifo.getNumReady() == 0){
+        if (abort)
+            return false;
+        blockReady.wait(10);
+    }
+    const auto scope = fifo.read(1);
+    blockIndex = indices[scope.startIndex1];
+    return true;
+}
+
+
+BlockPipeline::BlockPipeline(int numChans, int maxBlockSize) : numChannels(numChans), blockSize(maxBlockSize),
+                                                               blocks((size_t) numBlocks){
+    for (auto& block : blocks)
+        block.buffer.setSize(numChannels, blockSize);
+}
+
+void BlockPipeline::readBlock(juce::AudioFormatReader& reader, juce::AudioBuffer<float>& buffer, int numSamples, juce::int64 startSample){
+    //memory mapped readers can only read from the mapped section, and mapping the whole file
+    //would make the memory use grow with the file length
+    if (auto* mapped = dynamic_cast<juce::MemoryMappedAudioFormatReader*>(&reader)){
+        const juce::Range<juce::int64> samples (startSample, juce::jmin(startSample + numSamples, reader.lengthInSamples));
+        if (! samples.isEmpty() && ! mapped->getMappedSection().contains(samples)){
+            const juce::int64 windowSize = juce::jmax((juce::int64) numSamples, (juce::int64) buffer.getNumSamples() * mapWindowBlocks);
+            mapped->mapSectionOfFile({ startSample, juce::jmin(startSample + windowSize, reader.lengthInSamples) });
+        }
+    }
+    reader.read(&buffer, 0, numSamples, startSample, true, true);
+}
+
+
+bool BlockPipeline::run(juce::AudioFormatReader& reader, juce::AudioFormatWriter* writer,
+                        juce::int64 inputStart, juce::int64 inputEnd, juce::int64 outputStart, juce::int64 outputEnd, int latency,
+                        const std::function<void(juce::AudioBuffer<float>&)>& process,
+                        const juce::Array<juce::int64>& breakPoints, const std::function<void(int)>& onBreakPoint){
+    abort = false;
+    writeFailed = false;
+    freeBlocks.clear();
+    filledBlocks.clear();
+    processedBlocks.clear();
+    for (int i = 0; i < numBlocks; i++)
+        freeBlocks.push(i);
+    
+    int nextBreakPoint = 0;
+    while (nextBreakPoint < breakPoints.size() && breakPoints[nextBreakPoint] <= inputStart)
+        onBreakPoint(nextBreakPoint++);
+    if (inputStart >= inputEnd)
+        return true;
+    
+    //the blocks are split at the same points by the reader, so the break points are
+    //reached exactly at the end of a block
+    const int firstBreakPoint = nextBreakPoint;
+    StageThread readerThread ("Pipeline reader", [&] {
+        int nextSplit = firstBreakPoint;
+        juce::AudioBuffer<float> fileBuffer ((int) reader.numChannels, blockSize);
+        for (juce::int64 inputPos = inputStart; inputPos < inputEnd; ){
+            juce::int64 blockEnd = juce::jmin(inputEnd, inputPos + blockSize);
+            while (nextSplit < breakPoints.size() && breakPoints[nextSplit] <= inputPos)
+                nextSplit++;
+            if (nextSplit < breakPoints.size())
+                blockEnd = juce::jmin(blockEnd, breakPoints[nextSplit]);
+            
+            int index;
+            if (! freeBlocks.pop(index, abort))
+                return;
+            auto& block = blocks[(size_t) index];
+            block.inputPos = inputPos;
+            block.numSamples = (int) (blockEnd - inputPos);
+            block.isLast = blockEnd >= inputEnd;
+            
+            //the output of this block belongs to the input samples [inputPos - latency, blockEnd - latency)
+            const juce::int64 writeStart = juce::jmax(outputStart, inputPos - latency);
+            const juce::int64 writeEnd = juce::jmin(outputEnd, blockEnd - latency);
+            block.writeOffset = (int) (writeStart - (inputPos - latency));
+            block.numToWrite = (int) juce::jmax((juce::int64) 0, writeEnd - writeStart);
+            
+            //readers fill samples beyond the end of the file with zeros.
+            //A mono file is copied to both channels
+            readBlock(reader, fileBuffer, block.numSamples, inputPos);
+            for (int chan = 0; chan < numChannels; chan++)
+                block.buffer.copyFrom(chan, 0, fileBuffer, juce::jmin(chan, (int) reader.numChannels - 1), 0, block.numSamples);
+            
+            filledBlocks.push(index);
+            inputPos = blockEnd;
+        }
+    });
+    
+    std::unique_ptr<StageThread> writerThread;
+    if (writer != nullptr)
+        writerThread = std::make_unique<StageThread>("Pipeline writer", [&] {
+            for (int index; processedBlocks.pop(index, abort); ){
+                auto& block = blocks[(size_t) index];
+                if (block.numToWrite > 0 && ! writeFailed
+                    && ! writer->writeFromAudioSampleBuffer(block.buffer, block.writeOffset, block.numToWrite))
+                    writeFailed = true;
+                const bool isLast = block.isLast;
+                freeBlocks.push(index);
+                if (isLast)
+                    return;
+            }
+        });
+    
+    for (int index; filledBlocks.pop(index, abort); ){
+        auto& block = blocks[(size_t) index];
+        juce::AudioBuffer<float> samples (block.buffer.getArrayOfWritePointers(), numChannels, block.numSamples);
+        process(samples);
+        
+        const juce::int64 blockEnd = block.inputPos + block.numSamples;
+        const bool isLast = block.isLast;
+        if (writerThread != nullptr)
+            processedBlocks.push(index);
+        else
+            freeBlocks.push(index);
+        
+        while (nextBreakPoint < breakPoints.size() && breakPoints[nextBreakPoint] <= blockEnd)
+            onBreakPoint(nextBreakPoint++);
+        if (isLast || writeFailed)
+            break;
+    }
+    
+    //a failed write stops the reader, the threads are joined when they go out of scope
+    if (writeFailed)
+        abort = true;
+    writerThread.reset();
+    return ! writeFailed;
+}
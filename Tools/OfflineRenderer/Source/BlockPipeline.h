@@ -0,0 +1,71 @@
+/*
+  ==============================================================================
+
+    BlockPipeline.h
+    Streams a range of an audio file through a processing function with reading,
+    processing and writing on separate threads, so that the processing never
+    waits for the disk. The stages hand blocks to each other through lock-free
+    single producer, single consumer queues, and all blocks come from a fixed
+    pool, so the memory use does not depend on the length of the file.
+
+  ==============================================================================
+*/
+
+#pragma once
+#include <JuceHeader.h>
+
+class BlockPipeline{
+public:
+    BlockPipeline(int numChannels, int blockSize);
+    
+    //reads the input samples [inputStart, inputEnd) in blocks, calls process on each of them and
+    //writes the output samples [outputStart, outputEnd) to the writer (if there is one). Output
+    //sample n is taken from the processed block at n + latency. Blocks are split at the break
+    //points, and onBreakPoint(i) is called once all samples before breakPoints[i] are processed.
+    //process and onBreakPoint are called on the calling thread. Returns false if writing failed
+    bool run(juce::AudioFormatReader& reader, juce::AudioFormatWriter* writer,
+             juce::int64 inputStart, juce::int64 inputEnd, juce::int64 outputStart, juce::int64 outputEnd, int latency,
+             const std::function<void(juce::AudioBuffer<float>&)>& process,
+             const juce::Array<juce::int64>& breakPoints, const std::function<void(int)>& onBreakPoint);
+    
+    int getNumChannels() const { return numChannels; }
+    
+    //reads from any reader. Memory mapped readers are mapped in windows around the samples read
+    static void readBlock(juce::AudioFormatReader& reader, juce::AudioBuffer<float>& buffer, int numSamples, juce::int64 startSample);
+    
+private:
+    enum{
+        numBlocks = 16,             //blocks in the pool
+        mapWindowBlocks = 2048,     //size of the memory mapped window of the input in blocks
+    };
+    
+    struct Block{
+        juce::AudioBuffer<float> buffer;
+        juce::int64 inputPos = 0;
+        int numSamples = 0;
+        int writeOffset = 0;        //samples of this block that go to the output
+        int numToWrite = 0;
+        bool isLast = false;
+    };
+    
+    //single producer, single consumer queue of block indices. pop() waits until a block arrives
+    class BlockQueue{
+    public:
+        BlockQueue() : fifo(numBlocks + 1){}
+        void push(int blockIndex);
+        bool pop(int& blockIndex, const std::atomic<bool>& abort);
+        void clear(){ fifo.reset(); }
+    private:
+        juce::AbstractFifo fifo;
+        int indices[numBlocks + 1];
+        juce::WaitableEvent blockReady;
+    };
+    
+    class StageThread;
+    
+    const int numChannels, blockSize;
+    std::vector<Block> blocks;
+    BlockQueue freeBlocks, filledBlocks, processedBlocks;
+    std::atomic<bool> abort { false };
+    std::atomic<bool> writeFailed { false };
+};
@@ -0,0 +1,157 @@
+/*
+  ==============================================================================
+
+    FileRenderer.cpp
+
+  ==============================================================================
+*/
+
+#include "FileRenderer.h"
+#include "TransientAnalysis.h"
+
+FileRenderer::FileRenderer(const RenderSettings& renderSettings) : settings(renderSettings){
+    formatManager.registerBasicFormats();
+}
+
+
+void FileRenderer::applyParameters(StereoWidenerAudioProcessor& processor, const juce::NamedValueSet& parameters){
+    for (auto& param : parameters){
+        if (auto* p = processor.parameters.getParameter(param.name.toString()))
+            p->setValueNotifyingHost(p->convertTo0to1((float) param.value));
+    }
+}
+
+
+juce::StringArray FileRenderer::getParameterIDs(StereoWidenerAudioProcessor& processor){
+    juce::StringArray parameterIDs;
+    for (auto* p : processor.getParameters())
+        if (auto* withID = dynamic_cast<juce::AudioProcessorParameterWithID*>(p))
+            parameterIDs.add(withID->paramID);
+    return parameterIDs;
+}
+
+
+std::unique_ptr<juce::AudioFormatReader> FileRenderer::createReader(const juce::File& inputFile, int numChannels, juce::String& error){
+    std::unique_ptr<juce::AudioFormatReader> reader;
+    if (auto* format = formatManager.findFormatForFileExtension(inputFile.getFileExtension()))
+        reader.reset(format->createMemoryMappedReader(inputFile));
+    if (reader == nullptr)
+        reader.reset(formatManager.createReaderFor(inputFile));
+    if (reader == nullptr){
+        error = "Could not read " + inputFile.getFullPathName();
+        return nullptr;
+    }
+    if ((int) reader->numChannels > numChannels){
+        error = inputFile.getFileName() + " has " + juce::String(reader->numChannels)
+                + " channels, only mono and stereo files are supported";
+        return nullptr;
+    }
+    return reader;
+}
+
+
+int FileRenderer::getOutputBitDepth(const juce::AudioFormatReader& reader) const{
+    //keep the bit depth of the input unless another one is requested
+    return settings.bitDepth > 0 ? settings.bitDepth : (int) reader.bitsPerSample;
+}
+
+
+std::unique_ptr<juce::AudioFormatWriter> FileRenderer::createWriter(const juce::File& outputFile, double sampleRate, int numChannels,
+                                                                    int bitDepth, juce::String& error){
+    auto* format = formatManager.findFormatForFileExtension(outputFile.getFileExtension());
+    if (format == nullptr){
+        error = "Unsupported output format " + outputFile.getFileExtension();
+        return nullptr;
+    }
+    
+    const auto possibleBitDepths = format->getPossibleBitDepths();
+    if (! possibleBitDepths.contains(bitDepth))
+        bitDepth = possibleBitDepths.contains(24) ? 24 : possibleBitDepths.getLast();
+    
+    //only new files are written, an existing file is never deleted or truncated
+    if (outputFile.exists()){
+        error = outputFile.getFullPathName() + " already exists";
+        return nullptr;
+    }
+    outputFile.getParentDirectory().createDirectory();
+    auto stream = std::make_unique<juce::FileOutputStream>(outputFile);
+    if (! stream->openedOk()){
+        error = "Could not open " + outputFile.getFullPathName() + " for writing";
+        return nullptr;
+    }
+    
+    std::unique_ptr<juce::AudioFormatWriter> writer (format->createWriterFor(stream.get(), sampleRate, (unsigned int) numChannels,
+                                                                              bitDepth, {}, 0));
+    if (writer == nullptr)
+        error = "Could not create a " + format->getFormatName() + " writer for " + outputFile.getFileName();
+    else
+        stream.release();   //the writer owns the stream now
+    return writer;
+}
+
+
+void FileRenderer::prepare(StereoWidenerAudioProcessor& processor, double sampleRate){
+    processor.setNonRealtime(true);
+    processor.prepareToPlay(sampleRate, settings.blockSize);
+    applyParameters(processor, settings.parameters);
+    //a file render starts at the requested width instead of fading in
+    processor.resetParameterSmoothing();
+}
+
+
+bool FileRenderer::processRange(StereoWidenerAudioProcessor& processor, juce::AudioFormatReader& reader, juce::AudioFormatWriter* writer,
+                                juce::int64 inputStart, juce::int64 inputEnd, juce::int64 outputStart, juce::int64 outputEnd,
+                                const juce::Array<juce::int64>& breakPoints, const std::function<void(int)>& onBreakPoint){
+    //the pool of blocks is kept for the next render
+    const int numChannels = processor.getTotalNumInputChannels();
+    if (pipeline == nullptr || pipeline->getNumChannels() != numChannels)
+        pipeline = std::make_unique<BlockPipeline>(numChannels, settings.blockSize);
+    
+    juce::MidiBuffer midiMessages;
+    return pipeline->run(reader, writer, inputStart, inputEnd, outputStart, outputEnd, processor.getLatencySamples(),
+                         [&] (juce::AudioBuffer<float>& block){ processor.processBlock(block, midiMessages); },
+                         breakPoints, onBreakPoint);
+}
+
+
+RenderResult FileRenderer::render(StereoWidenerAudioProcessor& processor, const juce::File& inputFile, const juce::File& outputFile){
+    RenderResult result;
+    const int numChannels = processor.getTotalNumInputChannels();
+    auto reader = createReader(inputFile, numChannels, result.error);
+    if (reader == nullptr)
+        return result;
+    
+    //rendered next to the output file, which is only replaced once the render succeeded
+    juce::TemporaryFile tempOutput (outputFile);
+    auto writer = createWriter(tempOutput.getFile(), reader->sampleRate, numChannels, getOutputBitDepth(*reader), result.error);
+    if (writer == nullptr)
+        return result;
+    
+    const auto startTime = juce::Time::getMillisecondCounterHiRes();
+    prepare(processor, reader->sampleRate);
+    if (settings.twoPass && TransientAnalysis::isUsedFor(processor)){
+        //the files are already rendered in parallel, so the analysis runs on this thread
+        TransientAnalysis analysis (settings);
+        if (! analysis.analyse(inputFile, processor, *this, nullptr, result.error)){
+            processor.releaseResources();
+            return result;
+        }
+        processor.setOnsetMaps(analysis.getOnsetMaps(), 0);
+    }
+    
+    //the processor is fed with silence after the end of the file to flush out its latency
+    const juce::int64 numInputSamples = reader->lengthInSamples;
+    const bool written = processRange(processor, *reader, writer.get(), 0, numInputSamples + processor.getLatencySamples(),
+                                      0, numInputSamples);
+    writer.reset();
+    processor.releaseResources();
+    if (! written || ! tempOutput.overwriteTargetFileWithTemporary()){
+        result.error = "Could not write to " + outputFile.getFullPathName();
+        return result;
+    }
+    
+    result.success = true;
+    result.audioSeconds = numInputSamples / reader->sampleRate;
+    result.wallSeconds = (juce::Time::getMillisecondCounterHiRes() - startTime) * 1e-3;
+    return result;
+}
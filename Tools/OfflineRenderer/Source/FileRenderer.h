@@ -0,0 +1,63 @@
+/*
+  ==============================================================================
+
+    FileRenderer.h
+    Renders audio files through a StereoWidenerAudioProcessor instance.
+
+  ==============================================================================
+*/
+
+#pragma once
+#include <JuceHeader.h>
+#include "../../../Source/PluginProcessor.h"
+#include "RenderSettings.h"
+#include "BlockPipeline.h"
+
+struct RenderResult{
+    bool success = false;
+    juce::String error;
+    double audioSeconds = 0.0;      //duration of the rendered audio
+    double wallSeconds = 0.0;       //time it took to render it
+    double maxError = -1.0;         //largest difference to a serial render, negative if not verified
+    
+    double getRealtimeFactor() const{
+        return wallSeconds > 0.0 ? audioSeconds / wallSeconds : 0.0;
+    }
+};
+
+
+class FileRenderer{
+public:
+    FileRenderer(const RenderSettings& renderSettings);
+    
+    //renders one file. The processor must not be used by another thread at the same time
+    RenderResult render(StereoWidenerAudioProcessor& processor, const juce::File& inputFile, const juce::File& outputFile);
+    
+    //prepares the processor for an offline render with the parameters of the settings
+    void prepare(StereoWidenerAudioProcessor& processor, double sampleRate);
+    
+    //feeds the input samples [inputStart, inputEnd) through the processor and writes the output
+    //samples [outputStart, outputEnd) to the writer (if there is one). Output sample n belongs to
+    //input sample n, the latency of the processor is compensated. onBreakPoint(i) is called once
+    //all input samples before breakPoints[i] are processed, the break points must be sorted.
+    //Reading and writing run on their own threads, see BlockPipeline
+    bool processRange(StereoWidenerAudioProcessor& processor, juce::AudioFormatReader& reader, juce::AudioFormatWriter* writer,
+                      juce::int64 inputStart, juce::int64 inputEnd, juce::int64 outputStart, juce::int64 outputEnd,
+                      const juce::Array<juce::int64>& breakPoints = {}, const std::function<void(int)>& onBreakPoint = nullptr);
+    
+    //WAV and AIFF files are memory mapped
+    std::unique_ptr<juce::AudioFormatReader> createReader(const juce::File& inputFile, int numChannels, juce::String& error);
+    //32 bit WAV files are written as floating point. Fails if the file exists, renders
+    //write to a temporary file that replaces the output once it is complete
+    std::unique_ptr<juce::AudioFormatWriter> createWriter(const juce::File& outputFile, double sampleRate, int numChannels,
+                                                          int bitDepth, juce::String& error);
+    int getOutputBitDepth(const juce::AudioFormatReader& reader) const;
+    
+    static void applyParameters(StereoWidenerAudioProcessor& processor, const juce::NamedValueSet& parameters);
+    static juce::StringArray getParameterIDs(StereoWidenerAudioProcessor& processor);
+    
+private:
+    const RenderSettings& settings;
+    juce::AudioFormatManager formatManager;
+    std::unique_ptr<BlockPipeline> pipeline;
+};
@@ -0,0 +1,109 @@
+/*
+  ==============================================================================
+
+    Main.cpp
+    Headless batch renderer: renders a list of files through the stereo
+    widener on a pool of worker threads, one processor instance per worker.
+    Long files can also be split into segments that are rendered in parallel.
+
+  ==============================================================================
+*/
+
+#include <JuceHeader.h>
+#include "SegmentRenderer.h"
+#include <iostream>
+
+//collects the results and prints the progress
+class RenderLog{
+public:
+    RenderLog(const RenderSettings& renderSettings) : settings(renderSettings){
+        results.resize((size_t) settings.inputFiles.size());
+    }
+    
+    void report(int index, const RenderResult& result){
+        const juce::ScopedLock lock (printLock);
+        results[(size_t) index] = result;
+        const auto& input = settings.inputFiles[index];
+        std::cout << "[" << ++numDone << "/" << settings.inputFiles.size() << "] " << input.getFileName();
+        if (result.success){
+            std::cout << " -> " << settings.getOutputFileFor(input).getFileName() << ": "
+                      << juce::String(result.audioSeconds, 1) << " s of audio in "
+                      << juce::String(result.wallSeconds, 2) << " s ("
+                      << juce::String(result.getRealtimeFactor(), 1) << "x realtime)";
+            if (result.maxError >= 0.0)
+                std::cout << ", max. difference to serial render " << juce::String(result.maxError);
+            std::cout << std::endl;
+        }
+        else
+            std::cout << " FAILED: " << result.error << std::endl;
+    }
+    
+    const std::vector<RenderResult>& getResults() const { return results; }
+    
+private:
+    const RenderSettings& settings;
+    int numDone = 0;
+    juce::CriticalSection printLock;
+    std::vector<RenderResult> results;
+};
+
+
+int main (int argc, char* argv[])
+{
+    juce::ScopedJuceInitialiser_GUI juceInitialiser;
+    
+    juce::StringArray args;
+    for (int i = 1; i < argc; i++)
+        args.add(juce::CharPointer_UTF8(argv[i]));
+    
+    if (args.isEmpty() || args.contains("--help") || args.contains("-h")){
+        std::cout << RenderSettings::getUsage();
+        return args.isEmpty() ? 1 : 0;
+    }
+    
+    RenderSettings settings;
+    auto error = settings.parseCommandLine(args);
+    if (error.isEmpty()){
+        StereoWidenerAudioProcessor processor;
+        error = settings.validate(FileRenderer::getParameterIDs(processor));
+    }
+    if (error.isNotEmpty()){
+        std::cerr << error << std::endl << std::endl << RenderSettings::getUsage();
+        return 1;
+    }
+    
+    //files are rendered in parallel, or one after another split into segments
+    //that are rendered in parallel
+    const auto startTime = juce::Time::getMillisecondCounterHiRes();
+    RenderLog log (settings);
+    const bool renderSegments = settings.numSegments > 1;
+    const int numWorkers = renderSegments ? settings.numThreads : juce::jmin(settings.numThreads, settings.inputFiles.size());
+    RenderPool pool (settings, numWorkers);
+    
+    if (renderSegments){
+        SegmentRenderer segmentRenderer (settings, pool);
+        for (int i = 0; i < settings.inputFiles.size(); i++){
+            const auto& input = settings.inputFiles[i];
+            log.report(i, segmentRenderer.render(input, settings.getOutputFileFor(input)));
+        }
+    }
+    else{
+        pool.run(settings.inputFiles.size(), [&] (int index, StereoWidenerAudioProcessor& processor, FileRenderer& renderer){
+            const auto& input = settings.inputFiles[index];
+            log.report(index, renderer.render(processor, input, settings.getOutputFileFor(input)));
+        });
+    }
+    const double wallSeconds = (juce::Time::getMillisecondCounterHiRes() - startTime) * 1e-3;
+    
+    int numFailed = 0;
+    double audioSeconds = 0.0;
+    for (auto& result : log.getResults()){
+        numFailed += result.success ? 0 : 1;
+        audioSeconds += result.audioSeconds;
+    }
+    std::cout << "Rendered " << settings.inputFiles.size() - numFailed << " of " << settings.inputFiles.size()
+              << " files on " << numWorkers << " threads: " << juce::String(audioSeconds, 1) << " s of audio in "
+              << juce::String(wallSeconds, 2) << " s (" << juce::String(wallSeconds > 0.0 ? audioSeconds / wallSeconds : 0.0, 1)
+              << "x realtime)" << std::endl;
+    return numFailed > 0 ? 1 : 0;
+}
@@ -0,0 +1,55 @@
+/*
+  ==============================================================================
+
+    RenderPool.cpp
+
+  ==============================================================================
+*/
+
+#include "RenderPool.h"
+
+class RenderPool::Worker : public juce::Thread{
+public:
+    Worker(const RenderSettings& renderSettings, std::atomic<int>& nextJobIndex)
+        : juce::Thread("Render worker"), nextJob(nextJobIndex), renderer(renderSettings),
+          processor(std::make_unique<StereoWidenerAudioProcessor>()){}
+    
+    void start(int totalNumJobs, const Job& jobToRun){
+        numJobs = totalNumJobs;
+        job = &jobToRun;
+        startThread();
+    }
+    
+    void run() override{
+        for (int index = nextJob++; index < numJobs && ! threadShouldExit(); index = nextJob++)
+            (*job)(index, *processor, renderer);
+    }
+    
+private:
+    std::atomic<int>& nextJob;
+    int numJobs = 0;
+    const Job* job = nullptr;
+    FileRenderer renderer;
+    std::unique_ptr<StereoWidenerAudioProcessor> processor;
+};
+
+
+RenderPool::RenderPool(const RenderSettings& renderSettings, int numWorkers){
+    for (int i = 0; i < juce::jmax(1, numWorkers); i++)
+        workers.add(new Worker(renderSettings, nextJob));
+}
+
+RenderPool::~RenderPool(){
+    for (auto* worker : workers)
+        worker->stopThread(-1);
+}
+
+
+void RenderPool::run(int numJobs, const Job& job){
+    nextJob = 0;
+    const int numActive = juce::jmin(numJobs, workers.size());
+    for (int i = 0; i < numActive; i++)
+        workers[i]->start(numJobs, job);
+    for (int i = 0; i < numActive; i++)
+        workers[i]->waitForThreadToExit(-1);
+}
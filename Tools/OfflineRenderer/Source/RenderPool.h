@@ -0,0 +1,30 @@
+/*
+  ==============================================================================
+
+    RenderPool.h
+    A pool of render worker threads, each with its own processor instance.
+
+  ==============================================================================
+*/
+
+#pragma once
+#include <JuceHeader.h>
+#include "FileRenderer.h"
+
+class RenderPool{
+public:
+    using Job = std::function<void(int jobIndex, StereoWidenerAudioProcessor& processor, FileRenderer& renderer)>;
+    
+    //the processors are created on the calling thread
+    RenderPool(const RenderSettings& renderSettings, int numWorkers);
+    ~RenderPool();
+    
+    //runs job(0) ... job(numJobs - 1) on the workers and returns once all of them are done
+    void run(int numJobs, const Job& job);
+    int getNumWorkers() const { return workers.size(); }
+    
+private:
+    class Worker;
+    juce::OwnedArray<Worker> workers;
+    std::atomic<int> nextJob { 0 };
+};
@@ -0,0 +1,191 @@
+/*
+  ==============================================================================
+
+    RenderSettings.cpp
+
+  ==============================================================================
+*/
+
+#include "RenderSettings.h"
+#include <map>
+
+juce::String RenderSettings::getUsage(){
+    return "Usage: StereoWidenerRenderer [options] <input files...>\n"
+           "  --job <file.json>       job file with \"inputs\", \"outputDir\", \"format\", \"threads\",\n"
+           "                          \"blockSize\", \"bitDepth\", \"twoPass\", \"segments\", \"preroll\",\n"
+           "                          \"verify\", \"tolerance\" and a \"parameters\" object\n"
+           "  --output-dir <dir>      where to write the rendered files (default: next to the input)\n"
+           "  --format <ext>          output format: wav, aiff or flac (default: same as the input)\n"
+           "  --bit-depth <bits>      output bit depth (default: same as the input)\n"
+           "  --threads <n>           number of files rendered in parallel (default: number of cores)\n"
+           "  --block-size <n>        processing block size in samples (default: 512)\n"
+           "  --two-pass              find the transients of the whole file first, so that the cross-fades\n"
+           "                          end at the onsets without lookahead latency\n"
+           "  --segments <n>          split each file into n segments rendered in parallel (default: 1)\n"
+           "  --preroll <seconds>     audio rendered before each segment to warm it up (default: 2)\n"
+           "  --verify                compare segmented renders to a serial render\n"
+           "  --tolerance <value>     largest difference to the serial render that passes (default: 1e-5)\n"
+           "  --<parameterID> <value> any plugin parameter, e.g. --widthHigher 80 --handleTransients 1\n"
+           "Options given on the command line override the job file.\n";
+}
+
+
+juce::String RenderSettings::parseJobFile(const juce::File& jobFile){
+    if (! jobFile.existsAsFile())
+        return "Job file " + jobFile.getFullPathName() + " does not exist";
+    
+    juce::var job;
+    auto result = juce::JSON::parse(jobFile.loadFileAsString(), job);
+    if (result.failed())
+        return "Could not parse " + jobFile.getFileName() + ": " + result.getErrorMessage();
+    
+    //relative paths in the job file are relative to the job file
+    const auto jobDir = jobFile.getParentDirectory();
+    if (auto* inputs = job["inputs"].getArray())
+        for (auto& input : *inputs)
+            inputFiles.add(jobDir.getChildFile(input.toString()));
+    if (job.hasProperty("outputDir"))
+        outputDir = jobDir.getChildFile(job["outputDir"].toString());
+    if (job.hasProperty("format"))
+        outputFormat = job["format"].toString();
+    if (job.hasProperty("threads"))
+        numThreads = (int) job["threads"];
+    if (job.hasProperty("blockSize"))
+        blockSize = (int) job["blockSize"];
+    if (job.hasProperty("bitDepth"))
+        bitDepth = (int) job["bitDepth"];
+    if (job.hasProperty("twoPass"))
+        twoPass = (bool) job["twoPass"];
+    if (job.hasProperty("segments"))
+        numSegments = (int) job["segments"];
+    if (job.hasProperty("preroll"))
+        prerollSeconds = (double) job["preroll"];
+    if (job.hasProperty("verify"))
+        verify = (bool) job["verify"];
+    if (job.hasProperty("tolerance"))
+        tolerance = (double) job["tolerance"];
+    
+    if (auto* params = job["parameters"].getDynamicObject())
+        for (auto& param : params->getProperties())
+            parameters.set(param.name, (float) param.value);
+    return {};
+}
+
+
+juce::String RenderSettings::parseCommandLine(const juce::StringArray& args){
+    const auto cwd = juce::File::getCurrentWorkingDirectory();
+    
+    //the job file is read first, so that the other options override it
+    for (int i = 0; i < args.size() - 1; i++)
+        if (args[i] == "--job"){
+            auto error = parseJobFile(cwd.getChildFile(args[i + 1]));
+            if (error.isNotEmpty())
+                return error;
+        }
+    
+    for (int i = 0; i < args.size(); i++){
+        const auto& arg = args[i];
+        if (! arg.startsWith("--")){
+            inputFiles.add(cwd.getChildFile(arg));
+            continue;
+        }
+        
+        //options are given as "--name value" or "--name=value", flags without a value
+        auto name = arg.substring(2).upToFirstOccurrenceOf("=", false, false);
+        if (arg == "--verify"){
+            verify = true;
+            continue;
+        }
+        if (arg == "--two-pass"){
+            twoPass = true;
+            continue;
+        }
+        
+        juce::String value;
+        if (arg.containsChar('='))
+            value = arg.fromFirstOccurrenceOf("=", false, false);
+        else if (i + 1 < args.size())
+            value = args[++i];
+        else
+            return "Missing value for option " + arg;
+        
+        if (name == "job")
+            continue;
+        else if (name == "output-dir")
+            outputDir = cwd.getChildFile(value);
+        else if (name == "format")
+            outputFormat = value;
+        else if (name == "bit-depth")
+            bitDepth = value.getIntValue();
+        else if (name == "threads")
+            numThreads = value.getIntValue();
+        else if (name == "block-size")
+            blockSize = value.getIntValue();
+        else if (name == "segments")
+            numSegments = value.getIntValue();
+        else if (name == "preroll")
+            prerollSeconds = value.getDoubleValue();
+        else if (name == "verify")
+            verify = value.getIntValue() != 0 || value.equalsIgnoreCase("true");
+        else if (name == "two-pass")
+            twoPass = value.getIntValue() != 0 || value.equalsIgnoreCase("true");
+        else if (name == "tolerance")
+            tolerance = value.getDoubleValue();
+        else
+            parameters.set(name, value.getFloatValue());
+    }
+    return {};
+}
+
+
+juce::String RenderSettings::validate(const juce::StringArray& parameterIDs) const{
+    if (inputFiles.isEmpty())
+        return "No input files given";
+    for (auto& input : inputFiles)
+        if (! input.existsAsFile())
+            return "Input file " + input.getFullPathName() + " does not exist";
+    for (auto& param : parameters)
+        if (! parameterIDs.contains(param.name.toString()))
+            return "Unknown parameter " + param.name.toString() + ", available parameters are: "
+                   + parameterIDs.joinIntoString(", ");
+    if (numThreads < 1)
+        return "The number of threads must be at least 1";
+    if (blockSize < 1)
+        return "The block size must be at least 1";
+    if (numSegments < 1)
+        return "The number of segments must be at least 1";
+    if (prerollSeconds < 0.0)
+        return "The pre-roll must not be negative";
+    
+    //an output must not replace any of the inputs, which are still being read, and
+    //the files are rendered in parallel, so no two inputs may share an output
+    auto getKey = [] (const juce::File& file){
+        const auto path = file.getLinkedTarget().getFullPathName();
+        return juce::File::areFileNamesCaseSensitive() ? path : path.toLowerCase();
+    };
+    std::map<juce::String, int> inputIndices, outputIndices;
+    for (int i = 0; i < inputFiles.size(); i++)
+        inputIndices.emplace(getKey(inputFiles[i]), i);
+    for (int i = 0; i < inputFiles.size(); i++){
+        const auto output = getOutputFileFor(inputFiles[i]);
+        const auto key = getKey(output);
+        auto input = inputIndices.find(key);
+        if (input != inputIndices.end())
+            return "The output of " + inputFiles[i].getFullPathName() + " would overwrite the input "
+                   + inputFiles[input->second].getFullPathName() + ", use --output-dir or --format";
+        auto previous = outputIndices.emplace(key, i);
+        if (! previous.second)
+            return inputFiles[previous.first->second].getFullPathName() + " and " + inputFiles[i].getFullPathName()
+                   + " would both be rendered to " + output.getFullPathName();
+    }
+    return {};
+}
+
+
+juce::File RenderSettings::getOutputFileFor(const juce::File& inputFile) const{
+    const auto extension = outputFormat.isNotEmpty() ? "." + outputFormat.trimCharactersAtStart(".")
+                                                     : inputFile.getFileExtension();
+    if (outputDir != juce::File())
+        return outputDir.getChildFile(inputFile.getFileNameWithoutExtension() + extension);
+    return inputFile.getSiblingFile(inputFile.getFileNameWithoutExtension() + "_widened" + extension);
+}
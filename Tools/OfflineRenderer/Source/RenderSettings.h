@@ -0,0 +1,36 @@
+/*
+  ==============================================================================
+
+    RenderSettings.h
+    Settings of an offline render job, read from the command line and/or
+    a JSON job file.
+
+  ==============================================================================
+*/
+
+#pragma once
+#include <JuceHeader.h>
+
+struct RenderSettings{
+    juce::Array<juce::File> inputFiles;
+    juce::File outputDir;                   //if not set, outputs are written next to the inputs
+    juce::String outputFormat;              //file extension of the output, e.g. "wav", "aiff", "flac"
+    juce::NamedValueSet parameters;         //plugin parameter ID -> value (not normalised)
+    int numThreads = juce::SystemStats::getNumCpus();
+    int blockSize = 512;
+    int bitDepth = 0;                       //0 keeps the bit depth of the input file
+    bool twoPass = false;                   //find the onsets of the whole file before rendering it
+    int numSegments = 1;                    //if > 1, each file is split into segments rendered in parallel
+    double prerollSeconds = 2.0;            //audio rendered before each segment to warm up the processor
+    bool verify = false;                    //compare segmented renders to a serial render
+    double tolerance = 1e-5;                //largest difference to the serial render that passes
+    
+    //returns an error message, or an empty string on success
+    juce::String parseCommandLine(const juce::StringArray& args);
+    juce::String parseJobFile(const juce::File& jobFile);
+    //also rejects outputs that would overwrite an input or another output
+    juce::String validate(const juce::StringArray& parameterIDs) const;
+    juce::File getOutputFileFor(const juce::File& inputFile) const;
+    
+    static juce::String getUsage();
+};
@@ -0,0 +1,294 @@
+/*
+  ==============================================================================
+
+    SegmentRenderer.cpp
+
+  ==============================================================================
+*/
+
+#include "SegmentRenderer.h"
+#include "TransientAnalysis.h"
+
+SegmentRenderer::SegmentRenderer(const RenderSettings& renderSettings, RenderPool& renderPool)
+    : settings(renderSettings), pool(renderPool), renderer(renderSettings){}
+
+
+static std::vector<double> operator- (const std::vector<double>& a, const std::vector<double>& b){
+    std::vector<double> difference (a.size());
+    for (size_t i = 0; i < a.size(); i++)
+        difference[i] = a[i] - b[i];
+    return difference;
+}
+
+
+void SegmentRenderer::findEnvelopeSums(const juce::File& inputFile){
+    //the onset detectors compare the envelope to its mean over the whole signal so far.
+    //A pre-roll cannot warm that up, so every segment is first run once to find the sum
+    //of the envelope over the segment, and each segment is then seeded with the sum over
+    //all samples before its pre-roll
+    pool.run((int) segments.size(), [&] (int index, StereoWidenerAudioProcessor& processor, FileRenderer& segmentRenderer){
+        juce::String error;
+        auto reader = segmentRenderer.createReader(inputFile, numChannels, error);
+        if (reader == nullptr){
+            const juce::ScopedLock lock (errorLock);
+            errors.add(error);
+            return;
+        }
+        
+        auto& segment = segments[(size_t) index];
+        const bool isLast = index + 1 == (int) segments.size();
+        const juce::int64 nextPrerollStart = isLast ? segment.end : segments[(size_t) index + 1].prerollStart;
+        
+        segmentRenderer.prepare(processor, reader->sampleRate);
+        segmentRenderer.processRange(processor, *reader, nullptr, segment.prerollStart, segment.end, 0, 0,
+                                     { segment.start, nextPrerollStart, segment.end }, [&] (int breakPoint){
+            auto sums = processor.getTransientEnvelopeSums();
+            if (breakPoint == 0)
+                segment.sumsAtStart = sums;
+            else if (breakPoint == 1)
+                segment.sumsAtNextPreroll = sums;
+            else
+                segment.sumsAtEnd = sums;
+        });
+        processor.releaseResources();
+    });
+    if (! errors.isEmpty())
+        return;
+    
+    //the sum before the pre-roll of segment k is the sum over segments 0 ... k - 1 minus
+    //the part of segment k - 1 that is covered by the pre-roll of segment k
+    std::vector<double> sumBeforeSegment (segments[0].sumsAtStart.size(), 0.0);
+    for (size_t k = 0; k < segments.size(); k++){
+        segments[k].envelopeSums = sumBeforeSegment;
+        if (k > 0)
+            segments[k].envelopeSums = sumBeforeSegment - (segments[k - 1].sumsAtEnd - segments[k - 1].sumsAtNextPreroll);
+        const auto segmentSum = segments[k].sumsAtEnd - segments[k].sumsAtStart;
+        for (size_t i = 0; i < sumBeforeSegment.size(); i++)
+            sumBeforeSegment[i] += segmentSum[i];
+    }
+}
+
+
+bool SegmentRenderer::renderSegments(const juce::File& inputFile){
+    const bool seedEnvelopes = ! segments[0].envelopeSums.empty();
+    pool.run((int) segments.size(), [&] (int index, StereoWidenerAudioProcessor& processor, FileRenderer& segmentRenderer){
+        juce::String error;
+        auto& segment = segments[(size_t) index];
+        auto reader = segmentRenderer.createReader(inputFile, numChannels, error);
+        std::unique_ptr<juce::AudioFormatWriter> writer;
+        if (reader != nullptr)
+            writer = segmentRenderer.createWriter(segment.tempFile, reader->sampleRate, numChannels, 32, error);
+        
+        if (writer != nullptr){
+            segmentRenderer.prepare(processor, reader->sampleRate);
+            if (! onsetMaps.empty())
+                processor.setOnsetMaps(onsetMaps, segment.prerollStart);
+            else if (seedEnvelopes)
+                processor.setTransientEnvelopeSums(segment.envelopeSums, segment.prerollStart);
+            if (! segmentRenderer.processRange(processor, *reader, writer.get(), segment.prerollStart,
+                                               segment.end + processor.getLatencySamples(), segment.start, segment.end))
+                error = "Could not write to " + segment.tempFile.getFullPathName();
+            processor.releaseResources();
+        }
+        
+        if (error.isNotEmpty()){
+            const juce::ScopedLock lock (errorLock);
+            errors.add(error);
+        }
+    });
+    return errors.isEmpty();
+}
+
+
+bool SegmentRenderer::renderSerial(const juce::File& inputFile, const juce::File& tempFile){
+    pool.run(1, [&] (int, StereoWidenerAudioProcessor& processor, FileRenderer& serialRenderer){
+        juce::String error;
+        auto reader = serialRenderer.createReader(inputFile, numChannels, error);
+        std::unique_ptr<juce::AudioFormatWriter> writer;
+        if (reader != nullptr)
+            writer = serialRenderer.createWriter(tempFile, reader->sampleRate, numChannels, 32, error);
+        
+        if (writer != nullptr){
+            const juce::int64 numInputSamples = reader->lengthInSamples;
+            serialRenderer.prepare(processor, reader->sampleRate);
+            if (! onsetMaps.empty())
+                processor.setOnsetMaps(onsetMaps, 0);
+            if (! serialRenderer.processRange(processor, *reader, writer.get(), 0, numInputSamples + processor.getLatencySamples(),
+                                              0, numInputSamples))
+                error = "Could not write to " + tempFile.getFullPathName();
+            processor.releaseResources();
+        }
+        if (error.isNotEmpty())
+            errors.add(error);
+    });
+    return errors.isEmpty();
+}
+
+
+bool SegmentRenderer::stitch(juce::AudioFormatWriter& writer, const juce::File& outputFile){
+    juce::AudioBuffer<float> buffer (numChannels, settings.blockSize);
+    for (auto& segment : segments){
+        juce::String error;
+        auto reader = renderer.createReader(segment.tempFile, numChannels, error);
+        if (reader == nullptr || reader->lengthInSamples != segment.end - segment.start){
+            errors.add(error.isNotEmpty() ? error : "Segment " + segment.tempFile.getFileName() + " has the wrong length");
+            return false;
+        }
+        for (juce::int64 pos = 0; pos < reader->lengthInSamples; pos += buffer.getNumSamples()){
+            const int numSamples = (int) juce::jmin((juce::int64) buffer.getNumSamples(), reader->lengthInSamples - pos);
+            BlockPipeline::readBlock(*reader, buffer, numSamples, pos);
+            if (! writer.writeFromAudioSampleBuffer(buffer, 0, numSamples)){
+                errors.add("Could not write to " + outputFile.getFullPathName());
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+
+double SegmentRenderer::getMaxDifference(const juce::File& serialFile){
+    juce::String error;
+    auto serialReader = renderer.createReader(serialFile, numChannels, error);
+    if (serialReader == nullptr){
+        errors.add(error);
+        return -1.0;
+    }
+    
+    double maxDifference = 0.0;
+    juce::AudioBuffer<float> serial (numChannels, settings.blockSize);
+    juce::AudioBuffer<float> segmented (numChannels, settings.blockSize);
+    for (auto& segment : segments){
+        auto reader = renderer.createReader(segment.tempFile, numChannels, error);
+        if (reader == nullptr){
+            errors.add(error);
+            return -1.0;
+        }
+        for (juce::int64 pos = 0; pos < reader->lengthInSamples; pos += segmented.getNumSamples()){
+            const int numSamples = (int) juce::jmin((juce::int64) segmented.getNumSamples(), reader->lengthInSamples - pos);
+            BlockPipeline::readBlock(*reader, segmented, numSamples, pos);
+            BlockPipeline::readBlock(*serialReader, serial, numSamples, segment.start + pos);
+            for (int chan = 0; chan < numChannels; chan++){
+                const float* a = serial.getReadPointer(chan);
+                const float* b = segmented.getReadPointer(chan);
+                for (int n = 0; n < numSamples; n++)
+                    maxDifference = juce::jmax(maxDifference, (double) std::abs(a[n] - b[n]));
+            }
+        }
+    }
+    return maxDifference;
+}
+
+
+RenderResult SegmentRenderer::render(const juce::File& inputFile, const juce::File& outputFile){
+    RenderResult result;
+    errors.clear();
+    segments.clear();
+    onsetMaps.clear();
+    
+    //the segments are rendered by the pool, they are stitched together on this thread.
+    //This processor is only used to look up the channel count, parameters and processing period
+    StereoWidenerAudioProcessor processor;
+    numChannels = processor.getTotalNumInputChannels();
+    auto reader = renderer.createReader(inputFile, numChannels, result.error);
+    if (reader == nullptr)
+        return result;
+    
+    //the output of the STFT engine depends on where its hops fall, so the pre-rolls
+    //start on the hops of the serial render to give the same output
+    renderer.prepare(processor, reader->sampleRate);
+    const juce::int64 period = processor.getProcessingPeriod();
+    processor.releaseResources();
+    auto roundUpToPeriod = [period] (juce::int64 length) { return (length + period - 1) / period * period; };
+    
+    //segments must be at least as long as the pre-roll, so that the pre-roll of
+    //a segment lies within the segment before it
+    const juce::int64 numInputSamples = reader->lengthInSamples;
+    const juce::int64 prerollSamples = roundUpToPeriod((juce::int64) std::ceil(settings.prerollSeconds * reader->sampleRate));
+    const juce::int64 maxNumSegments = juce::jmax((juce::int64) 1, numInputSamples / juce::jmax((juce::int64) 1, prerollSamples));
+    const int numSegments = (int) juce::jmin((juce::int64) settings.numSegments, maxNumSegments);
+    const juce::int64 segmentLength = roundUpToPeriod((numInputSamples + numSegments - 1) / numSegments);
+    const auto tempDir = juce::File::getSpecialLocation(juce::File::tempDirectory);
+    
+    for (int k = 0; k < numSegments; k++){
+        Segment segment;
+        segment.start = k * segmentLength;
+        segment.end = juce::jmin(numInputSamples, segment.start + segmentLength);
+        segment.prerollStart = juce::jmax((juce::int64) 0, segment.start - prerollSamples);
+        segment.tempFile = tempDir.getNonexistentChildFile(inputFile.getFileNameWithoutExtension() + "_segment" + juce::String(k),
+                                                           ".wav", false);
+        if (segment.end > segment.start)
+            segments.push_back(segment);
+    }
+    if (segments.empty()){
+        result.error = inputFile.getFileName() + " is empty";
+        return result;
+    }
+    
+    auto deleteTempFiles = [this] {
+        for (auto& segment : segments)
+            segment.tempFile.deleteFile();
+    };
+    
+    const auto startTime = juce::Time::getMillisecondCounterHiRes();
+    //in two passes, the onsets are found in advance and the segments don't need the
+    //running envelope means of the causal detector
+    if (settings.twoPass && TransientAnalysis::isUsedFor(processor)){
+        TransientAnalysis analysis (settings);
+        if (analysis.analyse(inputFile, processor, renderer, &pool, result.error))
+            onsetMaps = analysis.getOnsetMaps();
+        else{
+            deleteTempFiles();
+            return result;
+        }
+    }
+    else if (*processor.parameters.getRawParameterValue("handleTransients") > 0.5f)
+        findEnvelopeSums(inputFile);
+    
+    if (! errors.isEmpty() || ! renderSegments(inputFile)){
+        deleteTempFiles();
+        result.error = errors.joinIntoString("; ");
+        return result;
+    }
+    
+    //stitched next to the output file, which is only replaced once the render succeeded
+    juce::TemporaryFile tempOutput (outputFile);
+    {
+        auto writer = renderer.createWriter(tempOutput.getFile(), reader->sampleRate, numChannels, renderer.getOutputBitDepth(*reader), result.error);
+        if (writer == nullptr || ! stitch(*writer, outputFile)){
+            deleteTempFiles();
+            if (result.error.isEmpty())
+                result.error = errors.joinIntoString("; ");
+            return result;
+        }
+    }
+    result.wallSeconds = (juce::Time::getMillisecondCounterHiRes() - startTime) * 1e-3;
+    result.audioSeconds = numInputSamples / reader->sampleRate;
+    
+    if (settings.verify){
+        const auto serialFile = tempDir.getNonexistentChildFile(inputFile.getFileNameWithoutExtension() + "_serial", ".wav", false);
+        if (renderSerial(inputFile, serialFile))
+            result.maxError = getMaxDifference(serialFile);
+        serialFile.deleteFile();
+        
+        if (! errors.isEmpty()){
+            deleteTempFiles();
+            result.error = errors.joinIntoString("; ");
+            return result;
+        }
+        if (result.maxError > settings.tolerance){
+            deleteTempFiles();
+            result.error = "the segmented render differs from the serial render by " + juce::String(result.maxError)
+                           + ", more than the tolerance of " + juce::String(settings.tolerance);
+            return result;
+        }
+    }
+    
+    deleteTempFiles();
+    if (! tempOutput.overwriteTargetFileWithTemporary()){
+        result.error = "Could not write to " + outputFile.getFullPathName();
+        return result;
+    }
+    result.success = true;
+    return result;
+}
@@ -0,0 +1,47 @@
+/*
+  ==============================================================================
+
+    SegmentRenderer.h
+    Renders a single long file on all workers of a RenderPool. The file is split
+    into segments which are rendered in parallel. Each segment is pre-rolled with
+    the audio before it to warm up the processor state, and the segments are then
+    stitched back together. Optionally, the result is compared to a serial render.
+
+  ==============================================================================
+*/
+
+#pragma once
+#include <JuceHeader.h>
+#include "RenderPool.h"
+
+class SegmentRenderer{
+public:
+    SegmentRenderer(const RenderSettings& renderSettings, RenderPool& renderPool);
+    
+    RenderResult render(const juce::File& inputFile, const juce::File& outputFile);
+    
+private:
+    struct Segment{
+        juce::int64 prerollStart, start, end;
+        juce::File tempFile;
+        //envelope sums of the onset detectors over all input samples before prerollStart
+        std::vector<double> envelopeSums;
+        //envelope sums at the start and end of the segment and at the pre-roll start of the next one
+        std::vector<double> sumsAtStart, sumsAtEnd, sumsAtNextPreroll;
+    };
+    
+    void findEnvelopeSums(const juce::File& inputFile);
+    bool renderSegments(const juce::File& inputFile);
+    bool renderSerial(const juce::File& inputFile, const juce::File& tempFile);
+    bool stitch(juce::AudioFormatWriter& writer, const juce::File& outputFile);
+    double getMaxDifference(const juce::File& serialFile);
+    
+    const RenderSettings& settings;
+    RenderPool& pool;
+    FileRenderer renderer;
+    std::vector<Segment> segments;
+    std::vector<std::vector<juce::int64>> onsetMaps;    //empty unless rendering in two passes
+    int numChannels = 2;
+    juce::StringArray errors;
+    juce::CriticalSection errorLock;
+};
@@ -0,0 +1,154 @@
+/*
+  ==============================================================================
+
+    TransientAnalysis.cpp
+
+  ==============================================================================
+*/
+
+#include "TransientAnalysis.h"
+
+TransientAnalysis::TransientAnalysis(const RenderSettings& renderSettings) : settings(renderSettings){}
+
+
+bool TransientAnalysis::isUsedFor(StereoWidenerAudioProcessor& processor){
+    //in band-limited mode the detector runs on the filterbank output, which is
+    //rendered causally
+    return *processor.handleTransients > 0.5f && *processor.transientHighBandOnly < 0.5f;
+}
+
+
+void TransientAnalysis::analyseChunk(Chunk& chunk, bool findOnsets, FileRenderer& renderer, juce::String& error){
+    auto reader = renderer.createReader(input, numChannels, error);
+    if (reader == nullptr)
+        return;
+    
+    //the detectors start early enough to settle before the chunk. The running mean of the
+    //envelope covers the whole file, so in the second run it is set to the mean over all
+    //samples before the chunk, first for the warm-up and then exactly at the chunk start
+    const int blockSize = settings.blockSize;
+    const juce::int64 warmupStart = juce::jmax((juce::int64) 0, chunk.start - (juce::int64) std::ceil(warmupMs * 1e-3 * reader->sampleRate));
+    std::vector<OnsetDetector> detectors ((size_t) numDetectors);
+    std::vector<double> sumsAtStart ((size_t) numDetectors, 0.0);
+    for (size_t d = 0; d < detectors.size(); d++){
+        detectors[d].prepare(blockSize, (float) reader->sampleRate);
+        if (findOnsets && chunk.start > 0)
+            detectors[d].set_envelope_sum(chunk.sumsBefore[d] * warmupStart / chunk.start, (unsigned long) warmupStart);
+    }
+    chunk.onsets.assign((size_t) numDetectors, {});
+    
+    juce::AudioBuffer<float> fileBuffer ((int) reader->numChannels, blockSize);
+    std::vector<float> detectorInput ((size_t) blockSize);
+    for (juce::int64 pos = warmupStart; pos < chunk.end; ){
+        if (pos == chunk.start)
+            for (size_t d = 0; d < detectors.size(); d++){
+                if (findOnsets)
+                    detectors[d].set_envelope_sum(chunk.sumsBefore[d], (unsigned long) chunk.start);
+                else
+                    sumsAtStart[d] = detectors[d].get_envelope_sum();
+            }
+        
+        //blocks are split at the chunk start
+        juce::int64 blockEnd = juce::jmin(chunk.end, pos + blockSize);
+        if (pos < chunk.start)
+            blockEnd = juce::jmin(blockEnd, chunk.start);
+        const int numSamples = (int) (blockEnd - pos);
+        BlockPipeline::readBlock(*reader, fileBuffer, numSamples, pos);
+        
+        //the same detector input as in the processor: each channel, or the max or sum
+        //of the magnitudes of all channels. A mono file is on both channels
+        auto getSample = [&] (int chan, int i){
+            return fileBuffer.getSample(juce::jmin(chan, (int) reader->numChannels - 1), i);
+        };
+        for (int d = 0; d < numDetectors; d++){
+            for (int i = 0; i < numSamples; i++){
+                float value = 0.0f;
+                if (linkMode == StereoWidenerAudioProcessor::independentDetection)
+                    value = getSample(d, i);
+                else
+                    for (int chan = 0; chan < numChannels; chan++){
+                        const float magnitude = std::abs(getSample(chan, i));
+                        value = (linkMode == StereoWidenerAudioProcessor::linkedMax) ? juce::jmax(value, magnitude) : value + magnitude;
+                    }
+                detectorInput[(size_t) i] = value;
+            }
+            
+            auto& detector = detectors[(size_t) d];
+            detector.process(detectorInput.data(), numSamples);
+            if (findOnsets && pos >= chunk.start)
+                for (int k = 0; k < detector.num_onsets; k++)
+                    chunk.onsets[(size_t) d].push_back(pos + detector.onset_indices[k]);
+        }
+        pos = blockEnd;
+    }
+    
+    if (! findOnsets){
+        chunk.envelopeSums.resize((size_t) numDetectors);
+        for (size_t d = 0; d < detectors.size(); d++)
+            chunk.envelopeSums[d] = detectors[d].get_envelope_sum() - sumsAtStart[d];
+    }
+}
+
+
+bool TransientAnalysis::analyse(const juce::File& inputFile, StereoWidenerAudioProcessor& processor, FileRenderer& renderer,
+                                RenderPool* pool, juce::String& error){
+    input = inputFile;
+    numChannels = processor.getTotalNumInputChannels();
+    linkMode = (int) *processor.transientLinkMode;
+    numDetectors = (linkMode == StereoWidenerAudioProcessor::independentDetection) ? numChannels : 1;
+    
+    auto reader = renderer.createReader(inputFile, numChannels, error);
+    if (reader == nullptr)
+        return false;
+    const juce::int64 numInputSamples = reader->lengthInSamples;
+    const juce::int64 warmupSamples = (juce::int64) std::ceil(warmupMs * 1e-3 * reader->sampleRate);
+    const juce::int64 maxNumChunks = juce::jmax((juce::int64) 1, numInputSamples / warmupSamples);
+    const int numChunks = pool == nullptr ? 1 : (int) juce::jmin(maxNumChunks, (juce::int64) pool->getNumWorkers() * chunksPerWorker);
+    const juce::int64 chunkLength = juce::jmax((juce::int64) 1, (numInputSamples + numChunks - 1) / numChunks);
+    
+    chunks.clear();
+    for (juce::int64 start = 0; start < numInputSamples; start += chunkLength)
+        chunks.push_back({ start, juce::jmin(numInputSamples, start + chunkLength), {}, {}, {} });
+    
+    //the envelope sums of all chunks are found first, and the onsets are found
+    //once the sum before each chunk is known
+    juce::StringArray errors;
+    juce::CriticalSection errorLock;
+    auto runPass = [&] (bool findOnsets){
+        auto analyseJob = [&] (int index, FileRenderer& chunkRenderer){
+            juce::String chunkError;
+            analyseChunk(chunks[(size_t) index], findOnsets, chunkRenderer, chunkError);
+            if (chunkError.isNotEmpty()){
+                const juce::ScopedLock lock (errorLock);
+                errors.add(chunkError);
+            }
+        };
+        if (pool != nullptr)
+            pool->run((int) chunks.size(), [&] (int index, StereoWidenerAudioProcessor&, FileRenderer& chunkRenderer){
+                analyseJob(index, chunkRenderer);
+            });
+        else
+            for (int i = 0; i < (int) chunks.size(); i++)
+                analyseJob(i, renderer);
+    };
+    
+    runPass(false);
+    std::vector<double> sum ((size_t) numDetectors, 0.0);
+    for (auto& chunk : chunks){
+        chunk.sumsBefore = sum;
+        for (size_t d = 0; d < sum.size() && errors.isEmpty(); d++)
+            sum[d] += chunk.envelopeSums[d];
+    }
+    if (errors.isEmpty())
+        runPass(true);
+    if (errors.isNotEmpty()){
+        error = errors.joinIntoString("; ");
+        return false;
+    }
+    
+    onsetMaps.assign((size_t) numDetectors, {});
+    for (auto& chunk : chunks)
+        for (size_t d = 0; d < onsetMaps.size(); d++)
+            onsetMaps[d].insert(onsetMaps[d].end(), chunk.onsets[d].begin(), chunk.onsets[d].end());
+    return true;
+}
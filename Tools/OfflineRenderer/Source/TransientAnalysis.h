@@ -0,0 +1,53 @@
+/*
+  ==============================================================================
+
+    TransientAnalysis.h
+    First pass of an offline two-pass render: runs the onset detector over the
+    whole file and builds the onset maps that replace the causal detection in the
+    second pass (see StereoWidenerAudioProcessor::setOnsetMaps). The file can be
+    split into chunks that are analysed in parallel.
+
+  ==============================================================================
+*/
+
+#pragma once
+#include <JuceHeader.h>
+#include "RenderPool.h"
+
+class TransientAnalysis{
+public:
+    TransientAnalysis(const RenderSettings& renderSettings);
+    
+    //whether a processor with these parameters uses onset maps when rendering offline
+    static bool isUsedFor(StereoWidenerAudioProcessor& processor);
+    
+    //the detector settings are taken from the processor's parameters. Without a pool,
+    //the whole file is analysed on the calling thread
+    bool analyse(const juce::File& inputFile, StereoWidenerAudioProcessor& processor, FileRenderer& renderer,
+                 RenderPool* pool, juce::String& error);
+    const std::vector<std::vector<juce::int64>>& getOnsetMaps() const { return onsetMaps; }
+    
+private:
+    enum{
+        warmupMs = 500,     //the envelope followers and thresholds settle within this time
+        chunksPerWorker = 4,
+    };
+    
+    struct Chunk{
+        juce::int64 start, end;
+        std::vector<double> envelopeSums;       //envelope sum of each detector over the chunk
+        std::vector<double> sumsBefore;         //envelope sum over all samples before the chunk
+        std::vector<std::vector<juce::int64>> onsets;
+    };
+    
+    //first run: finds the envelope sums, second run: finds the onsets
+    void analyseChunk(Chunk& chunk, bool findOnsets, FileRenderer& renderer, juce::String& error);
+    
+    const RenderSettings& settings;
+    juce::File input;
+    int numChannels = 2;
+    int numDetectors = 2;
+    int linkMode = StereoWidenerAudioProcessor::independentDetection;
+    std::vector<Chunk> chunks;
+    std::vector<std::vector<juce::int64>> onsetMaps;
+};
@@ -0,0 +1,114 @@
+/*
+  ==============================================================================
+
+    HardwareCounters.cpp
+
+  ==============================================================================
+*/
+
+#include "HardwareCounters.h"
+
+#if JUCE_LINUX
+ #include <linux/perf_event.h>
+ #include <sys/ioctl.h>
+ #include <sys/syscall.h>
+ #include <unistd.h>
+#elif JUCE_MAC
+ #include <mach/mach.h>
+#endif
+
+HardwareCounters::HardwareCounters(){
+    for (auto& fd : fds)
+        fd = -1;
+    
+   #if JUCE_LINUX
+    auto open = [] (juce::uint32 type, juce::uint64 config){
+        perf_event_attr attr;
+        std::memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = type;
+        attr.config = config;
+        attr.disabled = 1;
+        attr.inherit = 1;           //count the threads started later as well
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        return (int) syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+    };
+    fds[cacheReferences] = open(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_REFERENCES);
+    fds[cacheMisses] = open(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+    fds[l1dReadMisses] = open(PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8)
+                                                  | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16));
+    fds[instructions] = open(PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS);
+    fds[cycles] = open(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES);
+    
+    //perf events are often restricted (perf_event_paranoid) or missing in virtual machines
+    for (auto fd : fds)
+        available = available || fd >= 0;
+   #endif
+}
+
+HardwareCounters::~HardwareCounters(){
+   #if JUCE_LINUX
+    for (auto fd : fds)
+        if (fd >= 0)
+            close(fd);
+   #endif
+}
+
+
+void HardwareCounters::start(){
+   #if JUCE_LINUX
+    for (auto fd : fds)
+        if (fd >= 0){
+            ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+            ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+        }
+   #endif
+}
+
+void HardwareCounters::stop(){
+   #if JUCE_LINUX
+    for (auto fd : fds)
+        if (fd >= 0)
+            ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+   #endif
+}
+
+
+HardwareCounters::Counts HardwareCounters::read() const{
+    Counts counts;
+   #if JUCE_LINUX
+    auto readCounter = [this] (Counter counter) -> juce::int64 {
+        juce::uint64 value = 0;
+        if (fds[counter] < 0 || ::read(fds[counter], &value, sizeof(value)) != (ssize_t) sizeof(value))
+            return -1;
+        return (juce::int64) value;
+    };
+    counts.cacheReferences = readCounter(cacheReferences);
+    counts.cacheMisses = readCounter(cacheMisses);
+    counts.l1dReadMisses = readCounter(l1dReadMisses);
+    counts.instructions = readCounter(instructions);
+    counts.cycles = readCounter(cycles);
+   #endif
+    return counts;
+}
+
+
+juce::int64 HardwareCounters::getResidentMemoryBytes(){
+   #if JUCE_LINUX
+    //the second field of statm is the number of resident pages
+    const auto statm = juce::File("/proc/self/statm").loadFileAsString();
+    const auto fields = juce::StringArray::fromTokens(statm, " ", "");
+    if (fields.size() < 2)
+        return -1;
+    return fields[1].getLargeIntValue() * (juce::int64) sysconf(_SC_PAGESIZE);
+   #elif JUCE_MAC
+    mach_task_basic_info info;
+    mach_msg_type_number_t count = MACH_TASK_BASIC_INFO_COUNT;
+    if (task_info(mach_task_self(), MACH_TASK_BASIC_INFO, (task_info_t) &info, &count) != KERN_SUCCESS)
+        return -1;
+    return (juce::int64) info.resident_size;
+   #else
+    return -1;
+   #endif
+}
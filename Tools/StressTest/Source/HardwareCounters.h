@@ -0,0 +1,48 @@
+/*
+  ==============================================================================
+
+    HardwareCounters.h
+    Cache miss, instruction and cycle counters of the whole process (all threads
+    started after start() are counted), and the resident memory of the process.
+    The counters use perf events and are only available on Linux.
+
+  ==============================================================================
+*/
+
+#pragma once
+#include <JuceHeader.h>
+
+class HardwareCounters{
+public:
+    HardwareCounters();
+    ~HardwareCounters();
+    
+    //the counters must be opened before the threads they count are started
+    bool isAvailable() const { return available; }
+    void start();
+    void stop();
+    
+    struct Counts{
+        juce::int64 cacheReferences = -1;
+        juce::int64 cacheMisses = -1;
+        juce::int64 l1dReadMisses = -1;
+        juce::int64 instructions = -1;
+        juce::int64 cycles = -1;
+    };
+    Counts read() const;
+    
+    //-1 if not known on this platform
+    static juce::int64 getResidentMemoryBytes();
+    
+private:
+    enum Counter{
+        cacheReferences = 0,
+        cacheMisses,
+        l1dReadMisses,
+        instructions,
+        cycles,
+        numCounters,
+    };
+    int fds[numCounters];
+    bool available = false;
+};
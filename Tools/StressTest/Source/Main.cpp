@@ -0,0 +1,178 @@
+/*
+  ==============================================================================
+
+    Main.cpp
+    Session stress test: many processor instances with automated parameters,
+    processed on a pool of threads the way a host's audio graph does. Reports
+    the block and cycle time percentiles, deadline misses, resident memory and
+    hardware cache counters.
+
+  ==============================================================================
+*/
+
+#include <JuceHeader.h>
+#include "SessionGraph.h"
+#include "HardwareCounters.h"
+#include <iostream>
+
+static juce::String getUsage(){
+    return "Usage: StereoWidenerStressTest [options]\n"
+           "  --instances <n>         number of plugin instances, 1 - 512 (default: 64)\n"
+           "  --threads <n>           number of audio threads (default: number of cores)\n"
+           "  --sample-rate <hz>      (default: 48000)\n"
+           "  --block-size <n>        (default: 128)\n"
+           "  --seconds <s>           length of the simulated session (default: 10)\n"
+           "  --unpaced               run the cycles back to back instead of in real time\n"
+           "  --no-automation         keep the parameters constant\n"
+           "  --json <file>           also write the results to a JSON file\n";
+}
+
+//percentile p (0 - 1) of the values
+static float percentile(std::vector<float> values, double p){
+    if (values.empty())
+        return 0.0f;
+    const auto index = juce::jmin(values.size() - 1, (size_t) (p * values.size()));
+    std::nth_element(values.begin(), values.begin() + (std::ptrdiff_t) index, values.end());
+    return values[index];
+}
+
+static juce::String megabytes(juce::int64 bytes){
+    return bytes < 0 ? juce::String("unknown") : juce::String(bytes / (1024.0 * 1024.0), 1) + " MB";
+}
+
+
+int main (int argc, char* argv[])
+{
+    juce::ScopedJuceInitialiser_GUI juceInitialiser;
+    
+    SessionGraph::Settings settings;
+    juce::File jsonFile;
+    for (int i = 1; i < argc; i++){
+        const juce::String arg (juce::CharPointer_UTF8(argv[i]));
+        const juce::String value = (i + 1 < argc) ? juce::String(juce::CharPointer_UTF8(argv[i + 1])) : juce::String();
+        if (arg == "--help" || arg == "-h"){
+            std::cout << getUsage();
+            return 0;
+        }
+        if (arg == "--unpaced"){
+            settings.paced = false;
+            continue;
+        }
+        if (arg == "--no-automation"){
+            settings.automation = false;
+            continue;
+        }
+        if (value.isEmpty()){
+            std::cerr << "Missing value for option " << arg << std::endl << std::endl << getUsage();
+            return 1;
+        }
+        
+        if (arg == "--instances")
+            settings.numInstances = value.getIntValue();
+        else if (arg == "--threads")
+            settings.numThreads = value.getIntValue();
+        else if (arg == "--sample-rate")
+            settings.sampleRate = value.getDoubleValue();
+        else if (arg == "--block-size")
+            settings.blockSize = value.getIntValue();
+        else if (arg == "--seconds")
+            settings.seconds = value.getDoubleValue();
+        else if (arg == "--json")
+            jsonFile = juce::File::getCurrentWorkingDirectory().getChildFile(value);
+        else{
+            std::cerr << "Unknown option " << arg << std::endl << std::endl << getUsage();
+            return 1;
+        }
+        i++;
+    }
+    if (settings.numInstances < 1 || settings.numInstances > 512 || settings.numThreads < 1
+        || settings.blockSize < 1 || settings.sampleRate <= 0.0 || settings.seconds <= 0.0){
+        std::cerr << "Invalid settings" << std::endl << std::endl << getUsage();
+        return 1;
+    }
+    
+    //the counters have to exist before the worker threads are started
+    HardwareCounters counters;
+    const auto memoryAtStart = HardwareCounters::getResidentMemoryBytes();
+    SessionGraph graph (settings);
+    graph.prepare();
+    const auto memoryPrepared = HardwareCounters::getResidentMemoryBytes();
+    
+    std::cout << settings.numInstances << " instances on " << settings.numThreads << " threads, "
+              << settings.sampleRate << " Hz, block size " << settings.blockSize << ", "
+              << graph.getNumCycles() << " cycles" << (settings.paced ? "" : " (unpaced)") << std::endl;
+    
+    counters.start();
+    graph.run();
+    counters.stop();
+    const auto memoryAfterRun = HardwareCounters::getResidentMemoryBytes();
+    const auto counts = counters.read();
+    
+    const auto& blockTimes = graph.getBlockTimes();
+    const auto& cycleTimes = graph.getCycleTimes();
+    const double deadlineMs = graph.getCycleDeadlineMs();
+    const auto numMisses = std::count_if(cycleTimes.begin(), cycleTimes.end(), [=] (float t){ return t > deadlineMs; });
+    const juce::int64 numBlocks = (juce::int64) blockTimes.size();
+    
+    juce::DynamicObject::Ptr report (new juce::DynamicObject());
+    auto addPercentiles = [&] (const char* name, const std::vector<float>& times){
+        auto* stats = new juce::DynamicObject();
+        stats->setProperty("p50", percentile(times, 0.5));
+        stats->setProperty("p99", percentile(times, 0.99));
+        stats->setProperty("p99.9", percentile(times, 0.999));
+        stats->setProperty("max", times.empty() ? 0.0f : *std::max_element(times.begin(), times.end()));
+        report->setProperty(name, juce::var(stats));
+        std::cout << name << " (ms): p50 " << juce::String(percentile(times, 0.5), 4)
+                  << ", p99 " << juce::String(percentile(times, 0.99), 4)
+                  << ", p99.9 " << juce::String(percentile(times, 0.999), 4)
+                  << ", max " << juce::String((float) stats->getProperty("max"), 4) << std::endl;
+    };
+    addPercentiles("blockTimesMs", blockTimes);
+    addPercentiles("cycleTimesMs", cycleTimes);
+    std::cout << "deadline " << juce::String(deadlineMs, 3) << " ms, missed by " << (int) numMisses << " of "
+              << cycleTimes.size() << " cycles (" << juce::String(100.0 * numMisses / juce::jmax((size_t) 1, cycleTimes.size()), 2)
+              << " %)" << std::endl;
+    
+    const auto perInstance = memoryPrepared >= 0 ? (memoryPrepared - memoryAtStart) / settings.numInstances : -1;
+    std::cout << "resident memory: " << megabytes(memoryAtStart) << " at start, " << megabytes(memoryPrepared)
+              << " after preparing (" << megabytes(perInstance) << " per instance), "
+              << megabytes(memoryAfterRun) << " after the run" << std::endl;
+    
+    if (counters.isAvailable()){
+        auto perBlock = [&] (juce::int64 count){ return count < 0 ? juce::String("n/a") : juce::String((double) count / numBlocks, 0); };
+        std::cout << "per block: " << perBlock(counts.cacheMisses) << " cache misses, " << perBlock(counts.cacheReferences)
+                  << " cache references, " << perBlock(counts.l1dReadMisses) << " L1D read misses";
+        if (counts.cacheMisses >= 0 && counts.cacheReferences > 0)
+            std::cout << ", miss rate " << juce::String(100.0 * counts.cacheMisses / counts.cacheReferences, 2) << " %";
+        if (counts.instructions >= 0 && counts.cycles > 0)
+            std::cout << ", " << juce::String((double) counts.instructions / counts.cycles, 2) << " instructions per cycle";
+        std::cout << std::endl;
+    }
+    else
+        std::cout << "hardware counters are not available (perf events)" << std::endl;
+    
+    if (jsonFile != juce::File()){
+        report->setProperty("instances", settings.numInstances);
+        report->setProperty("threads", settings.numThreads);
+        report->setProperty("sampleRate", settings.sampleRate);
+        report->setProperty("blockSize", settings.blockSize);
+        report->setProperty("paced", settings.paced);
+        report->setProperty("automation", settings.automation);
+        report->setProperty("cycles", graph.getNumCycles());
+        report->setProperty("deadlineMs", deadlineMs);
+        report->setProperty("deadlineMisses", (int) numMisses);
+        report->setProperty("residentBytesAtStart", memoryAtStart);
+        report->setProperty("residentBytesPrepared", memoryPrepared);
+        report->setProperty("residentBytesAfterRun", memoryAfterRun);
+        report->setProperty("cacheReferences", counts.cacheReferences);
+        report->setProperty("cacheMisses", counts.cacheMisses);
+        report->setProperty("l1dReadMisses", counts.l1dReadMisses);
+        report->setProperty("instructions", counts.instructions);
+        report->setProperty("cpuCycles", counts.cycles);
+        if (! jsonFile.replaceWithText(juce::JSON::toString(juce::var(report.get())))){
+            std::cerr << "Could not write " << jsonFile.getFullPathName() << std::endl;
+            return 1;
+        }
+    }
+    return 0;
+}
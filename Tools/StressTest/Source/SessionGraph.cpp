@@ -0,0 +1,148 @@
+/*
+  ==============================================================================
+
+    SessionGraph.cpp
+
+  ==============================================================================
+*/
+
+#include "SessionGraph.h"
+
+class SessionGraph::Worker : public juce::Thread{
+public:
+    Worker(SessionGraph& sessionGraph) : juce::Thread("Session graph worker"), graph(sessionGraph){}
+    
+    void startCycle(){
+        cycleStart.signal();
+    }
+    
+    void run() override{
+        while (! threadShouldExit()){
+            if (! cycleStart.wait(100))
+                continue;
+            if (threadShouldExit())
+                return;
+            graph.processInstances();
+            if (--graph.numBusyWorkers == 0)
+                graph.cycleDone.signal();
+        }
+    }
+    
+private:
+    SessionGraph& graph;
+    juce::WaitableEvent cycleStart;
+};
+
+
+SessionGraph::SessionGraph(const Settings& graphSettings) : settings(graphSettings){}
+
+SessionGraph::~SessionGraph(){
+    for (auto* worker : workers)
+        worker->signalThreadShouldExit();
+    for (auto* worker : workers){
+        worker->startCycle();
+        worker->stopThread(-1);
+    }
+}
+
+
+void SessionGraph::prepare(){
+    numCycles = (int) std::ceil(settings.seconds * settings.sampleRate / settings.blockSize);
+    blockTimes.assign((size_t) numCycles * (size_t) settings.numInstances, 0.0f);
+    cycleTimes.assign((size_t) numCycles, 0.0f);
+    
+    //10 s of noise, each instance starts reading at a different position
+    juce::Random random (1);
+    signal.setSize(2, (int) (10 * settings.sampleRate));
+    for (int chan = 0; chan < signal.getNumChannels(); chan++)
+        for (int i = 0; i < signal.getNumSamples(); i++)
+            signal.setSample(chan, i, 0.5f * (2.0f * random.nextFloat() - 1.0f));
+    
+    //a mix of sessions: half of the instances use the allpass decorrelator,
+    //and every fourth one handles transients
+    instances.resize((size_t) settings.numInstances);
+    for (int k = 0; k < settings.numInstances; k++){
+        auto& instance = instances[(size_t) k];
+        instance.processor = std::make_unique<StereoWidenerAudioProcessor>();
+        auto& parameters = instance.processor->parameters;
+        auto set = [&] (const char* parameterID, float value){
+            auto* p = parameters.getParameter(parameterID);
+            p->setValueNotifyingHost(p->convertTo0to1(value));
+        };
+        set("hasAllpassDecorrelation", (float) (k % 2));
+        set("handleTransients", (k % 4 == 3) ? 1.0f : 0.0f);
+        instance.widthLower = parameters.getParameter("widthLower");
+        instance.widthHigher = parameters.getParameter("widthHigher");
+        instance.cutoffFrequency = parameters.getParameter("cutoffFrequency");
+        
+        instance.processor->prepareToPlay(settings.sampleRate, settings.blockSize);
+        instance.buffer.setSize(2, settings.blockSize);
+    }
+}
+
+
+void SessionGraph::processInstance(int index){
+    auto& instance = instances[(size_t) index];
+    const int blockSize = settings.blockSize;
+    
+    //automation is sent with every block, as a host does: slow sine sweeps of
+    //the widths and the cutoff, with a different phase for every instance
+    if (settings.automation){
+        const double time = (double) cycle * blockSize / settings.sampleRate;
+        const double phase = 2.0 * juce::MathConstants<double>::pi * (0.618 * index);
+        const double twoPi = 2.0 * juce::MathConstants<double>::pi;
+        instance.widthLower->setValueNotifyingHost((float) (0.5 + 0.5 * std::sin(twoPi * 0.13 * time + phase)));
+        instance.widthHigher->setValueNotifyingHost((float) (0.5 + 0.5 * std::sin(twoPi * 0.29 * time + phase)));
+        const float cutoff = (float) (632.0 * std::pow(10.0, 0.5 * std::sin(twoPi * 0.07 * time + phase)));
+        instance.cutoffFrequency->setValueNotifyingHost(instance.cutoffFrequency->convertTo0to1(cutoff));
+    }
+    
+    const int signalPos = (int) (((juce::int64) index * 4999 + (juce::int64) cycle * blockSize) % (signal.getNumSamples() - blockSize));
+    for (int chan = 0; chan < 2; chan++)
+        instance.buffer.copyFrom(chan, 0, signal, chan, signalPos, blockSize);
+    
+    const auto start = juce::Time::getHighResolutionTicks();
+    instance.processor->processBlock(instance.buffer, instance.midiMessages);
+    const auto elapsed = juce::Time::getHighResolutionTicks() - start;
+    blockTimes[(size_t) cycle * (size_t) settings.numInstances + (size_t) index] =
+        (float) (1e3 * juce::Time::highResolutionTicksToSeconds(elapsed));
+}
+
+
+void SessionGraph::processInstances(){
+    for (int index = nextInstance++; index < settings.numInstances; index = nextInstance++)
+        processInstance(index);
+}
+
+
+void SessionGraph::run(){
+    for (int i = 0; i < settings.numThreads; i++){
+        workers.add(new Worker(*this));
+        workers.getLast()->startThread(juce::Thread::Priority::highest);
+    }
+    
+    const double cycleSeconds = settings.blockSize / settings.sampleRate;
+    const auto ticksPerSecond = juce::Time::getHighResolutionTicksPerSecond();
+    const auto sessionStart = juce::Time::getHighResolutionTicks();
+    
+    for (cycle = 0; cycle < numCycles; cycle++){
+        //a paced session waits for the next audio callback. When a cycle
+        //overruns, the next one starts right away
+        if (settings.paced){
+            const auto cycleStart = sessionStart + (juce::int64) (cycle * cycleSeconds * ticksPerSecond);
+            while (juce::Time::getHighResolutionTicks() < cycleStart){
+                const double remainingMs = 1e3 * juce::Time::highResolutionTicksToSeconds(cycleStart - juce::Time::getHighResolutionTicks());
+                if (remainingMs > 2.0)
+                    juce::Thread::sleep(1);
+            }
+        }
+        
+        const auto start = juce::Time::getHighResolutionTicks();
+        nextInstance = 0;
+        numBusyWorkers = workers.size();
+        for (auto* worker : workers)
+            worker->startCycle();
+        cycleDone.wait(-1);
+        cycleTimes[(size_t) cycle] = (float) (1e3 * juce::Time::highResolutionTicksToSeconds(juce::Time::getHighResolutionTicks() - start));
+    }
+}
@@ -0,0 +1,67 @@
+/*
+  ==============================================================================
+
+    SessionGraph.h
+    Drives many processor instances the way a host's audio graph does: in every
+    cycle each instance processes one block with automated parameters, the
+    instances are spread over a pool of threads, and the cycle is over when the
+    last instance is done. The time of every block and every cycle is recorded.
+
+  ==============================================================================
+*/
+
+#pragma once
+#include <JuceHeader.h>
+#include "../../../Source/PluginProcessor.h"
+
+class SessionGraph{
+public:
+    struct Settings{
+        int numInstances = 64;
+        int numThreads = juce::SystemStats::getNumCpus();
+        double sampleRate = 48000.0;
+        int blockSize = 128;
+        double seconds = 10.0;          //duration of the simulated session
+        bool paced = true;              //start the cycles in real time, as a host would
+        bool automation = true;         //automate the width and cutoff of every instance
+    };
+    
+    SessionGraph(const Settings& graphSettings);
+    ~SessionGraph();
+    
+    //creates and prepares the processors on the calling thread
+    void prepare();
+    void run();
+    
+    int getNumCycles() const { return numCycles; }
+    double getCycleDeadlineMs() const { return 1e3 * settings.blockSize / settings.sampleRate; }
+    //in ms, block times are indexed [cycle * numInstances + instance]
+    const std::vector<float>& getBlockTimes() const { return blockTimes; }
+    const std::vector<float>& getCycleTimes() const { return cycleTimes; }
+    
+private:
+    class Worker;
+    
+    struct Instance{
+        std::unique_ptr<StereoWidenerAudioProcessor> processor;
+        juce::AudioBuffer<float> buffer;
+        juce::RangedAudioParameter* widthLower;
+        juce::RangedAudioParameter* widthHigher;
+        juce::RangedAudioParameter* cutoffFrequency;
+        juce::MidiBuffer midiMessages;
+    };
+    
+    void processInstances();
+    void processInstance(int index);
+    
+    const Settings settings;
+    int numCycles = 0;
+    int cycle = 0;
+    std::vector<Instance> instances;
+    juce::AudioBuffer<float> signal;        //the instances read different parts of it
+    juce::OwnedArray<Worker> workers;
+    std::atomic<int> nextInstance { 0 };
+    std::atomic<int> numBusyWorkers { 0 };
+    juce::WaitableEvent cycleDone;
+    std::vector<float> blockTimes, cycleTimes;
+};
@@ -0,0 +1,184 @@
+/*
+  ==============================================================================
+
+    Main.cpp
+    Generates the optimised velvet noise filters of the plugin
+    (Resources/opt_vn_filters_<rate>.txt) for several sample rates. For every
+    rate and seed, a pair of sequences (left and right) is generated and
+    optimised, and the pair with the lowest mean interchannel coherence and
+    spectral cost is written, as in decorrelation_comparison.ipynb. The seeds
+    of all rates are spread over a pool of threads, and the output does not
+    depend on the number of threads.
+
+  ==============================================================================
+*/
+
+#include "VelvetOptimiser.h"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+
+struct OptimiserSettings{
+    std::vector<int> sampleRates { 44100, 48000, 88200, 96000, 192000 };
+    int numSeeds = 1000;                //pairs tried per sample rate
+    int numThreads = (int) std::max(1u, std::thread::hardware_concurrency());
+    std::string outputDir = ".";
+    VelvetOptimiser::Settings sequence;
+};
+
+static std::string getUsage(){
+    return "Usage: StereoWidenerVelvetOptimiser [options]\n"
+           "  --sample-rates <list>   comma separated sample rates (default: 44100,48000,88200,96000,192000)\n"
+           "  --seeds <n>             pairs of sequences tried per sample rate (default: 1000)\n"
+           "  --threads <n>           worker threads (default: all cores)\n"
+           "  --iterations <n>        maximum iterations of each optimisation (default: 100)\n"
+           "  --length-ms <ms>        length of the sequences (default: 15)\n"
+           "  --density <n>           impulses per second (default: 1000)\n"
+           "  --decay-db <dB>         decay of the initial amplitudes over the sequence (default: 60)\n"
+           "  --output-dir <dir>      where to write opt_vn_filters_<rate>.txt (default: .)\n";
+}
+
+static std::vector<int> parseList(const std::string& list){
+    std::vector<int> values;
+    std::stringstream stream (list);
+    std::string value;
+    while (std::getline(stream, value, ','))
+        values.push_back(std::atoi(value.c_str()));
+    return values;
+}
+
+//one line per channel, as np.savetxt with fmt='%.4f'
+static bool writeFilters(const std::string& path, const std::vector<float>& left, const std::vector<float>& right){
+    std::ofstream file (path);
+    if (! file)
+        return false;
+    for (const auto* taps : { &left, &right }){
+        std::string line;
+        char value[32];
+        for (size_t n = 0; n < taps->size(); n++){
+            std::snprintf(value, sizeof(value), n == 0 ? "%.4f" : " %.4f", (*taps)[n]);
+            line += value;
+        }
+        file << line << "\n";
+    }
+    return (bool) file;
+}
+
+int main (int argc, char* argv[])
+{
+    OptimiserSettings settings;
+    for (int i = 1; i < argc; i++){
+        const std::string arg = argv[i];
+        const bool hasValue = i + 1 < argc;
+        if (arg == "--help" || arg == "-h"){
+            std::cout << getUsage();
+            return 0;
+        }
+        else if (arg == "--sample-rates" && hasValue)
+            settings.sampleRates = parseList(argv[++i]);
+        else if (arg == "--seeds" && hasValue)
+            settings.numSeeds = std::atoi(argv[++i]);
+        else if (arg == "--threads" && hasValue)
+            settings.numThreads = std::atoi(argv[++i]);
+        else if (arg == "--iterations" && hasValue)
+            settings.sequence.maxIterations = std::atoi(argv[++i]);
+        else if (arg == "--length-ms" && hasValue)
+            settings.sequence.lengthMs = std::atof(argv[++i]);
+        else if (arg == "--density" && hasValue)
+            settings.sequence.density = std::atoi(argv[++i]);
+        else if (arg == "--decay-db" && hasValue)
+            settings.sequence.decaydB = std::atof(argv[++i]);
+        else if (arg == "--output-dir" && hasValue)
+            settings.outputDir = argv[++i];
+        else{
+            std::cerr << "Unknown option " << arg << "\n" << getUsage();
+            return 1;
+        }
+    }
+    if (settings.sampleRates.empty() || settings.numSeeds < 1 || settings.numThreads < 1){
+        std::cerr << getUsage();
+        return 1;
+    }
+    for (int rate : settings.sampleRates){
+        if (rate < 8000 || rate / settings.sequence.density < 2){
+            std::cerr << "Sample rate " << rate << " is too low for " << settings.sequence.density << " impulses per second\n";
+            return 1;
+        }
+    }
+
+    std::vector<VelvetOptimiser> optimisers;
+    for (int rate : settings.sampleRates){
+        VelvetOptimiser::Settings sequence = settings.sequence;
+        sequence.sampleRate = rate;
+        optimisers.emplace_back(sequence);
+    }
+
+    //one task per sample rate and seed, taken by the workers in order
+    struct Result{
+        VelvetOptimiser::Sequence left, right;
+        double coherence = 0.0, cost = 0.0;
+    };
+    const int numRates = (int) settings.sampleRates.size();
+    const int numTasks = numRates * settings.numSeeds;
+    std::vector<Result> results ((size_t) numTasks);
+    std::atomic<int> nextTask { 0 };
+    std::atomic<int> numDone { 0 };
+    auto worker = [&] {
+        for (int task = nextTask++; task < numTasks; task = nextTask++){
+            const int r = task / settings.numSeeds, seed = task % settings.numSeeds;
+            const VelvetOptimiser& optimiser = optimisers[(size_t) r];
+            Result& result = results[(size_t) task];
+            VelvetOptimiser::Sequence* channels[2] = { &result.left, &result.right };
+            for (unsigned int chan = 0; chan < 2; chan++){
+                std::seed_seq seeds { (unsigned int) seed, chan, (unsigned int) settings.sampleRates[(size_t) r] };
+                std::mt19937 random (seeds);
+                *channels[chan] = optimiser.optimise(optimiser.generate(random));
+            }
+            result.coherence = optimiser.get_mean_coherence(result.left.taps, result.right.taps);
+            result.cost = VelvetOptimiser::get_pair_cost(result.coherence, result.left.cost, result.right.cost);
+            const int done = ++numDone;
+            if (done % std::max(1, numTasks / 20) == 0)
+                std::cerr << "\r" << done << " / " << numTasks << std::flush;
+        }
+    };
+    const auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads;
+    for (int t = 0; t < std::min(settings.numThreads, numTasks); t++)
+        threads.emplace_back(worker);
+    for (auto& thread : threads)
+        thread.join();
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cerr << "\r";
+
+    bool ok = true;
+    for (int r = 0; r < numRates; r++){
+        const Result* best = &results[(size_t) (r * settings.numSeeds)];
+        int bestSeed = 0;
+        for (int seed = 1; seed < settings.numSeeds; seed++){
+            const Result& result = results[(size_t) (r * settings.numSeeds + seed)];
+            if (result.cost < best->cost){
+                best = &result;
+                bestSeed = seed;
+            }
+        }
+        const std::string path = settings.outputDir + "/opt_vn_filters_" + std::to_string(settings.sampleRates[(size_t) r]) + ".txt";
+        if (! writeFilters(path, best->left.taps, best->right.taps)){
+            std::cerr << "Could not write " << path << "\n";
+            ok = false;
+            continue;
+        }
+        char line[256];
+        std::snprintf(line, sizeof(line), "%6d Hz: seed %d, spectral cost %.3f / %.3f dB, mean coherence %.3f -> %s\n",
+                      settings.sampleRates[(size_t) r], bestSeed, best->left.cost, best->right.cost, best->coherence, path.c_str());
+        std::cout << line;
+    }
+    std::cout << numTasks << " pairs in " << seconds << " s on " << std::min(settings.numThreads, numTasks) << " threads\n";
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,324 @@
+/*
+  ==============================================================================
+
+    VelvetOptimiser.cpp
+
+  ==============================================================================
+*/
+
+#include "VelvetOptimiser.h"
+#include <algorithm>
+#include <cmath>
+#include <complex>
+#include <limits>
+
+namespace{
+    const double PI = std::acos(-1.0);
+    const double DB_PER_NEPER = 20.0 / std::log(10.0);
+}
+
+//the problem of one sequence: impulse 0 is fixed, the variables are the locations
+//of impulses 1 to n - 1, then the logarithms of their amplitudes
+struct VelvetOptimiser::Problem{
+    std::vector<double> signs;
+    std::vector<double> lower, upper;
+    int num_impulses = 0;
+};
+
+VelvetOptimiser::VelvetOptimiser(const Settings& s) : settings(s){
+    const double fs = settings.sampleRate;
+    //np.round rounds half to even, as nearbyint does by default
+    length = (int) std::nearbyint(settings.lengthMs * 1e-3 * fs);
+    grid_size = (int) (fs / settings.density);
+
+    //log spaced frequencies as np.linspace, and the third-octave window of each,
+    //as third_octave_magnitude_smoothing
+    const int K = settings.numFreqBins;
+    const double start = std::log(20.0), stop = std::log(fs / 2.0);
+    const double step = (stop - start) / (K - 1);
+    std::vector<double> freqs_hz ((size_t) K);
+    for (int k = 0; k < K; k++)
+        freqs_hz[k] = std::exp(k == K - 1 ? stop : start + k * step);
+    freqs_rad.resize((size_t) K);
+    smoothing_start.resize((size_t) K);
+    smoothing_end.resize((size_t) K);
+    const double sixth_octave = std::pow(2.0, 1.0 / 6);
+    for (int k = 0; k < K; k++){
+        freqs_rad[k] = 2.0 * PI / fs * freqs_hz[k];
+        const double lower = freqs_hz[k] / sixth_octave, upper = freqs_hz[k] * sixth_octave;
+        smoothing_start[k] = (int) (std::lower_bound(freqs_hz.begin(), freqs_hz.end(), lower) - freqs_hz.begin());
+        smoothing_end[k] = (int) (std::upper_bound(freqs_hz.begin(), freqs_hz.end(), upper) - freqs_hz.begin()) - 1;
+    }
+
+    //third-octave bands centred on 1 kHz * 2^(b / 3) from 20 Hz to Nyquist, with
+    //power complementary raised cosine crossovers between the centres. The FFT
+    //resolves the lowest band
+    fft_size = 1;
+    while (fft_size < std::max(2 * length, (int) fs))
+        fft_size *= 2;
+    const int firstBand = (int) std::ceil(3.0 * std::log2(20.0 / 1000.0));
+    const int lastBand = (int) std::floor(3.0 * std::log2(fs / 2.0 / 1000.0));
+    num_bands = lastBand - firstBand + 1;
+    const double firstCentre = 1000.0 * std::pow(2.0, firstBand / 3.0);
+    bin_band.resize((size_t) fft_size / 2 + 1);
+    bin_weight.resize((size_t) fft_size / 2 + 1);
+    for (int k = 0; k <= fft_size / 2; k++){
+        const double position = (k == 0) ? -1.0 : 3.0 * std::log2(k * fs / fft_size / firstCentre);
+        if (position <= 0.0){
+            bin_band[k] = 0;
+            bin_weight[k] = 1.0;
+        }
+        else if (position >= num_bands - 1){
+            bin_band[k] = num_bands - 1;
+            bin_weight[k] = 1.0;
+        }
+        else{
+            bin_band[k] = (int) position;
+            const double c = std::cos(0.5 * PI * (position - bin_band[k]));
+            bin_weight[k] = c * c;
+        }
+    }
+}
+
+std::vector<float> VelvetOptimiser::generate(std::mt19937& random) const{
+    std::uniform_real_distribution<double> uniform (0.0, 1.0);
+    std::uniform_int_distribution<int> sign (0, 1);
+    std::vector<float> sequence ((size_t) length, 0.0f);
+    for (int cell = 0; cell * grid_size < length; cell++){
+        const int location = cell * grid_size + (int) std::nearbyint(uniform(random) * (grid_size - 1));
+        const float value = (float) (2 * sign(random) - 1);
+        if (location < length)
+            sequence[location] = value;
+    }
+    return sequence;
+}
+
+double VelvetOptimiser::evaluate(const Problem& problem, const std::vector<double>& x, std::vector<double>* gradient) const{
+    const int N = problem.num_impulses;
+    const int K = settings.numFreqBins;
+    const double* locations = x.data();
+    const double* log_amplitudes = x.data() + (N - 1);
+    std::vector<double> amplitudes ((size_t) N - 1);
+    for (int i = 0; i < N - 1; i++)
+        amplitudes[i] = problem.signs[i + 1] * std::exp(log_amplitudes[i]);
+
+    //frequency response at the log spaced frequencies, in dB
+    std::vector<std::complex<double>> response ((size_t) K);
+    std::vector<double> magnitude ((size_t) K);
+    for (int k = 0; k < K; k++){
+        std::complex<double> h (problem.signs[0], 0.0);
+        for (int i = 0; i < N - 1; i++)
+            h += std::polar(amplitudes[i], -freqs_rad[k] * locations[i]);
+        response[k] = h;
+        magnitude[k] = DB_PER_NEPER * 0.5 * std::log(std::max(std::norm(h), 1e-300));
+    }
+
+    //third-octave smoothing, and the RMS deviation from the mean
+    std::vector<double> cumulative ((size_t) K + 1, 0.0);
+    for (int k = 0; k < K; k++)
+        cumulative[k + 1] = cumulative[k] + magnitude[k];
+    std::vector<double> smoothed ((size_t) K);
+    double mean = 0.0;
+    for (int k = 0; k < K; k++){
+        const int count = smoothing_end[k] - smoothing_start[k] + 1;
+        smoothed[k] = (cumulative[smoothing_end[k] + 1] - cumulative[smoothing_start[k]]) / count;
+        mean += smoothed[k];
+    }
+    mean /= K;
+    double sum_squares = 0.0;
+    for (int k = 0; k < K; k++)
+        sum_squares += (smoothed[k] - mean) * (smoothed[k] - mean);
+    const double cost = std::sqrt(sum_squares / K);
+    if (gradient == nullptr)
+        return cost;
+
+    //back through the smoothing: d cost / d magnitude, accumulated over the windows
+    std::vector<double> magnitude_gradient ((size_t) K + 1, 0.0);
+    if (cost > 0.0){
+        for (int k = 0; k < K; k++){
+            const double g = (smoothed[k] - mean) / (K * cost) / (smoothing_end[k] - smoothing_start[k] + 1);
+            magnitude_gradient[smoothing_start[k]] += g;
+            magnitude_gradient[smoothing_end[k] + 1] -= g;
+        }
+        for (int k = 1; k < K; k++)
+            magnitude_gradient[k] += magnitude_gradient[k - 1];
+    }
+
+    //d ln|H| / d ln a = Re(conj(H) z) / |H|^2 and d ln|H| / d n = w Im(conj(H) z) / |H|^2
+    //for the term z = a exp(-j w n) of an impulse
+    gradient->assign(x.size(), 0.0);
+    for (int k = 0; k < K; k++){
+        const double weight = DB_PER_NEPER * magnitude_gradient[k] / std::max(std::norm(response[k]), 1e-300);
+        const std::complex<double> h = std::conj(response[k]);
+        for (int i = 0; i < N - 1; i++){
+            const std::complex<double> q = h * std::polar(amplitudes[i], -freqs_rad[k] * locations[i]);
+            (*gradient)[i] += weight * freqs_rad[k] * q.imag();
+            (*gradient)[N - 1 + i] += weight * q.real();
+        }
+    }
+    return cost;
+}
+
+VelvetOptimiser::Sequence VelvetOptimiser::optimise(const std::vector<float>& initial) const{
+    std::vector<int> initial_locations;
+    Problem problem;
+    for (int n = 0; n < (int) initial.size(); n++){
+        if (initial[n] != 0.0f){
+            initial_locations.push_back(n);
+            problem.signs.push_back(initial[n] > 0.0f ? 1.0 : -1.0);
+        }
+    }
+    const int N = problem.num_impulses = (int) initial_locations.size();
+    Sequence result;
+    result.taps.assign(initial.size(), 0.0f);
+    if (N == 0)
+        return result;
+
+    //bounds as in Python: location i in [grid * i - 1, grid * i], amplitude within
+    //maxGainDeviation of the decaying initial amplitude at the initial location
+    const double decay_slope = settings.decaydB / DB_PER_NEPER / (double) initial.size();
+    const int M = 2 * (N - 1);
+    problem.lower.resize((size_t) M);
+    problem.upper.resize((size_t) M);
+    std::vector<double> x ((size_t) M);
+    const double log_deviation = std::log(settings.maxGainDeviation);
+    for (int i = 1; i < N; i++){
+        problem.lower[i - 1] = (double) grid_size * i - 1.0;
+        problem.upper[i - 1] = (double) grid_size * i;
+        const double log_amplitude = -initial_locations[i] * decay_slope;
+        problem.lower[N - 2 + i] = log_amplitude - log_deviation;
+        problem.upper[N - 2 + i] = log_amplitude + log_deviation;
+        x[i - 1] = initial_locations[i];
+        x[N - 2 + i] = log_amplitude;
+    }
+    auto project = [&problem, M] (std::vector<double>& v){
+        for (int m = 0; m < M; m++)
+            v[m] = std::clamp(v[m], problem.lower[m], problem.upper[m]);
+    };
+    project(x);
+
+    //projected gradient descent, Barzilai-Borwein steps with backtracking
+    std::vector<double> gradient, next_gradient, next ((size_t) M);
+    double cost = evaluate(problem, x, &gradient);
+    double step = 0.0;
+    for (double g : gradient)
+        step = std::max(step, std::abs(g));
+    step = (step > 0.0) ? 1.0 / step : 1.0;
+    for (int iteration = 0; iteration < settings.maxIterations && M > 0; iteration++){
+        double next_cost = std::numeric_limits<double>::infinity();
+        bool decreased = false;
+        for (int halving = 0; halving < 40; halving++){
+            double descent = 0.0;
+            for (int m = 0; m < M; m++)
+                next[m] = x[m] - step * gradient[m];
+            project(next);
+            for (int m = 0; m < M; m++)
+                descent += gradient[m] * (next[m] - x[m]);
+            if (descent >= 0.0)
+                break;
+            next_cost = evaluate(problem, next, nullptr);
+            if (next_cost <= cost + 1e-4 * descent){
+                decreased = true;
+                break;
+            }
+            step *= 0.5;
+        }
+        if (! decreased)
+            break;
+
+        evaluate(problem, next, &next_gradient);
+        double ss = 0.0, sy = 0.0;
+        for (int m = 0; m < M; m++){
+            const double s = next[m] - x[m], y = next_gradient[m] - gradient[m];
+            ss += s * s;
+            sy += s * y;
+        }
+        const bool converged = (cost - next_cost) < 1e-10 * std::max(1.0, cost);
+        step = (sy > 0.0) ? ss / sy : 2.0 * step;
+        x.swap(next);
+        gradient.swap(next_gradient);
+        cost = next_cost;
+        if (converged)
+            break;
+    }
+
+    //the locations are rounded, as in Python
+    result.cost = cost;
+    result.taps[0] = (float) problem.signs[0];
+    for (int i = 1; i < N; i++){
+        const int location = (int) std::nearbyint(x[i - 1]);
+        result.taps[location] = (float) (problem.signs[i] * std::exp(x[N - 2 + i]));
+    }
+    return result;
+}
+
+void VelvetOptimiser::fft(std::vector<double>& re, std::vector<double>& im) const{
+    const int n = (int) re.size();
+    for (int i = 1, j = 0; i < n; i++){
+        int bit = n >> 1;
+        for (; j & bit; bit >>= 1)
+            j ^= bit;
+        j ^= bit;
+        if (i < j){
+            std::swap(re[i], re[j]);
+            std::swap(im[i], im[j]);
+        }
+    }
+    for (int size = 2; size <= n; size *= 2){
+        const double angle = -2.0 * PI / size;
+        for (int k = 0; k < size / 2; k++){
+            const double wr = std::cos(angle * k), wi = std::sin(angle * k);
+            for (int start = 0; start < n; start += size){
+                const int a = start + k, b = a + size / 2;
+                const double tr = wr * re[b] - wi * im[b], ti = wr * im[b] + wi * re[b];
+                re[b] = re[a] - tr;
+                im[b] = im[a] - ti;
+                re[a] += tr;
+                im[a] += ti;
+            }
+        }
+    }
+}
+
+double VelvetOptimiser::get_mean_coherence(const std::vector<float>& left, const std::vector<float>& right) const{
+    std::vector<double> lre ((size_t) fft_size, 0.0), lim ((size_t) fft_size, 0.0);
+    std::vector<double> rre ((size_t) fft_size, 0.0), rim ((size_t) fft_size, 0.0);
+    std::copy(left.begin(), left.begin() + std::min((int) left.size(), fft_size), lre.begin());
+    std::copy(right.begin(), right.begin() + std::min((int) right.size(), fft_size), rre.begin());
+    fft(lre, lim);
+    fft(rre, rim);
+
+    //the sums over time of the band filtered signals, from the one-sided spectra
+    std::vector<double> cross ((size_t) num_bands, 0.0), left_energy ((size_t) num_bands, 0.0), right_energy ((size_t) num_bands, 0.0);
+    for (int k = 0; k <= fft_size / 2; k++){
+        const double sides = (k == 0 || k == fft_size / 2) ? 1.0 : 2.0;
+        const double c = sides * (lre[k] * rre[k] + lim[k] * rim[k]);
+        const double l = sides * (lre[k] * lre[k] + lim[k] * lim[k]);
+        const double r = sides * (rre[k] * rre[k] + rim[k] * rim[k]);
+        const int band = bin_band[k];
+        const double weight = bin_weight[k];
+        cross[band] += weight * c;
+        left_energy[band] += weight * l;
+        right_energy[band] += weight * r;
+        if (weight < 1.0){
+            cross[band + 1] += (1.0 - weight) * c;
+            left_energy[band + 1] += (1.0 - weight) * l;
+            right_energy[band + 1] += (1.0 - weight) * r;
+        }
+    }
+    double sum = 0.0;
+    int count = 0;
+    for (int b = 0; b < num_bands; b++){
+        if (left_energy[b] > 0.0 && right_energy[b] > 0.0){
+            sum += std::abs(cross[b]) / std::sqrt(left_energy[b] * right_energy[b]);
+            count++;
+        }
+    }
+    return count > 0 ? sum / count : 1.0;
+}
+
+double VelvetOptimiser::get_pair_cost(double meanCoherence, double leftCost, double rightCost){
+    //pick_minimum_coherence_decorrelator with lambda = 0.5 and mu = 0.1
+    const double lambda = 0.5, mu = 0.1;
+    return (1.0 - lambda) * meanCoherence + lambda * mu * (leftCost + rightCost);
+}
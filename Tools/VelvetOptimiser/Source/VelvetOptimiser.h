@@ -0,0 +1,76 @@
+/*
+  ==============================================================================
+
+    VelvetOptimiser.h
+    The velvet noise optimisation of optimise_velvet_noise_sequence in
+    Python/src/velvet.py (Schlecht et al., "Optimized velvet-noise
+    decorrelator", DAFx 2018). The impulse locations and amplitudes of a
+    velvet noise sequence are adjusted, within the same bounds as in Python,
+    to minimise the RMS deviation of its third-octave smoothed magnitude
+    response in dB from its mean, at log spaced frequencies from 20 Hz to
+    Nyquist. The first impulse stays at 0 with amplitude 1.
+
+    The response and its gradient are evaluated analytically at those
+    frequencies, and the bounded problem is solved by projected gradient
+    descent with Barzilai-Borwein steps, instead of SLSQP with numerical
+    gradients. A pair of optimised sequences is rated as in the notebook
+    decorrelation_comparison.ipynb, by its mean interchannel coherence in
+    third-octave bands (from the FFT of both sequences) and its costs.
+
+  ==============================================================================
+*/
+
+#pragma once
+#include <random>
+#include <vector>
+
+class VelvetOptimiser{
+public:
+    struct Settings{
+        double sampleRate = 48000.0;
+        double lengthMs = 15.0;
+        int density = 1000;                     //impulses per second
+        double decaydB = 60.0;                  //decay of the initial amplitudes over the sequence
+        int numFreqBins = 1024;                 //log spaced frequencies of the cost function
+        double maxGainDeviation = 2.0;          //amplitudes stay within this factor of the initial ones
+        int maxIterations = 100;
+    };
+
+    struct Sequence{
+        std::vector<float> taps;                //one value per sample
+        double cost = 0.0;                      //RMS deviation of the smoothed response in dB
+    };
+
+    explicit VelvetOptimiser(const Settings& settings);
+
+    //a sequence of one +/-1 impulse at a random position in every grid cell, as
+    //generate_velvet_noise_sequence with one delay line
+    std::vector<float> generate(std::mt19937& random) const;
+    Sequence optimise(const std::vector<float>& initial) const;
+    //mean absolute interchannel coherence of two sequences over the third-octave
+    //bands from 20 Hz to Nyquist
+    double get_mean_coherence(const std::vector<float>& left, const std::vector<float>& right) const;
+    //the rating of a pair in the notebook, lower is better
+    static double get_pair_cost(double meanCoherence, double leftCost, double rightCost);
+
+    int get_length() const { return length; }
+
+private:
+    struct Problem;
+    double evaluate(const Problem& problem, const std::vector<double>& x, std::vector<double>* gradient) const;
+    void fft(std::vector<double>& re, std::vector<double>& im) const;
+
+    Settings settings;
+    int length = 0;
+    int grid_size = 0;
+
+    //cost function
+    std::vector<double> freqs_rad;
+    std::vector<int> smoothing_start, smoothing_end;        //third-octave window of each frequency
+
+    //coherence
+    int fft_size = 0;
+    int num_bands = 0;
+    std::vector<int> bin_band;                              //each bin is in this band and the next one
+    std::vector<double> bin_weight;                         //squared magnitude of the first band
+};